@@ -0,0 +1,481 @@
+/*
+ *      Packed asset archive reader for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      "data\\X" paths are looked up in data.w3p first (see w3p.h), then on
+ *      disk. The archive is memory-mapped where the system allows it and
+ *      read one entry at a time otherwise. Every entry is checked against
+ *      its CRC the first time it is used. MCI can only open real files, so
+ *      music, video and the script are extracted to the temp directory the
+ *      first time they are needed, and removed on close.
+ */
+
+/* Included into w3vn.c before assetidx.c */
+
+#include "w3p.h"
+
+#define ARCHIVE_FILE     "data.w3p"
+#define ARCHIVE_CRC_READ (64 * 1024) /* bytes per read to check an unmapped entry */
+#define GUNZIP_MAX_ISIZE (16 * 1024 * 1024)
+
+typedef struct {
+    const char *name;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t rawsize;
+    uint32_t crc;
+    int method;
+    int format;
+    volatile int checked;       /* stored entry: 1 CRC good, -1 bad, 0 not yet */
+    char *temp;                 /* extracted copy, NULL if none */
+} ArchiveEntry;
+
+/* Whole file contents: points into the mapping, or owns a buffer */
+typedef struct {
+    const uint8_t *data;
+    DWORD size;
+    uint8_t *owned;
+} AssetBlob;
+
+/* Asset read a piece at a time, see AssetStreamOpen() */
+typedef struct {
+    FILE *fp;                   /* file on disk */
+    const ArchiveEntry *entry;  /* stored archive entry */
+    AssetBlob blob;             /* deflated archive entry */
+    uint32_t size;
+} AssetStream;
+
+static ArchiveEntry *g_archive = NULL;
+static long g_archiveCount = 0;
+static char *g_archiveNames = NULL;
+static HANDLE g_archiveFile = INVALID_HANDLE_VALUE;
+static HANDLE g_archiveMapping = NULL;
+static const uint8_t *g_archiveView = NULL;
+static DWORD g_archiveSize = 0;
+static CRITICAL_SECTION g_archiveLock;
+
+/* Inflate state kept across assets, reset instead of reallocated */
+static z_stream g_gunzip;
+static int g_gunzipReady = 0;
+static CRITICAL_SECTION g_gunzipLock;
+
+/* Lookup key for an asset path: lowercased, backslashes only */
+static void asset_key(char *dst, const char *src) {
+    int i;
+    for (i = 0; src[i] && i < 259; i++) {
+        char c = src[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c == '/') c = '\\';
+        dst[i] = c;
+    }
+    dst[i] = '\0';
+}
+
+/* Read raw archive bytes, from the view or the file handle */
+static int archive_read(uint32_t offset, void *dst, DWORD len) {
+    DWORD got = 0;
+    if ((DWORD)offset > g_archiveSize || len > g_archiveSize - offset) return -1;
+    if (g_archiveView) {
+        memcpy(dst, g_archiveView + offset, len);
+        return 0;
+    }
+    EnterCriticalSection(&g_archiveLock);
+    SetFilePointer(g_archiveFile, (LONG)offset, NULL, FILE_BEGIN);
+    BOOL ok = ReadFile(g_archiveFile, dst, len, &got, NULL);
+    LeaveCriticalSection(&g_archiveLock);
+    return (ok && got == len) ? 0 : -1;
+}
+
+static void archive_unmap(void) {
+    if (g_archiveView) UnmapViewOfFile(g_archiveView);
+    if (g_archiveMapping) CloseHandle(g_archiveMapping);
+    if (g_archiveFile != INVALID_HANDLE_VALUE) CloseHandle(g_archiveFile);
+    g_archiveView = NULL;
+    g_archiveMapping = NULL;
+    g_archiveFile = INVALID_HANDLE_VALUE;
+}
+
+/* Open data.w3p if present and load its directory */
+static void ArchiveOpen(void) {
+    uint8_t header[W3P_HEADER_SIZE];
+
+    InitializeCriticalSection(&g_archiveLock);
+    InitializeCriticalSection(&g_gunzipLock);
+    g_archiveFile = CreateFileA(ARCHIVE_FILE, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (g_archiveFile == INVALID_HANDLE_VALUE) return;
+    g_archiveSize = GetFileSize(g_archiveFile, NULL);
+
+    /* Map the whole archive, Win32s may refuse and we read instead */
+    g_archiveMapping = CreateFileMappingA(g_archiveFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (g_archiveMapping) {
+        g_archiveView = (const uint8_t *)MapViewOfFile(g_archiveMapping, FILE_MAP_READ, 0, 0, 0);
+        if (!g_archiveView) {
+            CloseHandle(g_archiveMapping);
+            g_archiveMapping = NULL;
+        }
+    }
+
+    if (archive_read(0, header, W3P_HEADER_SIZE) != 0 || memcmp(header, W3P_MAGIC, 4) != 0) {
+        archive_unmap();
+        return;
+    }
+
+    long count = (long)w3p_get32(header + 4);
+    uint32_t dir_offset = w3p_get32(header + 8);
+    uint32_t dir_size = w3p_get32(header + 12);
+
+    /* The directory must lie in the file and have room for every record */
+    if (dir_offset < W3P_HEADER_SIZE || dir_offset > g_archiveSize || dir_size > g_archiveSize - dir_offset ||
+        count < 0 || (uint32_t)count > dir_size / W3P_RECORD_SIZE) {
+        archive_unmap();
+        return;
+    }
+    uint8_t *dir = (uint8_t *)malloc(dir_size ? dir_size : 1);
+    g_archive = (ArchiveEntry *)malloc((count + 1) * sizeof(ArchiveEntry));
+    g_archiveNames = (char *)malloc(dir_size + 1);
+    if (!dir || !g_archive || !g_archiveNames || archive_read(dir_offset, dir, dir_size) != 0) {
+        free(dir);
+        free(g_archive);
+        free(g_archiveNames);
+        g_archive = NULL;
+        g_archiveNames = NULL;
+        archive_unmap();
+        return;
+    }
+
+    /* Names are copied NUL-terminated, they never exceed the record bytes */
+    uint32_t pos = 0;
+    char *names = g_archiveNames;
+    long n;
+    for (n = 0; n < count && pos + W3P_RECORD_SIZE <= dir_size; n++) {
+        const uint8_t *rec = dir + pos;
+        uint16_t namelen = w3p_get16(rec + 18);
+        if (pos + W3P_RECORD_SIZE + namelen > dir_size) break;
+        g_archive[n].offset = w3p_get32(rec);
+        g_archive[n].size = w3p_get32(rec + 4);
+        g_archive[n].rawsize = w3p_get32(rec + 8);
+        g_archive[n].crc = w3p_get32(rec + 12);
+        g_archive[n].method = rec[16];
+        g_archive[n].format = rec[17];
+        g_archive[n].checked = 0;
+        g_archive[n].temp = NULL;
+        memcpy(names, rec + W3P_RECORD_SIZE, namelen);
+        names[namelen] = '\0';
+        g_archive[n].name = names;
+        names += namelen + 1;
+        pos += W3P_RECORD_SIZE + namelen;
+    }
+    g_archiveCount = n;
+    free(dir);
+}
+
+static void ArchiveClose(void) {
+    for (long i = 0; i < g_archiveCount; i++) {
+        if (g_archive[i].temp) DeleteFileA(g_archive[i].temp);
+        free(g_archive[i].temp);
+    }
+    archive_unmap();
+    free(g_archive);
+    free(g_archiveNames);
+    g_archive = NULL;
+    g_archiveNames = NULL;
+    g_archiveCount = 0;
+    if (g_gunzipReady) inflateEnd(&g_gunzip);
+    g_gunzipReady = 0;
+    DeleteCriticalSection(&g_gunzipLock);
+    DeleteCriticalSection(&g_archiveLock);
+}
+
+/* Binary search an index key ("data\\name", lowercased) in the directory */
+static const ArchiveEntry *ArchiveFind(const char *key) {
+    if (g_archiveCount == 0 || strncmp(key, "data\\", 5) != 0) return NULL;
+    key += 5;
+
+    long lo = 0, hi = g_archiveCount - 1;
+    while (lo <= hi) {
+        long mid = (lo + hi) / 2;
+        int cmp = strcmp(g_archive[mid].name, key);
+        if (cmp == 0) return &g_archive[mid];
+        if (cmp < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+/* Check a stored entry against its CRC the first time, 0 when it is good.
+ * 'data' is the entry when the caller has it in memory, else it is read a
+ * piece at a time */
+static int archive_check(const ArchiveEntry *e, const uint8_t *data) {
+    ArchiveEntry *entry = (ArchiveEntry *)e;
+    if (e->checked) return e->checked > 0 ? 0 : -1;
+    if (e->offset > g_archiveSize || e->size > g_archiveSize - e->offset) {
+        entry->checked = -1;
+        return -1;
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    if (!data && g_archiveView) data = g_archiveView + e->offset;
+    if (data) {
+        crc = crc32(crc, data, e->size);
+    } else {
+        uint8_t *buf = (uint8_t *)malloc(ARCHIVE_CRC_READ);
+        if (!buf) return -1;
+        for (uint32_t at = 0; at < e->size; at += ARCHIVE_CRC_READ) {
+            uint32_t len = e->size - at < ARCHIVE_CRC_READ ? e->size - at : ARCHIVE_CRC_READ;
+            if (archive_read(e->offset + at, buf, len) != 0) {
+                free(buf);
+                return -1;
+            }
+            crc = crc32(crc, buf, len);
+        }
+        free(buf);
+    }
+    entry->checked = crc == e->crc ? 1 : -1;
+    return e->checked > 0 ? 0 : -1;
+}
+
+/* Uncompressed contents of an archive entry */
+static int archive_load(const ArchiveEntry *e, AssetBlob *blob) {
+    memset(blob, 0, sizeof(AssetBlob));
+    if (e->method == W3P_STORED) {
+        if (g_archiveView) {
+            if (archive_check(e, NULL) != 0) return -1;
+            blob->data = g_archiveView + e->offset;
+            blob->size = e->size;
+            return 0;
+        }
+        blob->owned = (uint8_t *)malloc(e->size ? e->size : 1);
+        if (!blob->owned || archive_read(e->offset, blob->owned, e->size) != 0 ||
+            archive_check(e, blob->owned) != 0) return -1;
+        blob->data = blob->owned;
+        blob->size = e->size;
+        return 0;
+    }
+    if (e->method != W3P_DEFLATE) return -1;
+
+    /* Compressed payload: use the view directly, or read it once */
+    uint8_t *packed = NULL;
+    const uint8_t *src;
+    if (g_archiveView) {
+        if (e->offset > g_archiveSize || e->size > g_archiveSize - e->offset) return -1;
+        src = g_archiveView + e->offset;
+    } else {
+        packed = (uint8_t *)malloc(e->size ? e->size : 1);
+        if (!packed || archive_read(e->offset, packed, e->size) != 0) {
+            free(packed);
+            return -1;
+        }
+        src = packed;
+    }
+
+    blob->owned = (uint8_t *)malloc(e->rawsize ? e->rawsize : 1);
+    if (!blob->owned) {
+        free(packed);
+        return -1;
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int ret = Z_DATA_ERROR;
+    if (inflateInit2(&zs, -MAX_WBITS) == Z_OK) {
+        zs.next_in = (Bytef *)src;
+        zs.avail_in = e->size;
+        zs.next_out = blob->owned;
+        zs.avail_out = e->rawsize;
+        ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+    }
+    free(packed);
+
+    if (ret != Z_STREAM_END || zs.total_out != e->rawsize ||
+        crc32(0L, blob->owned, e->rawsize) != e->crc) return -1;
+    blob->data = blob->owned;
+    blob->size = e->rawsize;
+    return 0;
+}
+
+static void AssetFreeBlob(AssetBlob *blob) {
+    free(blob->owned);
+    memset(blob, 0, sizeof(AssetBlob));
+}
+
+/* Replace gzip contents by their inflated data, other data is left as is.
+ * The output is sized from the ISIZE trailer, so a single-member file is
+ * inflated in one call. */
+static int AssetGunzip(AssetBlob *blob) {
+    if (blob->size < 18 || blob->data[0] != 0x1f || blob->data[1] != 0x8b) return 0;
+
+    DWORD cap = w3p_get32(blob->data + blob->size - 4);
+    if (cap == 0 || cap > GUNZIP_MAX_ISIZE) cap = blob->size < 1024 ? 4096 : blob->size * 4;
+    DWORD outlen = 0;
+    uint8_t *out = (uint8_t *)malloc(cap);
+    if (!out) return -1;
+
+    EnterCriticalSection(&g_gunzipLock);
+    z_stream *zs = &g_gunzip;
+    if (!g_gunzipReady) {
+        memset(zs, 0, sizeof(z_stream));
+        if (inflateInit2(zs, 16 + MAX_WBITS) != Z_OK) {
+            LeaveCriticalSection(&g_gunzipLock);
+            free(out);
+            return -1;
+        }
+        g_gunzipReady = 1;
+    } else {
+        inflateReset(zs);
+    }
+    zs->next_in = (Bytef *)blob->data;
+    zs->avail_in = blob->size;
+
+    /* More than one pass only for concatenated members or a bad trailer */
+    while (zs->avail_in > 0) {
+        if (outlen == cap) {
+            uint8_t *grown = (uint8_t *)realloc(out, cap * 2);
+            if (!grown) break;
+            out = grown;
+            cap *= 2;
+        }
+        zs->next_out = out + outlen;
+        zs->avail_out = cap - outlen;
+        int ret = inflate(zs, Z_FINISH);
+        outlen = cap - zs->avail_out;
+        if (ret == Z_STREAM_END) {
+            /* Concatenated gzip members, like gzread() */
+            inflateReset(zs);
+        } else if ((ret != Z_OK && ret != Z_BUF_ERROR) || zs->avail_out != 0) {
+            break;
+        }
+    }
+    LeaveCriticalSection(&g_gunzipLock);
+
+    /* Keep whatever was decoded from a truncated stream, as gzread() did */
+    free(blob->owned);
+    blob->owned = out;
+    blob->data = out;
+    blob->size = outlen;
+    return 0;
+}
+
+/* Read a whole asset, from the archive first, else in one read from disk */
+static int AssetReadAll(const char *path, AssetBlob *blob) {
+    char key[260];
+    memset(blob, 0, sizeof(AssetBlob));
+    asset_key(key, path);
+
+    const ArchiveEntry *e = ArchiveFind(key);
+    if (e) {
+        if (archive_load(e, blob) == 0) return 0;
+        AssetFreeBlob(blob);
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    blob->owned = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (!blob->owned || (long)fread(blob->owned, 1, size, fp) != size) {
+        fclose(fp);
+        AssetFreeBlob(blob);
+        return -1;
+    }
+    fclose(fp);
+    blob->data = blob->owned;
+    blob->size = (DWORD)size;
+    return 0;
+}
+
+/* Open an asset to be read a piece at a time: a file on disk or a stored
+ * archive entry. A deflated entry is inflated whole, there is no seeking
+ * into a deflate stream */
+static int AssetStreamOpen(const char *path, AssetStream *s) {
+    char key[260];
+    memset(s, 0, sizeof(AssetStream));
+    asset_key(key, path);
+
+    const ArchiveEntry *e = ArchiveFind(key);
+    if (e && e->method == W3P_STORED) {
+        if (archive_check(e, NULL) != 0) return -1;
+        s->entry = e;
+        s->size = e->size;
+        return 0;
+    }
+    if (e) {
+        if (archive_load(e, &s->blob) != 0) {
+            AssetFreeBlob(&s->blob);
+            return -1;
+        }
+        s->size = s->blob.size;
+        return 0;
+    }
+
+    s->fp = fopen(path, "rb");
+    if (!s->fp) return -1;
+    fseek(s->fp, 0, SEEK_END);
+    s->size = (uint32_t)ftell(s->fp);
+    return 0;
+}
+
+/* Read 'len' bytes at 'offset', returns 0 when they were all there */
+static int AssetStreamRead(AssetStream *s, uint32_t offset, void *dst, uint32_t len) {
+    if (offset > s->size || len > s->size - offset) return -1;
+    if (s->entry) return archive_read(s->entry->offset + offset, dst, len);
+    if (s->blob.data) {
+        memcpy(dst, s->blob.data + offset, len);
+        return 0;
+    }
+    if (fseek(s->fp, (long)offset, SEEK_SET) != 0 || fread(dst, 1, len, s->fp) != len) return -1;
+    return 0;
+}
+
+static void AssetStreamClose(AssetStream *s) {
+    if (s->fp) fclose(s->fp);
+    AssetFreeBlob(&s->blob);
+    memset(s, 0, sizeof(AssetStream));
+}
+
+/* Path of a real file for 'path' (for MCI and stdio users), extracting the
+ * archive entry to the temp directory once per session if needed */
+static int AssetLocalPath(const char *path, char *out, size_t outlen) {
+    char key[260];
+    int i;
+    asset_key(key, path);
+
+    const ArchiveEntry *e = ArchiveFind(key);
+    if (!e) {
+        snprintf(out, outlen, "%s", path);
+        return 0;
+    }
+
+    /* Keep the extension, MCI picks the device from it */
+    char tmpdir[260];
+    const char *base = strrchr(key, '\\');
+    tmpdir[0] = '\0';
+    GetTempPathA(sizeof(tmpdir), tmpdir);
+    if (!tmpdir[0]) GetWindowsDirectoryA(tmpdir, sizeof(tmpdir));
+    i = (int)strlen(tmpdir);
+    snprintf(out, outlen, "%s%sw3p%04x_%s", tmpdir, (i > 0 && tmpdir[i - 1] == '\\') ? "" : "\\",
+             (unsigned)(e - g_archive), base + 1);
+
+    if (e->temp) return 0;
+
+    AssetBlob blob;
+    if (archive_load(e, &blob) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+    FILE *fp = fopen(out, "wb");
+    int err = !fp || fwrite(blob.data, 1, blob.size, fp) != blob.size;
+    if (fp) err |= fclose(fp) != 0;
+    AssetFreeBlob(&blob);
+    if (err) {
+        DeleteFileA(out);
+        return -1;
+    }
+
+    char *temp = (char *)malloc(strlen(out) + 1);
+    if (temp) strcpy(temp, out);
+    ((ArchiveEntry *)e)->temp = temp;
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ *      Asset directory index for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Scans data\ (and its subdirectories) once into a hash of
+ *      lowercased path -> size, mtime and format (PNG, W3I, W3S, animation,
+ *      gzip or raw),
+ *      so existence checks and format detection don't hit the disk every
+ *      time. The format is sniffed from the file header the first time it
+ *      is asked for.
+ *      Entries of the packed archive take precedence over files on disk.
+ */
+
+/* Included into w3vn.c after archive.c, before func.c */
+
+#define ASSET_FMT_UNKNOWN -1
+#define ASSET_FMT_RAW      W3P_FMT_RAW
+#define ASSET_FMT_PNG      W3P_FMT_PNG
+#define ASSET_FMT_GZIP     W3P_FMT_GZIP
+#define ASSET_FMT_W3I      W3P_FMT_W3I
+#define ASSET_FMT_W3S      W3P_FMT_W3S
+#define ASSET_FMT_ANI      W3P_FMT_ANI
+#define ASSET_FMT_W3M      W3P_FMT_W3M
+#define ASSET_FMT_W3V      W3P_FMT_W3V
+
+typedef struct {
+    char *path;         /* lowercased, backslashes only */
+    DWORD size;
+    FILETIME mtime;
+    int format;
+    int deleted;
+} AssetIndexEntry;
+
+static AssetIndexEntry *g_index = NULL;
+static long g_indexSize = 0;        /* power of two, 0 = not built */
+static long g_indexCount = 0;
+static CRITICAL_SECTION g_indexLock;
+static int g_indexLockInit = 0;
+
+static unsigned long index_hash(const char *key) {
+    unsigned long h = 5381;
+    while (*key) h = h * 33 + (unsigned char)*key++;
+    return h;
+}
+
+/* Slot holding 'key', or the empty slot where it would go */
+static AssetIndexEntry *index_slot(const char *key) {
+    unsigned long h = index_hash(key) & (g_indexSize - 1);
+    while (g_index[h].path && strcmp(g_index[h].path, key) != 0) {
+        h = (h + 1) & (g_indexSize - 1);
+    }
+    return &g_index[h];
+}
+
+static int index_grow(void) {
+    long oldsize = g_indexSize;
+    AssetIndexEntry *old = g_index;
+    long newsize = oldsize ? oldsize * 2 : 256;
+    AssetIndexEntry *tab = (AssetIndexEntry *)calloc(newsize, sizeof(AssetIndexEntry));
+    if (!tab) return -1;
+
+    g_index = tab;
+    g_indexSize = newsize;
+    for (long i = 0; i < oldsize; i++) {
+        if (old[i].path) *index_slot(old[i].path) = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+static void index_put(const char *path, const WIN32_FIND_DATAA *fd) {
+    char key[260];
+    asset_key(key, path);
+    if ((g_indexCount + 1) * 2 > g_indexSize && index_grow() != 0) return;
+
+    AssetIndexEntry *e = index_slot(key);
+    if (!e->path) {
+        e->path = (char *)malloc(strlen(key) + 1);
+        if (!e->path) return;
+        strcpy(e->path, key);
+        g_indexCount++;
+    }
+    e->size = fd->nFileSizeLow;
+    e->mtime = fd->ftLastWriteTime;
+    e->format = ASSET_FMT_UNKNOWN;
+    e->deleted = 0;
+}
+
+static void index_scan(const char *dir) {
+    char pattern[260];
+    WIN32_FIND_DATAA fd;
+
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return;
+    do {
+        char path[260];
+        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s\\%s", dir, fd.cFileName);
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            index_scan(path);
+        } else {
+            index_put(path, &fd);
+        }
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+}
+
+static void index_clear(void) {
+    for (long i = 0; i < g_indexSize; i++) free(g_index[i].path);
+    free(g_index);
+    g_index = NULL;
+    g_indexSize = 0;
+    g_indexCount = 0;
+}
+
+/* (Re)build the index of data\ */
+static void AssetIndexBuild(void) {
+    if (!g_indexLockInit) {
+        InitializeCriticalSection(&g_indexLock);
+        g_indexLockInit = 1;
+    }
+    EnterCriticalSection(&g_indexLock);
+    index_clear();
+    if (index_grow() == 0) index_scan("data");
+    LeaveCriticalSection(&g_indexLock);
+}
+
+static void AssetIndexFree(void) {
+    if (!g_indexLockInit) return;
+    index_clear();
+    DeleteCriticalSection(&g_indexLock);
+    g_indexLockInit = 0;
+}
+
+/* Key can be in the index (under data\), whether it is built is checked
+ * under the lock since a rebuild may be running */
+static int index_covers(const char *key) {
+    return g_indexLockInit && strncmp(key, "data\\", 5) == 0;
+}
+
+/* Copy the entry for 'path'. Returns 1 if found, 0 if absent,
+ * -1 if the path isn't covered by the index. */
+static int AssetIndexLookup(const char *path, AssetIndexEntry *out) {
+    char key[260];
+    asset_key(key, path);
+
+    const ArchiveEntry *a = ArchiveFind(key);
+    if (a) {
+        if (out) {
+            memset(out, 0, sizeof(AssetIndexEntry));
+            out->size = a->rawsize;
+            out->format = a->format;
+        }
+        return 1;
+    }
+    if (!index_covers(key)) return -1;
+
+    EnterCriticalSection(&g_indexLock);
+    if (g_indexSize == 0) {
+        LeaveCriticalSection(&g_indexLock);
+        return -1;
+    }
+    AssetIndexEntry *e = index_slot(key);
+    int found = e->path && !e->deleted;
+    if (found && out) *out = *e;
+    LeaveCriticalSection(&g_indexLock);
+    return found;
+}
+
+/* Refresh a single entry after the engine wrote or removed the file */
+static void AssetIndexUpdate(const char *path) {
+    WIN32_FIND_DATAA fd;
+    char key[260];
+    asset_key(key, path);
+    if (!index_covers(key)) return;
+
+    HANDLE h = FindFirstFileA(path, &fd);
+    EnterCriticalSection(&g_indexLock);
+    if (g_indexSize == 0) {
+        /* Index was dropped meanwhile */
+    } else if (h != INVALID_HANDLE_VALUE) {
+        index_put(path, &fd);
+    } else {
+        AssetIndexEntry *e = index_slot(key);
+        if (e->path) e->deleted = 1;
+    }
+    LeaveCriticalSection(&g_indexLock);
+    if (h != INVALID_HANDLE_VALUE) FindClose(h);
+}
+
+/* Read the header of a file */
+static int sniff_format(const char *path) {
+    uint8_t header[8];
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return ASSET_FMT_UNKNOWN;
+
+    size_t got = fread(header, 1, 8, fp);
+    fclose(fp);
+    return w3p_sniff(header, (uint32_t)got);
+}
+
+/* Format of a file, sniffed once per index entry */
+static int AssetIndexFormat(const char *path) {
+    AssetIndexEntry entry;
+    int found = AssetIndexLookup(path, &entry);
+
+    if (found == 0) return ASSET_FMT_UNKNOWN;
+    if (found == 1 && entry.format != ASSET_FMT_UNKNOWN) return entry.format;
+
+    int format = sniff_format(path);
+    if (found == 1 && format != ASSET_FMT_UNKNOWN) {
+        char key[260];
+        asset_key(key, path);
+        EnterCriticalSection(&g_indexLock);
+        AssetIndexEntry *e = g_indexSize ? index_slot(key) : NULL;
+        if (e && e->path) e->format = format;
+        LeaveCriticalSection(&g_indexLock);
+    }
+    return format;
+}
@@ -0,0 +1,105 @@
+/*
+ *      Pixel blending for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Premultiplied alpha, out = src + dst * (255 - a) / 255, with the
+ *      division done as ((x + 128) * 257) >> 16, exact for 16-bit products.
+ *      Crossfades mix two opaque images as (a * (256 - t) + b * t) >> 8.
+ *      Uses SSE2, 4 pixels at a time, when the compiler targets it, and a
+ *      two-channels-per-multiply scalar version otherwise (OpenWatcom).
+ */
+
+/* Included into w3vn.c before func.c */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define W3VN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* x / 255 rounded, on two 8.8 channels of a 32-bit word at once */
+#define DIV255_PAIR(x) ((((x) + 0x00800080) + ((((x) + 0x00800080) >> 8) & 0x00ff00ff)) >> 8 & 0x00ff00ff)
+
+/* Premultiply 0xAARRGGBB pixels in place */
+static void PremultiplyPixels(uint32_t *px, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t c = px[i];
+        uint32_t a = c >> 24;
+        if (a == 255) continue;
+        uint32_t rb = (c & 0x00ff00ff) * a;
+        uint32_t g = ((c >> 8) & 0xff) * a;
+        px[i] = (a << 24) | DIV255_PAIR(rb) | (DIV255_PAIR(g) << 8);
+    }
+}
+
+/* Blend one premultiplied pixel over an opaque one */
+static uint32_t blend_pixel(uint32_t src, uint32_t dst) {
+    uint32_t ia = 255 - (src >> 24);
+    uint32_t rb = (dst & 0x00ff00ff) * ia;
+    uint32_t g = ((dst >> 8) & 0xff) * ia;
+    return (src + (DIV255_PAIR(rb) | (DIV255_PAIR(g) << 8))) | 0xff000000;
+}
+
+/* Blend 'count' premultiplied pixels over dst */
+static void BlendSpan(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+#ifdef W3VN_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi32(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i c257 = _mm_set1_epi16(257);
+    const __m128i opaque = _mm_set1_epi32((int)0xff000000);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        /* 255 - alpha in all four 16-bit lanes of each pixel */
+        __m128i ia = _mm_sub_epi32(c255, _mm_srli_epi32(s, 24));
+        ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+        __m128i ia_lo = _mm_unpacklo_epi32(ia, ia);
+        __m128i ia_hi = _mm_unpackhi_epi32(ia, ia);
+
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia_lo);
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia_hi);
+        lo = _mm_mulhi_epu16(_mm_add_epi16(lo, c128), c257);
+        hi = _mm_mulhi_epu16(_mm_add_epi16(hi, c128), c257);
+
+        __m128i out = _mm_add_epi8(s, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(out, opaque));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = blend_pixel(src[i], dst[i]);
+    }
+}
+
+/* dst = a + (b - a) * t / 256 on each channel, t from 0 to 256 */
+static void LerpSpan(uint32_t *dst, const uint32_t *a, const uint32_t *b, int count, int t) {
+    uint32_t ta = (uint32_t)(256 - t), tb = (uint32_t)t;
+    int i = 0;
+#ifdef W3VN_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16((short)ta);
+    const __m128i wb = _mm_set1_epi16((short)tb);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pa = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i pb = _mm_loadu_si128((const __m128i *)(b + i));
+
+        /* At most 255 * 256 per 16-bit lane, no overflow */
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), wb));
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t ca = a[i], cb = b[i];
+        uint32_t rb = ((ca & 0x00ff00ff) * ta + (cb & 0x00ff00ff) * tb) >> 8 & 0x00ff00ff;
+        uint32_t ag = (((ca >> 8) & 0x00ff00ff) * ta + ((cb >> 8) & 0x00ff00ff) * tb) & 0xff00ff00;
+        dst[i] = rb | ag;
+    }
+}
@@ -0,0 +1,229 @@
+/*
+ *      Decoded asset cache for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Keeps decoded backgrounds and sprites (32-bit BGRA, or the row spans
+ *      of run-length sprites) keyed by path,
+ *      evicting least recently used entries past ASSET_CACHE_BUDGET bytes.
+ *      Entries can be filled by the prefetch worker thread, so every access
+ *      goes through g_assetLock.
+ */
+
+/* Included into w3vn.c before func.c */
+
+#define ASSET_EMPTY   0
+#define ASSET_LOADING 1
+#define ASSET_READY   2
+
+/* Legacy text sprites are never drawn on the last screen column */
+#define ASSET_LEGACY  1
+
+/* Run of sprite pixels to copy (opaque) or blend, the rest is skipped */
+typedef struct {
+    uint16_t x;
+    uint16_t len;
+    uint16_t opaque;
+} SpriteSpan;
+
+/* Decoded image, 0xAARRGGBB pixels, or W3S rows for run-length sprites.
+ * Sprite pixels are premultiplied, with spans listed per row. Animations
+ * are an atlas of 'frames' side by side with their durations. */
+typedef struct {
+    int width;
+    int height;
+    int flags;
+    uint32_t *pixels;
+    uint8_t *runs;
+    size_t runsize;
+    SpriteSpan *spans;
+    uint32_t *rowspans;     /* first span of each row, height + 1 entries */
+    int frames;             /* 0 for a still sprite */
+    uint32_t *delays;       /* ms per frame */
+} AssetImage;
+
+typedef struct {
+    char path[260];
+    int kind;
+    int state;
+    int refs;
+    DWORD stamp;
+    AssetImage img;
+} AssetEntry;
+
+static AssetEntry g_assets[ASSET_CACHE_SLOTS];
+static CRITICAL_SECTION g_assetLock;
+static size_t g_assetBytes = 0;
+static DWORD g_assetClock = 0;
+
+static size_t asset_bytes(const AssetImage *img) {
+    size_t bytes = img->frames * sizeof(uint32_t);
+    if (img->runs) return bytes + img->runsize;
+    bytes += (size_t)img->width * img->height * sizeof(uint32_t);
+    if (img->rowspans) {
+        bytes += (img->height + 1) * sizeof(uint32_t) + img->rowspans[img->height] * sizeof(SpriteSpan);
+    }
+    return bytes;
+}
+
+static void asset_image_free(AssetImage *img) {
+    free(img->pixels);
+    free(img->runs);
+    free(img->spans);
+    free(img->rowspans);
+    free(img->delays);
+}
+
+static void asset_free(AssetEntry *e) {
+    if (e->state == ASSET_READY) g_assetBytes -= asset_bytes(&e->img);
+    asset_image_free(&e->img);
+    memset(e, 0, sizeof(AssetEntry));
+}
+
+/* Find an entry by path and kind, caller holds the lock */
+static AssetEntry *asset_find(const char *path, int kind) {
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        if (g_assets[i].state != ASSET_EMPTY && g_assets[i].kind == kind &&
+            strcmp(g_assets[i].path, path) == 0) return &g_assets[i];
+    }
+    return NULL;
+}
+
+/* Least recently used unreferenced entry, skipping 'keep' */
+static AssetEntry *asset_lru(AssetEntry *keep) {
+    AssetEntry *lru = NULL;
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        AssetEntry *e = &g_assets[i];
+        if (e == keep || e->state != ASSET_READY || e->refs > 0) continue;
+        if (!lru || (DWORD)(g_assetClock - e->stamp) > (DWORD)(g_assetClock - lru->stamp)) lru = e;
+    }
+    return lru;
+}
+
+/* Get a free slot, evicting if the table is full */
+static AssetEntry *asset_slot(void) {
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        if (g_assets[i].state == ASSET_EMPTY) return &g_assets[i];
+    }
+    AssetEntry *e = asset_lru(NULL);
+    if (e) asset_free(e);
+    return e;
+}
+
+/* Evict until 'bytes' more fit in the budget (or nothing is left to evict) */
+static void asset_trim(size_t bytes, AssetEntry *keep) {
+    while (g_assetBytes + bytes > ASSET_CACHE_BUDGET) {
+        AssetEntry *e = asset_lru(keep);
+        if (!e) break;
+        asset_free(e);
+    }
+}
+
+static void AssetCacheInit(void) {
+    memset(g_assets, 0, sizeof(g_assets));
+    g_assetBytes = 0;
+    InitializeCriticalSection(&g_assetLock);
+}
+
+static void AssetCacheShutdown(void) {
+    EnterCriticalSection(&g_assetLock);
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        if (g_assets[i].state != ASSET_EMPTY) asset_free(&g_assets[i]);
+    }
+    LeaveCriticalSection(&g_assetLock);
+    DeleteCriticalSection(&g_assetLock);
+}
+
+/* Look up a decoded asset and take a reference, waiting if the worker is
+ * still decoding it. Returns NULL on a miss. */
+static AssetImage *AssetCacheAcquire(const char *path, int kind) {
+    while (1) {
+        EnterCriticalSection(&g_assetLock);
+        AssetEntry *e = asset_find(path, kind);
+        if (e && e->state == ASSET_LOADING) {
+            LeaveCriticalSection(&g_assetLock);
+            Sleep(1);
+            continue;
+        }
+        if (e) {
+            e->refs++;
+            e->stamp = ++g_assetClock;
+        }
+        LeaveCriticalSection(&g_assetLock);
+        return e ? &e->img : NULL;
+    }
+}
+
+static void AssetCacheRelease(AssetImage *img) {
+    if (!img) return;
+    EnterCriticalSection(&g_assetLock);
+    AssetEntry *e = (AssetEntry *)((char *)img - offsetof(AssetEntry, img));
+    if (e->refs > 0) e->refs--;
+    LeaveCriticalSection(&g_assetLock);
+}
+
+/* Non-blocking presence check, used by the prefetcher to skip queued work */
+static int AssetCacheContains(const char *path, int kind) {
+    EnterCriticalSection(&g_assetLock);
+    int found = asset_find(path, kind) != NULL;
+    LeaveCriticalSection(&g_assetLock);
+    return found;
+}
+
+/* Store a freshly decoded image (the cache takes over its buffers) and return
+ * it referenced. If another thread inserted it meanwhile, that copy wins. */
+static AssetImage *AssetCacheInsert(const char *path, int kind, AssetImage *img) {
+    EnterCriticalSection(&g_assetLock);
+    AssetEntry *e = asset_find(path, kind);
+    if (e && e->state == ASSET_READY) {
+        asset_image_free(img);
+    } else {
+        if (!e) e = asset_slot();
+        if (!e) {
+            LeaveCriticalSection(&g_assetLock);
+            asset_image_free(img);
+            return NULL;
+        }
+        asset_trim(asset_bytes(img), e);
+        snprintf(e->path, sizeof(e->path), "%s", path);
+        e->kind = kind;
+        e->img = *img;
+        e->state = ASSET_READY;
+        g_assetBytes += asset_bytes(img);
+    }
+    e->refs++;
+    e->stamp = ++g_assetClock;
+    LeaveCriticalSection(&g_assetLock);
+    return &e->img;
+}
+
+/* Claim a slot for background decoding. Returns NULL if the asset is already
+ * cached or being decoded. */
+static AssetEntry *AssetCacheReserve(const char *path, int kind) {
+    EnterCriticalSection(&g_assetLock);
+    AssetEntry *e = NULL;
+    if (!asset_find(path, kind)) {
+        e = asset_slot();
+        if (e) {
+            snprintf(e->path, sizeof(e->path), "%s", path);
+            e->kind = kind;
+            e->state = ASSET_LOADING;
+        }
+    }
+    LeaveCriticalSection(&g_assetLock);
+    return e;
+}
+
+/* Complete a reserved slot, img == NULL releases it after a failed decode */
+static void AssetCacheFill(AssetEntry *e, AssetImage *img) {
+    EnterCriticalSection(&g_assetLock);
+    if (img) {
+        asset_trim(asset_bytes(img), e);
+        e->img = *img;
+        e->state = ASSET_READY;
+        e->stamp = ++g_assetClock;
+        g_assetBytes += asset_bytes(img);
+    } else {
+        memset(e, 0, sizeof(AssetEntry));
+    }
+    LeaveCriticalSection(&g_assetLock);
+}
@@ -0,0 +1,261 @@
+/*
+ *      Screen capture for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      'P' saves the screen as it is presented to data\shots\SHOTnnnn.PNG,
+ *      shift+'P' starts or stops saving every presented frame as
+ *      data\shots\RttFffff.PNG for trailers. Taking a frame only copies it,
+ *      the PNG is written by a worker thread at zlib's fastest level, or a
+ *      few rows per idle slice on Win32s which has no threads.
+ */
+
+/* Included into w3vn.c after func.c */
+
+#define CAPTURE_QUEUE_MAX  4
+#define CAPTURE_IDLE_ROWS  32
+
+typedef struct {
+    uint32_t *pixels;           /* whole screen, top-down */
+    char path[32];
+} CaptureJob;
+
+/* PNG being written, by the worker or across idle slices */
+typedef struct {
+    CaptureJob job;
+    FILE *fp;
+    png_structp png;
+    png_infop info;
+    int row;
+} CaptureOut;
+
+static CaptureJob g_captureQueue[CAPTURE_QUEUE_MAX];
+static int g_captureHead = 0;
+static int g_captureCount = 0;
+static CaptureOut g_captureOut;
+static CRITICAL_SECTION g_captureLock;
+static HANDLE g_captureThread = NULL;
+static HANDLE g_captureWake = NULL;
+static volatile int g_captureQuit = 0;
+
+static int g_shotNext = 1;      /* next SHOTnnnn number to try */
+static int g_recordTake = 0;    /* RttFffff take while recording, else 0 */
+static long g_recordFrame = 0;
+
+static int capture_exists(const char *path) {
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+/* Drop the PNG being written, the file is left incomplete */
+static void capture_end(void) {
+    png_destroy_write_struct(&g_captureOut.png, &g_captureOut.info);
+    if (g_captureOut.fp) fclose(g_captureOut.fp);
+    free(g_captureOut.job.pixels);
+    memset(&g_captureOut, 0, sizeof(g_captureOut));
+}
+
+/* Open the file and write the PNG header of a job */
+static int capture_begin(const CaptureJob *job) {
+    g_captureOut.job = *job;
+    g_captureOut.fp = fopen(job->path, "wb");
+    if (g_captureOut.fp) {
+        g_captureOut.png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+        if (g_captureOut.png) g_captureOut.info = png_create_info_struct(g_captureOut.png);
+    }
+    if (!g_captureOut.info) {
+        capture_end();
+        return -1;
+    }
+    if (setjmp(png_jmpbuf(g_captureOut.png))) {
+        capture_end();
+        return -1;
+    }
+    png_init_io(g_captureOut.png, g_captureOut.fp);
+    png_set_compression_level(g_captureOut.png, Z_BEST_SPEED);
+    png_set_filter(g_captureOut.png, 0, PNG_FILTER_SUB);
+    png_set_IHDR(g_captureOut.png, g_captureOut.info, SCREEN_WIDTH, SCREEN_HEIGHT, 8,
+                 PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(g_captureOut.png, g_captureOut.info);
+    png_set_bgr(g_captureOut.png);
+    png_set_filler(g_captureOut.png, 0, PNG_FILLER_AFTER);
+    g_captureOut.row = 0;
+    return 0;
+}
+
+/* Write up to 'rows' more rows, then close the file once all are done */
+static void capture_rows(int rows) {
+    if (setjmp(png_jmpbuf(g_captureOut.png))) {
+        capture_end();
+        return;
+    }
+    while (rows-- > 0 && g_captureOut.row < SCREEN_HEIGHT) {
+        png_write_row(g_captureOut.png,
+                      (png_const_bytep)(g_captureOut.job.pixels + g_captureOut.row * SCREEN_WIDTH));
+        g_captureOut.row++;
+    }
+    if (g_captureOut.row == SCREEN_HEIGHT) {
+        png_write_end(g_captureOut.png, NULL);
+        capture_end();
+    }
+}
+
+/* Write 'rows' rows of the next PNG, returns 0 when there is nothing to do */
+static int CaptureStep(int rows) {
+    if (!g_captureOut.png) {
+        CaptureJob job;
+        EnterCriticalSection(&g_captureLock);
+        if (g_captureCount == 0) {
+            LeaveCriticalSection(&g_captureLock);
+            return 0;
+        }
+        job = g_captureQueue[g_captureHead];
+        g_captureHead = (g_captureHead + 1) % CAPTURE_QUEUE_MAX;
+        g_captureCount--;
+        LeaveCriticalSection(&g_captureLock);
+        if (capture_begin(&job) != 0) return 1;
+    }
+    capture_rows(rows);
+    return 1;
+}
+
+static DWORD WINAPI CaptureThreadProc(LPVOID param) {
+    (void)param;
+    while (!g_captureQuit) {
+        WaitForSingleObject(g_captureWake, INFINITE);
+        while (!g_captureQuit && CaptureStep(SCREEN_HEIGHT));
+    }
+    return 0;
+}
+
+/* Start the worker (not on Win32s) */
+static void CaptureInit(void) {
+    InitializeCriticalSection(&g_captureLock);
+    if (!IsWin32s()) {
+        DWORD tid;
+        g_captureWake = CreateEventA(NULL, FALSE, FALSE, NULL);
+        if (g_captureWake) {
+            g_captureThread = CreateThread(NULL, 0, CaptureThreadProc, NULL, 0, &tid);
+            if (g_captureThread) {
+                SetThreadPriority(g_captureThread, THREAD_PRIORITY_BELOW_NORMAL);
+            } else {
+                CloseHandle(g_captureWake);
+                g_captureWake = NULL;
+            }
+        }
+    }
+}
+
+/* Stop the worker, then write whatever is still queued */
+static void CaptureShutdown(void) {
+    g_recordTake = 0;
+    if (g_captureThread) {
+        g_captureQuit = 1;
+        SetEvent(g_captureWake);
+        WaitForSingleObject(g_captureThread, INFINITE);
+        CloseHandle(g_captureThread);
+        CloseHandle(g_captureWake);
+        g_captureThread = NULL;
+        g_captureWake = NULL;
+    }
+    while (CaptureStep(SCREEN_HEIGHT));
+    DeleteCriticalSection(&g_captureLock);
+}
+
+/* Copy the screen as presented and queue it for 'path'. 'bottomup' is the
+ * composed frame when the caller has it, else the layers are composed */
+static void capture_push(const uint32_t *bottomup, const char *path) {
+    uint32_t *pixels = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    if (!pixels) return;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        if (bottomup) {
+            memcpy(pixels + y * SCREEN_WIDTH, bottomup + (SCREEN_HEIGHT - 1 - y) * SCREEN_WIDTH,
+                   SCREEN_WIDTH * sizeof(uint32_t));
+        } else {
+            LayerComposeRow(pixels + y * SCREEN_WIDTH, y);
+        }
+    }
+
+    /* When the queue is full, wait for the worker or make room ourselves */
+    for (;;) {
+        EnterCriticalSection(&g_captureLock);
+        if (g_captureCount < CAPTURE_QUEUE_MAX) {
+            CaptureJob *job = &g_captureQueue[(g_captureHead + g_captureCount) % CAPTURE_QUEUE_MAX];
+            job->pixels = pixels;
+            snprintf(job->path, sizeof(job->path), "%s", path);
+            g_captureCount++;
+            LeaveCriticalSection(&g_captureLock);
+            break;
+        }
+        LeaveCriticalSection(&g_captureLock);
+        if (g_captureThread) Sleep(1);
+        else CaptureStep(SCREEN_HEIGHT);
+    }
+    if (g_captureThread) SetEvent(g_captureWake);
+}
+
+/* One-line box in the middle of the image area, closed again at once: it
+ * stays on screen until the next present draws over it */
+static void capture_notice(const char *text) {
+    int w = (int)strlen(text) * 8 + 6, h = 19;
+    int x = (SCREEN_WIDTH - w) / 2, y = (TEXT_AREA_START - h) / 2;
+    int saved_x = g_cursorX, saved_y = g_cursorY, open = g_overlayCount;
+
+    OverlayOpen(x, y, w, h);
+    if (g_overlayCount == open) return;
+    locate(x + 3, y + 2);
+    while (*text) print_char(*text++);
+    DrawHLine(x, y, x + w - 1);
+    DrawHLine(x, y + h - 1, x + w - 1);
+    DrawVLine(x, y, y + h - 1);
+    DrawVLine(x + w - 1, y, y + h - 1);
+    update_display();
+    OverlayClose();
+    locate(saved_x, saved_y);
+}
+
+/* 'P': queue a screenshot under the first free SHOTnnnn name, none is
+ * taken once all of them are used */
+static void CaptureScreen(void) {
+    char path[32];
+    CreateDirectoryA("data\\shots", NULL);
+    while (g_shotNext <= 9999) {
+        snprintf(path, sizeof(path), "data\\shots\\SHOT%04d.PNG", g_shotNext++);
+        if (!capture_exists(path)) {
+            capture_push(NULL, path);
+            return;
+        }
+    }
+    capture_notice("No free screenshot name");
+}
+
+/* Shift+'P': start a new take, or end the current one */
+static void CaptureRecord(void) {
+    char path[32];
+    if (g_recordTake) {
+        g_recordTake = 0;
+        return;
+    }
+    CreateDirectoryA("data\\shots", NULL);
+    for (int take = 1; take <= 99; take++) {
+        snprintf(path, sizeof(path), "data\\shots\\R%02dF0000.PNG", take);
+        if (!capture_exists(path)) {
+            g_recordTake = take;
+            g_recordFrame = 0;
+            return;
+        }
+    }
+    capture_notice("No free recording take");
+}
+
+/* A frame was presented, 'bottomup' as in capture_push() */
+static void CapturePresented(const uint32_t *bottomup) {
+    char path[32];
+    if (!g_recordTake || g_recordFrame > 9999) return;
+    snprintf(path, sizeof(path), "data\\shots\\R%02dF%04ld.PNG", g_recordTake, g_recordFrame++);
+    capture_push(bottomup, path);
+}
+
+/* Idle slice while waiting for input: a few rows without a worker */
+static void CaptureIdle(void) {
+    if (!g_captureThread) CaptureStep(CAPTURE_IDLE_ROWS);
+}
@@ -19,6 +19,11 @@
  */
 
 #include "global.h"
+#include "w3i.h"
+#include "w3s.h"
+#include "w3m.h"
+#include "w3v.h"
+#include "wav.h"
 
 /* Forward declarations */
 static void update_display(void);
@@ -26,10 +31,26 @@ static void RestartMusic(void);
 static void CheckMusicStatus(void);
 static void ShowConfigDialog(void);
 static int LoadBackgroundImage(const char *picture, uint8_t *bgpalette, uint32_t *background);
+static AssetImage *AssetLoad(const char *path, int kind);
+static int AssetDecode(const char *path, int kind, AssetImage *out);
+static int file_exists(const char *pathname);
 static void CloseMidiSfx(void);
 static void PlayMidiSfx(DWORD msg);
 static void CloseWavSfx(void);
 static void PlayWavSfx(const char *filename);
+static void PresentRect(const RECT *r);
+static void AnimTick(void);
+static void PrefetchIdle(void);
+static void CaptureIdle(void);
+static void CaptureScreen(void);
+static void CaptureRecord(void);
+static void CapturePresented(const uint32_t *bottomup);
+static int MixerPlay(const char *path, int volume);
+static void MixerStop(void);
+static void MixerIdle(void);
+static int MusicStart(const char *path, int fade, long loopstart, long loopend);
+static void MusicStop(void);
+static void MusicSetVolume(int volume);
 
 /* Configuration dialog control IDs */
 #define IDC_VOLUME_LABEL    101
@@ -46,10 +67,10 @@ static HWND g_configDialog = NULL;
 static int g_recenterDialog = 0;
 static int g_repositionWindow = 0;
 static DWORD g_lastrender = 0;
-static DWORD g_renderthrottle = 15;
 
 /* Wine workarounds */
 #define IsWine() (GetProcAddress(GetModuleHandle("ntdll.dll"), "wine_get_version") != NULL)
+#define IsWin32s() ((GetVersion() & 0x80000000) && LOBYTE(LOWORD(GetVersion())) < 4)
 static int g_dialogCreating = 0;
 static int g_wineVolume = -1;
 extern int g_sfxVolume;
@@ -80,29 +101,51 @@ static void RecenterConfigDialog(void) {
     SetWindowPos(g_configDialog, HWND_TOP, x, y, 0, 0, SWP_NOSIZE);
 }
 
-static void PlayMusic(const char *filename) {
+/* Play 'spec', a path optionally followed by |fade ms|loop start|loop end
+ * (in sample frames). WAVs the mixer can decode are streamed and crossfade
+ * with the current track, the rest goes through MCI */
+static void PlayMusic(const char *spec) {
     MCI_OPEN_PARMS mciOpen;
     MCI_PLAY_PARMS mciPlay;
     DWORD dwReturn;
     char fullpath[260];
+    char filename[260];
+    int fade = 0;
+    long loopstart = -1, loopend = -1;
+    const char *opts = strchr(spec, '|');
+
+    snprintf(filename, sizeof(filename), "%.*s", opts ? (int)(opts - spec) : 259, spec);
+    if (opts) sscanf(opts, "|%d|%ld|%ld", &fade, &loopstart, &loopend);
 
     /* Stop any currently playing music */
     if (g_mciDeviceID != 0) {
+        KillTimer(g_hwnd, MUSIC_TIMER_ID);
         mciSendCommand(g_mciDeviceID, MCI_STOP, 0, 0);
         mciSendCommand(g_mciDeviceID, MCI_CLOSE, 0, 0);
         g_mciDeviceID = 0;
     }
 
-    /* Get full path to the file */
-    if (GetFullPathNameA(filename, 260, fullpath, NULL) == 0) {
-        strncpy(fullpath, filename, 259);
-        fullpath[259] = '\0';
+    /* Check if file exists */
+    if (file_exists(filename) != 0) {
+        MusicStop();
+        return;
     }
 
-    /* Check if file exists */
-    if (GetFileAttributesA(fullpath) == INVALID_FILE_ATTRIBUTES) {
+    if (MusicStart(filename, fade, loopstart, loopend) == 0) {
+        g_currentMusic[0] = '\0';
         return;
     }
+    MusicStop();
+
+    /* Get full path to the file, packed music is extracted first */
+    char localpath[260];
+    if (AssetLocalPath(filename, localpath, sizeof(localpath)) != 0) {
+        return;
+    }
+    if (GetFullPathNameA(localpath, 260, fullpath, NULL) == 0) {
+        strncpy(fullpath, localpath, 259);
+        fullpath[259] = '\0';
+    }
 
     /* Open the audio file */
     memset(&mciOpen, 0, sizeof(mciOpen));
@@ -169,6 +212,7 @@ static void CheckMusicStatus(void) {
 
 /* Stop currently playing music */
 static void StopMusic(void) {
+    MusicStop();
     if (g_mciDeviceID != 0) {
         KillTimer(g_hwnd, MUSIC_TIMER_ID);
         mciSendCommand(g_mciDeviceID, MCI_STOP, 0, 0);
@@ -246,18 +290,18 @@ static void PlayVideo(const char *filename) {
         g_videoWindow = NULL;
     }
 
-    /* Open the video file */
-    snprintf(cmd, sizeof(cmd), "open \"%s\" alias video", filename);
+    /* Open the video file, packed videos are extracted first */
+    char localpath[260];
+    if (AssetLocalPath(filename, localpath, sizeof(localpath)) != 0) {
+        return;
+    }
+    snprintf(cmd, sizeof(cmd), "open \"%s\" alias video", localpath);
     if (mciSendString(cmd, NULL, 0, NULL) != 0) {
         return;
     }
 
     /* Fill image area with black for letterboxing */
-    int i;
-    int image_pixels = SCREEN_WIDTH * TEXT_AREA_START;
-    for (i = 0; i < image_pixels; i++) {
-        g_videoram[i] = COLOR_BLACK;
-    }
+    draw_fill(g_videoram, COLOR_BLACK, IMAGE_AREA_PIXELS);
     update_display();
 
     /* Get video native dimensions */
@@ -559,26 +603,146 @@ static const uint8_t g_font8x15[224][15] = {
     {0x00,0x00,0xF0,0x60,0x60,0x7C,0x66,0x66,0x66,0x66,0x7C,0x60,0x60,0xF0,0x00}, /* 254 thorn */
     {0x00,0xCC,0x00,0x00,0x00,0xC6,0xC6,0xC6,0xC6,0xC6,0xC6,0x7E,0x06,0x0C,0xF8}, /* 255 y diar */
 };
+
+/* ── Glyph cache ────────────────────────────────────────────────────────── */
+
+/* Built once from g_font8x15:
+ *  - text glyphs, black on white pixel rows copied as is by print_char
+ *  - outlined glyphs for the rhythm game HUD: a 10x17 cell per glyph,
+ *    each pixel GLYPH_CLEAR, GLYPH_OUTLINE (within 1px of the glyph) or
+ *    GLYPH_FILL, drawn in one pass instead of 9 offset copies
+ *  - scaled outlined glyphs (countdown digits), made on first use */
+
+#define GLYPH_COUNT     224
+#define GLYPH_CELL_W    10
+#define GLYPH_CELL_H    17
+#define GLYPH_SCALED_MAX 8
+
+#define GLYPH_CLEAR     0
+#define GLYPH_OUTLINE   1
+#define GLYPH_FILL      2
+
+typedef struct {
+    int idx, scale;     /* scale 0: free slot */
+    int w, h;
+    uint8_t *cls;
+} ScaledGlyph;
+
+static uint32_t g_glyphText[GLYPH_COUNT][15][8];
+static uint8_t g_glyphOutlined[GLYPH_COUNT][GLYPH_CELL_H][GLYPH_CELL_W];
+static ScaledGlyph g_glyphScaled[GLYPH_SCALED_MAX];
+static int g_glyphScaledNext = 0;
+
+/* Mark the outline around the GLYPH_FILL pixels of a w x h class map */
+static void glyph_outline(uint8_t *cls, int w, int h) {
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (cls[y * w + x] != GLYPH_FILL) continue;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    uint8_t *p = &cls[(y + dy) * w + x + dx];
+                    if (*p == GLYPH_CLEAR) *p = GLYPH_OUTLINE;
+                }
+            }
+        }
+    }
+}
+
+static void GlyphCacheInit(void) {
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        uint8_t *cls = &g_glyphOutlined[i][0][0];
+        memset(cls, GLYPH_CLEAR, GLYPH_CELL_W * GLYPH_CELL_H);
+        for (int row = 0; row < 15; row++) {
+            uint8_t bits = g_font8x15[i][row];
+            for (int bit = 0; bit < 8; bit++) {
+                int set = (bits & (0x80 >> bit)) != 0;
+                g_glyphText[i][row][bit] = set ? COLOR_BLACK : COLOR_WHITE;
+                if (set) cls[(row + 1) * GLYPH_CELL_W + bit + 1] = GLYPH_FILL;
+            }
+        }
+        glyph_outline(cls, GLYPH_CELL_W, GLYPH_CELL_H);
+    }
+}
+
+static void GlyphCacheFree(void) {
+    for (int i = 0; i < GLYPH_SCALED_MAX; i++) {
+        free(g_glyphScaled[i].cls);
+        g_glyphScaled[i].cls = NULL;
+        g_glyphScaled[i].scale = 0;
+    }
+}
+
+/* Outlined glyph 'idx' at 'scale', each font pixel a scale x scale block */
+static const ScaledGlyph *glyph_scaled(int idx, int scale) {
+    for (int i = 0; i < GLYPH_SCALED_MAX; i++) {
+        if (g_glyphScaled[i].scale == scale && g_glyphScaled[i].idx == idx) return &g_glyphScaled[i];
+    }
+
+    int w = 8 * scale + 2, h = 15 * scale + 2;
+    uint8_t *cls = (uint8_t *)calloc((size_t)w * h, 1);
+    if (!cls) return NULL;
+    for (int row = 0; row < 15 * scale; row++) {
+        uint8_t bits = g_font8x15[idx][row / scale];
+        for (int x = 0; x < 8 * scale; x++) {
+            if (bits & (0x80 >> (x / scale))) cls[(row + 1) * w + x + 1] = GLYPH_FILL;
+        }
+    }
+    glyph_outline(cls, w, h);
+
+    /* Recycle slots in turn, a handful of digits are in use at a time */
+    ScaledGlyph *g = &g_glyphScaled[g_glyphScaledNext];
+    g_glyphScaledNext = (g_glyphScaledNext + 1) % GLYPH_SCALED_MAX;
+    free(g->cls);
+    g->idx = idx;
+    g->scale = scale;
+    g->w = w;
+    g->h = h;
+    g->cls = cls;
+    return g;
+}
+
+/* Blit an outlined class map with its top left at (x, y) into the image
+ * area. 'keep' is the class map of the glyph drawn just left of this one,
+ * whose fill stays over this glyph's outline, as if all outlines of a
+ * string were drawn before all fills. */
+static void GlyphBlitOutlined(const uint8_t *cls, int w, int h, int x, int y,
+                              uint32_t fg, const uint8_t *keep) {
+    for (int row = 0; row < h; row++) {
+        int py = y + row;
+        if (py < 0 || py >= TEXT_AREA_START) continue;
+        const uint8_t *src = cls + row * w;
+        uint32_t *dst = g_videoram + py * SCREEN_WIDTH;
+        for (int col = 0; col < w; col++) {
+            int px = x + col;
+            if (!src[col] || px < 0 || px >= SCREEN_WIDTH) continue;
+            if (src[col] == GLYPH_FILL) {
+                dst[px] = fg;
+            } else if (!(col < 2 && keep && keep[row * w + col + 8] == GLYPH_FILL)) {
+                dst[px] = COLOR_BLACK;
+            }
+        }
+    }
+}
+
 /* Draw a vertical line */
 static void DrawVLine(int x1, int y1, int y2) {
+    uint32_t *plane = LayerDrawPlane();
     for (int y = y1; y <= y2; y++) {
-        g_videoram[y * SCREEN_WIDTH + x1] = COLOR_BLACK;
+        plane[y * SCREEN_WIDTH + x1] = COLOR_BLACK;
     }
 }
 
 /* Draw a horizontal line */
 static void DrawHLine(int x1, int y1, int x2) {
-    uint32_t *ptr = g_videoram + y1 * SCREEN_WIDTH + x1;
-    for (int x = x1; x <= x2; x++) {
-        *ptr++ = COLOR_BLACK;
-    }
+    if (x2 >= SCREEN_WIDTH) x2 = SCREEN_WIDTH - 1;
+    draw_fill(LayerDrawPlane() + y1 * SCREEN_WIDTH + x1, COLOR_BLACK, x2 - x1 + 1);
 }
 
 static void RedrawBorder(void) {
-    DrawHLine(0, 320, 640);
-    DrawHLine(0, 399, 640);
-    DrawVLine(0, 320, 399);
-    DrawVLine(639, 320, 399);
+    DrawHLine(0, TEXT_AREA_START, SCREEN_WIDTH);
+    DrawHLine(0, SCREEN_HEIGHT - 1, SCREEN_WIDTH);
+    DrawVLine(0, TEXT_AREA_START, SCREEN_HEIGHT - 1);
+    DrawVLine(SCREEN_WIDTH - 1, TEXT_AREA_START, SCREEN_HEIGHT - 1);
 }
 
 /* Set cursor position (in pixels) */
@@ -589,7 +753,7 @@ static void locate(int x, int y) {
 
 /* Draw a single character at the current cursor position
  * Uses 8x15 VGA-style font
- * Text area (y >= 320) has 2 pixels offset for gap after border */
+ * Text area (y >= TEXT_AREA_START) has 2 pixels offset for gap after border */
 static void print_char(char c) {
     unsigned char uc = (unsigned char)c;
     int idx;
@@ -603,7 +767,7 @@ static void print_char(char c) {
     int px = g_cursorX;
     int py = g_cursorY;
 
-    /* Text area (y >= 320) gets 2 pixel right shift */
+    /* Text area gets 2 pixel right shift */
     if (py >= TEXT_AREA_START) {
         px += 2;
     }
@@ -613,40 +777,62 @@ static void print_char(char c) {
 
     if (px >= right_limit || py >= SCREEN_HEIGHT) return;
 
-    for (int row = 0; row < 15; row++) {
-        int screen_row = py + row;
-        if (screen_row >= SCREEN_HEIGHT) break;
-
-        uint8_t glyph_row = g_font8x15[idx][row];
-        uint32_t *pixel = g_videoram + screen_row * SCREEN_WIDTH + px;
+    uint32_t *plane = LayerDrawPlane();
+    if (plane == g_videoram && py >= TEXT_AREA_START) TextMarkRows(py, 15);
 
-        /* Write pixels for this row of the glyph, clipping at right boundary */
-        for (int bit = 0; bit < 8 && px + bit < right_limit; bit++) {
-            if (glyph_row & (0x80 >> bit)) {
-                pixel[bit] = COLOR_BLACK;
-            } else {
-                pixel[bit] = COLOR_WHITE;
-            }
-        }
+    /* Pre-expanded rows, clipped at the right boundary */
+    int width = right_limit - px < 8 ? right_limit - px : 8;
+    int rows = SCREEN_HEIGHT - py < 15 ? SCREEN_HEIGHT - py : 15;
+    for (int row = 0; row < rows; row++) {
+        memcpy(plane + (py + row) * SCREEN_WIDTH + px, g_glyphText[idx][row], width * sizeof(uint32_t));
     }
     g_cursorX += 8;
 }
 
-void CALLBACK Timer0Proc(HWND hWnd, unsigned int msg, unsigned int idTimer, DWORD dwTime)
-{
-    DWORD now = timeGetTime();
-    if ((now - g_lastrender) >= g_renderthrottle) {
-        update_display();
-    }
+/* Typewriter text: with a text delay, 'T' lines queue their glyphs and
+ * return, the main loop draws each one when due and presents its cell */
+typedef struct {
+    short x, y;         /* cursor position */
+    uint8_t ch;
+    DWORD due;
+} QueuedGlyph;
+
+static QueuedGlyph *g_reveal = NULL;
+static int g_revealCount = 0;
+static int g_revealNext = 0;
+static int g_revealCap = 0;
+static DWORD g_revealDue = 0;
+
+static void queue_glyph(char c) {
+    if (g_revealCount == g_revealCap) {
+        int cap = g_revealCap ? g_revealCap * 2 : 256;
+        QueuedGlyph *q = (QueuedGlyph *)realloc(g_reveal, cap * sizeof(QueuedGlyph));
+        if (!q) {
+            print_char(c);
+            return;
+        }
+        g_reveal = q;
+        g_revealCap = cap;
+    }
+    QueuedGlyph *g = &g_reveal[g_revealCount++];
+    g->x = (short)g_cursorX;
+    g->y = (short)g_cursorY;
+    g->ch = (uint8_t)c;
+    g->due = g_revealDue;
+    g_revealDue += (DWORD)g_textdelay;
+    g_cursorX += 8;
 }
 
-/* Print a string with optional per-character delay.
- * If a key is pressed during the delay, sets g_textskip to skip the rest
- * of the current text block (all consecutive 'T' lines). */
+/* Print a string with optional per-character delay. With a delay the
+ * glyphs are queued and drawn by TextRevealTick(), a key pressed before
+ * they are all out finishes the current text block (all consecutive 'T'
+ * lines) and sets g_textskip to print the rest of it at once. */
 static void print_string(const char *str) {
-    DWORD string_start = timeGetTime();
-    int char_count = 0;
-    if(g_textdelay > 0 && g_textskip > 0) SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
+    int delayed = g_textdelay > 0 && g_textskip > 0;
+    if (delayed && g_revealNext == g_revealCount) {
+        g_revealCount = g_revealNext = 0;
+        g_revealDue = timeGetTime();
+    }
     while (*str) {
         if (*str == '\n') {
             g_cursorX = 0;
@@ -654,44 +840,103 @@ static void print_string(const char *str) {
             g_cursorY += (g_cursorY >= TEXT_AREA_START) ? 15 : 16;
         } else if (*str == '\r') {
             g_cursorX = 0;
-        } else {
-            print_char(*str);
-            char_count++;
-            if (g_textdelay > 0 && g_textskip > 0) {
-                DWORD target = string_start + char_count * (DWORD)g_textdelay;
-                while ((int)(target - timeGetTime()) > 0) {
-                    MSG msg;
-                    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-                        if (msg.message == WM_QUIT) {
-                            g_running = 0;
-                            KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-                            return;
-                        }
-                        if (ConfigDialogMessage(&msg))
-                            continue;
-                        TranslateMessage(&msg);
-                        DispatchMessage(&msg);
-                    }
-                    if (g_lastkey) {
-                        g_lastkey = 0;
-                        g_textskip = -1;
-                        break;
-                    }
-                }
-            }
+        } else if ((unsigned char)*str >= 32) {
+            if (delayed) queue_glyph(*str);
+            else print_char(*str);
         }
         str++;
     }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
+}
+
+/* Draw the queued glyphs due by 'now' (all of them if 'all'), their cells
+ * are added to 'dirty'. Returns the number drawn */
+static int reveal_draw_due(DWORD now, int all, RECT *dirty) {
+    int saved_x = g_cursorX, saved_y = g_cursorY;
+    int drawn = 0;
+    while (g_revealNext < g_revealCount) {
+        QueuedGlyph *g = &g_reveal[g_revealNext];
+        if (!all && (int)(g->due - now) > 0) break;
+        g_cursorX = g->x;
+        g_cursorY = g->y;
+        print_char((char)g->ch);
+        g_revealNext++;
+
+        RECT cell;
+        cell.left = g->x + (g->y >= TEXT_AREA_START ? 2 : 0);
+        cell.top = g->y;
+        cell.right = cell.left + 8 > SCREEN_WIDTH ? SCREEN_WIDTH : cell.left + 8;
+        cell.bottom = cell.top + 15 > SCREEN_HEIGHT ? SCREEN_HEIGHT : cell.top + 15;
+        if (cell.left >= cell.right || cell.top >= cell.bottom) continue;
+        if (drawn++ == 0) *dirty = cell;
+        else UnionRect(dirty, dirty, &cell);
+    }
+    g_cursorX = saved_x;
+    g_cursorY = saved_y;
+    if (g_revealNext == g_revealCount) g_revealCount = g_revealNext = 0;
+    return drawn;
+}
+
+/* Draw and present the glyphs that are due, only their cells */
+static void TextRevealTick(void) {
+    RECT dirty;
+    if (g_revealNext == g_revealCount) return;
+    if (reveal_draw_due(timeGetTime(), 0, &dirty) == 0) return;
+    if (dirty.top < TEXT_AREA_START && dirty.bottom > TEXT_AREA_START) update_display();
+    else PresentRect(&dirty);
+}
+
+/* Draw the due glyphs (every one if 'all') without presenting, before a full frame */
+static void TextRevealDraw(int all) {
+    RECT dirty;
+    if (g_revealNext < g_revealCount) reveal_draw_due(timeGetTime(), all, &dirty);
+}
+
+/* Let the queued text play out. A key finishes it at once and skips the
+ * delay for the rest of the block; prefetch and animations run in between */
+static void TextRevealWait(void) {
+    while (g_revealNext < g_revealCount && g_running) {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                g_running = 0;
+                break;
+            }
+            if (ConfigDialogMessage(&msg))
+                continue;
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        if (g_lastkey) {
+            g_lastkey = 0;
+            g_textskip = -1;
+            TextRevealDraw(1);
+            update_display();
+            break;
+        }
+        TextRevealTick();
+        if (g_revealNext == g_revealCount) break;
+        PrefetchIdle();
+        CaptureIdle();
+        MixerIdle();
+        AnimTick();
+
+        int wait = (int)(g_reveal[g_revealNext].due - timeGetTime());
+        if (wait > 0) Sleep(wait < 5 ? wait : 5);
+    }
+    TextRevealDraw(1);
 }
 
 /* Clear the entire screen to white */
 static void clear_screen(void) {
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        g_videoram[i] = COLOR_WHITE;
-    }
+    draw_fill(g_videoram, COLOR_WHITE, SCREEN_WIDTH * SCREEN_HEIGHT);
+    /* Nothing printed, no dialog open */
+    g_textDirtyTop = SCREEN_HEIGHT;
+    g_textDirtyBottom = TEXT_AREA_START;
+    g_overlayCount = 0;
     g_cursorX = 0;
     g_cursorY = 0;
+    g_revealCount = g_revealNext = 0;
+    g_pal8Scene = g_pal8Text = 1;
 }
 
 /* HQ2x scaling functions: hybrid filtering with bilinear for image/text content
@@ -832,50 +1077,252 @@ static void hybrid_scale(uint32_t *src, int src_w, int src_h,
     }
 }
 
-/* Update the Windows display from our framebuffer */
-static void update_display(void) {
-    if (!g_hwnd || !g_videoram) return;
+/* Where the image and text areas land in the window */
+typedef struct {
+    int win_w, win_h;
+    int dest_x, dest_w;
+    int image_dest_y, image_scaled_h;
+    int text_dest_y, text_scaled_h;
+    int padding;
+} DisplayLayout;
 
+static int display_layout(DisplayLayout *l) {
     RECT rect;
     GetClientRect(g_hwnd, &rect);
-    int win_w = rect.right;
-    int win_h = rect.bottom;
-
-    if (win_w <= 0 || win_h <= 0) return;
+    l->win_w = rect.right;
+    l->win_h = rect.bottom;
 
-    int text_h = SCREEN_HEIGHT - TEXT_AREA_START;  /* 80 */
-    int image_h = TEXT_AREA_START;                  /* 320 */
+    if (l->win_w <= 0 || l->win_h <= 0) return -1;
 
     /* Calculate width preserving aspect ratio */
-    int dest_x, dest_w;
-    if (SCREEN_WIDTH * win_h > SCREEN_HEIGHT * win_w) {
+    if (SCREEN_WIDTH * l->win_h > SCREEN_HEIGHT * l->win_w) {
         /* Window is taller - use full width */
-        dest_w = win_w;
+        l->dest_w = l->win_w;
     } else {
         /* Window is wider - width based on height */
-        dest_w = (SCREEN_WIDTH * win_h) / SCREEN_HEIGHT;
+        l->dest_w = (SCREEN_WIDTH * l->win_h) / SCREEN_HEIGHT;
     }
-    dest_x = (win_w - dest_w) / 2;
+    l->dest_x = (l->win_w - l->dest_w) / 2;
 
     /* Textbox at bottom, scaled proportionally */
-    int text_scaled_h = (text_h * dest_w) / SCREEN_WIDTH;
-    int text_dest_y = win_h - text_scaled_h;
+    l->text_scaled_h = ((SCREEN_HEIGHT - TEXT_AREA_START) * l->dest_w) / SCREEN_WIDTH;
+    l->text_dest_y = l->win_h - l->text_scaled_h;
 
     /* Image above textbox, with padding split top and middle */
-    int image_scaled_h = (image_h * dest_w) / SCREEN_WIDTH;
-    int available_h = text_dest_y;
-    int padding = available_h - image_scaled_h;
-    int image_dest_y = padding / 2;
+    l->image_scaled_h = (TEXT_AREA_START * l->dest_w) / SCREEN_WIDTH;
+    l->padding = l->text_dest_y - l->image_scaled_h;
+    l->image_dest_y = l->padding / 2;
+    return 0;
+}
+
+/* 8-bpp presentation of frames with 256 colors or less, see pal8.h, on
+ * palette displays and Win32s where it saves GDI a conversion. Like the
+ * 16-bpp frame, the indexed frame is kept between presents and only the
+ * changed part of each row is indexed again. The palette keeps the colors
+ * it has seen and starts over once it is full */
+typedef struct {
+    BITMAPINFOHEADER header;
+    RGBQUAD colors[PAL8_COLORS];
+} Bitmap8Info;
+
+static Pal8 g_pal8;
+static HPALETTE g_hpal = NULL;
+static uint32_t g_hpalColors[PAL8_COLORS];
+static int g_hpalCount = 0;
+static int g_present8 = 0;
+static uint8_t *g_frame8 = NULL;
+static uint32_t *g_frame8src = NULL;    /* composed frame behind g_frame8 */
+static int g_frame8valid = 0;
+
+/* Index 'count' bottom-up rows from 'first' into g_frame8, 'rows' holding
+ * them. Returns the first row past 256 colors, or -1 */
+static int index_rows(const uint32_t *rows, int first, int count) {
+    for (int y = first; y < first + count; y++) {
+        const uint32_t *src = rows + (y - first) * SCREEN_WIDTH;
+        uint32_t *old = g_frame8src + y * SCREEN_WIDTH;
+        int x0 = 0, x1 = SCREEN_WIDTH;
+        if (g_frame8valid) {
+            if (memcmp(src, old, SCREEN_WIDTH * sizeof(uint32_t)) == 0) continue;
+            while (src[x0] == old[x0]) x0++;
+            while (src[x1 - 1] == old[x1 - 1]) x1--;
+        }
+        if (pal8_index_row(&g_pal8, src + x0, g_frame8 + y * SCREEN_WIDTH + x0, x1 - x0) != 0) return y;
+        memcpy(old + x0, src + x0, (x1 - x0) * sizeof(uint32_t));
+    }
+    return -1;
+}
+
+/* Bring g_frame8 up to date with a bottom-up composed frame. Returns -1,
+ * and marks the plane that overflowed, past 256 colors */
+static int index_frame(const uint32_t *frame) {
+    if (!g_present8 || !g_pal8Scene || !g_pal8Text) {
+        g_frame8valid = 0;
+        return -1;
+    }
+    for (;;) {
+        if (!g_frame8valid) pal8_reset(&g_pal8);
+        int y = index_rows(frame, 0, SCREEN_HEIGHT);
+        if (y < 0) break;
+
+        /* Full of old colors: index the whole frame afresh. Already fresh:
+         * the plane of this row has too many colors */
+        if (g_frame8valid) {
+            g_frame8valid = 0;
+            continue;
+        }
+        if (SCREEN_HEIGHT - 1 - y < TEXT_AREA_START) g_pal8Scene = 0;
+        else g_pal8Text = 0;
+        return -1;
+    }
+    g_frame8valid = 1;
+    return 0;
+}
+
+/* On palette displays, realize the frame's colors so they show as they are
+ * instead of their nearest system colors. Returns the previous palette */
+static HPALETTE select_frame_palette(HDC hdc) {
+    if (!(GetDeviceCaps(hdc, RASTERCAPS) & RC_PALETTE)) return NULL;
+    if (!g_hpal || g_hpalCount != g_pal8.count ||
+        memcmp(g_hpalColors, g_pal8.colors, g_pal8.count * sizeof(uint32_t)) != 0) {
+        struct {
+            WORD palVersion;
+            WORD palNumEntries;
+            PALETTEENTRY entries[PAL8_COLORS];
+        } lp;
+        lp.palVersion = 0x300;
+        lp.palNumEntries = (WORD)g_pal8.count;
+        for (int i = 0; i < g_pal8.count; i++) {
+            lp.entries[i].peRed = (BYTE)(g_pal8.colors[i] >> 16);
+            lp.entries[i].peGreen = (BYTE)(g_pal8.colors[i] >> 8);
+            lp.entries[i].peBlue = (BYTE)g_pal8.colors[i];
+            lp.entries[i].peFlags = 0;
+        }
+        if (g_hpal) DeleteObject(g_hpal);
+        g_hpal = CreatePalette((LOGPALETTE *)&lp);
+        memcpy(g_hpalColors, g_pal8.colors, g_pal8.count * sizeof(uint32_t));
+        g_hpalCount = g_pal8.count;
+    }
+    if (!g_hpal) return NULL;
+    HPALETTE old = SelectPalette(hdc, g_hpal, FALSE);
+    RealizePalette(hdc);
+    return old;
+}
+
+/* 16-bpp presentation on 15 and 16-bit displays, see rgb16.h. The frame
+ * stays converted between presents, only the changed part of each row is
+ * converted again, so a static background costs a compare */
+static int g_present16 = -1;            /* RGB16_565, RGB16_555 or -1 */
+static uint16_t *g_frame16 = NULL;
+static uint32_t *g_frame16src = NULL;   /* composed frame behind g_frame16 */
+static int g_frame16valid = 0;
+
+/* Pick the output depth from the 'B' line or the display */
+static void Present16Init(void) {
+    int bits = g_outputbits, palette = 0;
+    HDC hdc = GetDC(NULL);
+    if (hdc) {
+        int display = GetDeviceCaps(hdc, BITSPIXEL) * GetDeviceCaps(hdc, PLANES);
+        palette = (GetDeviceCaps(hdc, RASTERCAPS) & RC_PALETTE) || display <= 8;
+        /* Win32s sits on the Windows 3.1 GDI, which has no 16-bit DIBs */
+        if (bits == 0) bits = IsWin32s() ? 32 : display;
+        ReleaseDC(NULL, hdc);
+    }
+    g_present16 = bits == 16 ? RGB16_565 : bits == 15 ? RGB16_555 : -1;
+
+    /* 8-bpp frames only pay where GDI would convert 32-bit ones down */
+    g_frame8valid = 0;
+    if (g_present16 < 0 && (palette || IsWin32s())) {
+        g_frame8 = (uint8_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT);
+        g_frame8src = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+        g_present8 = g_frame8 && g_frame8src;
+        if (!g_present8) {
+            free(g_frame8);
+            free(g_frame8src);
+            g_frame8 = NULL;
+            g_frame8src = NULL;
+        }
+    }
+    if (g_present16 < 0) return;
+
+    g_frame16 = (uint16_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
+    g_frame16src = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    if (!g_frame16 || !g_frame16src) {
+        free(g_frame16);
+        free(g_frame16src);
+        g_frame16 = NULL;
+        g_frame16src = NULL;
+        g_present16 = -1;
+    }
+    g_frame16valid = 0;
+}
+
+/* Convert 'count' bottom-up rows from 'first' into g_frame16, 'rows'
+ * holding them */
+static void convert_rows16(const uint32_t *rows, int first, int count) {
+    for (int y = first; y < first + count; y++) {
+        const uint32_t *src = rows + (y - first) * SCREEN_WIDTH;
+        uint32_t *old = g_frame16src + y * SCREEN_WIDTH;
+        int x0 = 0, x1 = SCREEN_WIDTH;
+        if (g_frame16valid) {
+            if (memcmp(src, old, SCREEN_WIDTH * sizeof(uint32_t)) == 0) continue;
+            while (src[x0] == old[x0]) x0++;
+            while (src[x1 - 1] == old[x1 - 1]) x1--;
+        }
+        rgb16_row(src, g_frame16 + y * SCREEN_WIDTH, x0, x1, y, g_present16, g_dither);
+        memcpy(old + x0, src + x0, (x1 - x0) * sizeof(uint32_t));
+    }
+}
+
+/* Bring g_frame16 up to date with a composed frame */
+static void convert_frame16(const uint32_t *frame) {
+    convert_rows16(frame, 0, SCREEN_HEIGHT);
+    g_frame16valid = 1;
+}
+
+static void PresentFree(void) {
+    if (g_hpal) DeleteObject(g_hpal);
+    g_hpal = NULL;
+    g_hpalCount = 0;
+    free(g_frame16);
+    free(g_frame16src);
+    g_frame16 = NULL;
+    g_frame16src = NULL;
+    g_present16 = -1;
+    free(g_frame8);
+    free(g_frame8src);
+    g_frame8 = NULL;
+    g_frame8src = NULL;
+    g_present8 = 0;
+}
+
+/* Update the Windows display from our framebuffer */
+static void update_display(void) {
+    if (!g_hwnd || !g_videoram) return;
+
+    DisplayLayout layout;
+    if (display_layout(&layout) != 0) return;
+
+    int text_h = TEXT_AREA_HEIGHT;
+    int image_h = TEXT_AREA_START;
+    int win_w = layout.win_w;
+    int win_h = layout.win_h;
+    int dest_x = layout.dest_x;
+    int dest_w = layout.dest_w;
+    int text_scaled_h = layout.text_scaled_h;
+    int text_dest_y = layout.text_dest_y;
+    int image_scaled_h = layout.image_scaled_h;
+    int padding = layout.padding;
+    int image_dest_y = layout.image_dest_y;
 
     /* Flip source for bottom-up DIB format */
     uint32_t *flipped = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
     if (!flipped) return;
 
+    /* Open dialogs are composed in on the way */
     for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        memcpy(flipped + y * SCREEN_WIDTH,
-               g_videoram + (SCREEN_HEIGHT - 1 - y) * SCREEN_WIDTH,
-               SCREEN_WIDTH * sizeof(uint32_t));
+        LayerComposeRow(flipped + y * SCREEN_WIDTH, SCREEN_HEIGHT - 1 - y);
     }
+    CapturePresented(flipped);
 
     if (g_hq2x) {
         /* HQ2x: hybrid scaling with bilinear for image, nearest-neighbor for text borders */
@@ -940,19 +1387,41 @@ static void update_display(void) {
 
         free(scaled);
     } else {
-        /* Standard rendering: nearest-neighbor via StretchDIBits */
-        BITMAPINFOHEADER bmi;
-        memset(&bmi, 0, sizeof(bmi));
-        bmi.biSize = sizeof(BITMAPINFOHEADER);
-        bmi.biWidth = SCREEN_WIDTH;
-        bmi.biHeight = SCREEN_HEIGHT;
-        bmi.biPlanes = 1;
-        bmi.biBitCount = 32;
-        bmi.biCompression = BI_RGB;
-        bmi.biSizeImage = 0;
+        /* Standard rendering: nearest-neighbor via StretchDIBits, in the
+           display's 16-bit format, or one byte per pixel when the frame
+           fits a palette */
+        Bitmap8Info bmi;
+        int indexed = 0;
+        const void *bits = flipped;
+        memset(&bmi.header, 0, sizeof(bmi.header));
+        bmi.header.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.header.biWidth = SCREEN_WIDTH;
+        bmi.header.biHeight = SCREEN_HEIGHT;
+        bmi.header.biPlanes = 1;
+        bmi.header.biBitCount = 32;
+        bmi.header.biCompression = BI_RGB;
+        bmi.header.biSizeImage = 0;
+        if (g_present16 >= 0) {
+            convert_frame16(flipped);
+            bits = g_frame16;
+            bmi.header.biBitCount = 16;
+            if (g_present16 == RGB16_565) {
+                /* The color table holds the channel masks */
+                static const DWORD masks[3] = {0xf800, 0x07e0, 0x001f};
+                bmi.header.biCompression = BI_BITFIELDS;
+                memcpy(bmi.colors, masks, sizeof(masks));
+            }
+        } else if (index_frame(flipped) == 0) {
+            indexed = 1;
+            bits = g_frame8;
+            bmi.header.biBitCount = 8;
+            bmi.header.biClrUsed = g_pal8.count;
+            memcpy(bmi.colors, g_pal8.colors, g_pal8.count * sizeof(RGBQUAD));
+        }
 
         HDC hdc = GetDC(g_hwnd);
         if (hdc) {
+            HPALETTE oldpal = indexed ? select_frame_palette(hdc) : NULL;
             HBRUSH blackBrush = (HBRUSH)GetStockObject(BLACK_BRUSH);
             RECT bar;
             if (dest_x > 0) {
@@ -971,11 +1440,12 @@ static void update_display(void) {
             SetStretchBltMode(hdc, COLORONCOLOR);
             StretchDIBits(hdc, dest_x, image_dest_y, dest_w, image_scaled_h,
                           0, text_h, SCREEN_WIDTH, image_h,
-                          flipped, (BITMAPINFO *)&bmi, DIB_RGB_COLORS, SRCCOPY);
+                          bits, (BITMAPINFO *)&bmi, DIB_RGB_COLORS, SRCCOPY);
             StretchDIBits(hdc, dest_x, text_dest_y, dest_w, text_scaled_h,
                           0, 0, SCREEN_WIDTH, text_h,
-                          flipped, (BITMAPINFO *)&bmi, DIB_RGB_COLORS, SRCCOPY);
+                          bits, (BITMAPINFO *)&bmi, DIB_RGB_COLORS, SRCCOPY);
 
+            if (oldpal) SelectPalette(hdc, oldpal, FALSE);
             ReleaseDC(g_hwnd, hdc);
         }
     }
@@ -984,6 +1454,97 @@ static void update_display(void) {
     g_lastrender = timeGetTime();
 }
 
+/* Present only the screen rectangle 'r', which must not straddle the image
+ * and text areas. HQ2x mixes neighbouring pixels, so it takes a full frame,
+ * as do new colors on the 8-bpp path, they change the whole palette. */
+static void PresentRect(const RECT *r) {
+    if (!g_hwnd || !g_videoram) return;
+    if (g_hq2x) {
+        update_display();
+        return;
+    }
+
+    DisplayLayout l;
+    if (display_layout(&l) != 0) return;
+
+    int w = r->right - r->left, h = r->bottom - r->top;
+    int first = SCREEN_HEIGHT - r->bottom;  /* bottom-up row of the last line */
+    if (w <= 0 || h <= 0) return;
+    uint32_t *cell = (uint32_t *)malloc(SCREEN_WIDTH * h * sizeof(uint32_t));
+    if (!cell) return;
+
+    /* Bottom-up rows, composed with any open dialog */
+    for (int y = 0; y < h; y++) {
+        LayerComposeRow(cell + y * SCREEN_WIDTH, r->bottom - 1 - y);
+    }
+
+    /* Same edges as the full frame stretch, so cells meet without seams */
+    int area_y = r->top >= TEXT_AREA_START ? TEXT_AREA_START : 0;
+    int area_h = r->top >= TEXT_AREA_START ? SCREEN_HEIGHT - TEXT_AREA_START : TEXT_AREA_START;
+    int dest_y = r->top >= TEXT_AREA_START ? l.text_dest_y : l.image_dest_y;
+    int scaled_h = r->top >= TEXT_AREA_START ? l.text_scaled_h : l.image_scaled_h;
+    int x0 = l.dest_x + r->left * l.dest_w / SCREEN_WIDTH;
+    int x1 = l.dest_x + r->right * l.dest_w / SCREEN_WIDTH;
+    int y0 = dest_y + (r->top - area_y) * scaled_h / area_h;
+    int y1 = dest_y + (r->bottom - area_y) * scaled_h / area_h;
+
+    /* The cell itself at 32 bits, or its rows of the 16-bit or indexed
+     * frame, so it matches the full presents around it */
+    Bitmap8Info bmi;
+    int indexed = 0, src_y = 0;
+    const void *bits = cell;
+    memset(&bmi.header, 0, sizeof(bmi.header));
+    bmi.header.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.header.biWidth = SCREEN_WIDTH;
+    bmi.header.biHeight = h;
+    bmi.header.biPlanes = 1;
+    bmi.header.biBitCount = 32;
+    bmi.header.biCompression = BI_RGB;
+    if (g_present16 >= 0) {
+        if (!g_frame16valid) {
+            free(cell);
+            update_display();
+            return;
+        }
+        convert_rows16(cell, first, h);
+        bits = g_frame16;
+        src_y = first;
+        bmi.header.biHeight = SCREEN_HEIGHT;
+        bmi.header.biBitCount = 16;
+        if (g_present16 == RGB16_565) {
+            static const DWORD masks[3] = {0xf800, 0x07e0, 0x001f};
+            bmi.header.biCompression = BI_BITFIELDS;
+            memcpy(bmi.colors, masks, sizeof(masks));
+        }
+    } else if (g_present8 && g_pal8Scene && g_pal8Text) {
+        int count = g_pal8.count;
+        if (!g_frame8valid || index_rows(cell, first, h) >= 0 || g_pal8.count != count) {
+            free(cell);
+            update_display();
+            return;
+        }
+        indexed = 1;
+        bits = g_frame8;
+        src_y = first;
+        bmi.header.biHeight = SCREEN_HEIGHT;
+        bmi.header.biBitCount = 8;
+        bmi.header.biClrUsed = g_pal8.count;
+        memcpy(bmi.colors, g_pal8.colors, g_pal8.count * sizeof(RGBQUAD));
+    }
+
+    HDC hdc = GetDC(g_hwnd);
+    if (hdc) {
+        HPALETTE oldpal = indexed ? select_frame_palette(hdc) : NULL;
+        SetStretchBltMode(hdc, COLORONCOLOR);
+        StretchDIBits(hdc, x0, y0, x1 - x0, y1 - y0, r->left, src_y, w, h,
+                      bits, (BITMAPINFO *)&bmi, DIB_RGB_COLORS, SRCCOPY);
+        if (oldpal) SelectPalette(hdc, oldpal, FALSE);
+        ReleaseDC(g_hwnd, hdc);
+    }
+    free(cell);
+    CapturePresented(NULL);
+}
+
 /* Center the window on screen */
 static void CenterWindow(void) {
     RECT rect;
@@ -1050,8 +1611,11 @@ static void RestoreWindowSize(void) {
     }
 }
 
-/* Check if a file exists */
+/* Check if a file exists, through the asset index for data\ */
 static int file_exists(const char *pathname) {
+    int found = AssetIndexLookup(pathname, NULL);
+    if (found >= 0) return found ? 0 : -1;
+
     DWORD attr = GetFileAttributesA(pathname);
     return (attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY)) ? 0 : -1;
 }
@@ -1092,76 +1656,185 @@ static int read_keyboard_status(void) {
     return key;
 }
 
-/* Sprite structure */
+/* Sprite paths, interned once per run: sprite lists only keep their id */
+static char **g_spriteNames = NULL;
+static int g_spriteNameCount = 0;
+static int *g_spriteNameSlots = NULL;   /* open addressing, name id + 1, 0 = empty */
+static int g_spriteNameSlotCount = 0;   /* power of two */
+
+/* Sprite drawn at x, y */
 typedef struct {
     int x;
     int y;
-    char file[260];
+    int name;                   /* index in g_spriteNames */
+    int frame;                  /* frame shown, for animations */
+    int anim;                   /* animation running */
+    DWORD start;                /* animation start time, 0 unless anim */
 } sprite;
 
-static sprite currentsprites[256];
-static sprite previoussprites[256];
+/* Sprites of the current screen in z-order, with a hash of the whole list */
+typedef struct {
+    sprite *items;
+    int count;
+    int cap;
+    unsigned long hash;
+} SpriteList;
+
+static SpriteList currentsprites;
+static SpriteList previoussprites;
+
+/* Next frame change of a running animation */
+static int g_animRunning = 0;
+static DWORD g_animDue = 0;
+
+static int sprite_name_grow(void) {
+    int size = g_spriteNameSlotCount ? g_spriteNameSlotCount * 2 : 64;
+    int *slots = (int *)calloc(size, sizeof(int));
+    char **names = (char **)realloc(g_spriteNames, (size / 2) * sizeof(char *));
+    if (!slots || !names) {
+        free(slots);
+        if (names) g_spriteNames = names;
+        return -1;
+    }
+    g_spriteNames = names;
+    for (int id = 0; id < g_spriteNameCount; id++) {
+        unsigned long h = index_hash(names[id]) & (size - 1);
+        while (slots[h]) h = (h + 1) & (size - 1);
+        slots[h] = id + 1;
+    }
+    free(g_spriteNameSlots);
+    g_spriteNameSlots = slots;
+    g_spriteNameSlotCount = size;
+    return 0;
+}
+
+/* Id of a sprite path, added on first use. -1 if out of memory */
+static int sprite_intern(const char *path) {
+    if ((g_spriteNameCount + 1) * 2 > g_spriteNameSlotCount && sprite_name_grow() != 0) return -1;
+
+    unsigned long h = index_hash(path) & (g_spriteNameSlotCount - 1);
+    while (g_spriteNameSlots[h]) {
+        int id = g_spriteNameSlots[h] - 1;
+        if (strcmp(g_spriteNames[id], path) == 0) return id;
+        h = (h + 1) & (g_spriteNameSlotCount - 1);
+    }
+    char *name = (char *)malloc(strlen(path) + 1);
+    if (!name) return -1;
+    strcpy(name, path);
+    g_spriteNames[g_spriteNameCount] = name;
+    g_spriteNameSlots[h] = ++g_spriteNameCount;
+    return g_spriteNameCount - 1;
+}
+
+static unsigned long sprite_hash(unsigned long h, const sprite *s) {
+    return ((h * 33 + (unsigned long)s->name) * 33 + (unsigned long)s->x) * 33 + (unsigned long)s->y;
+}
+
+/* Append a sprite to the current screen, 'anim' starts its animation */
+static int push_sprite(const char *path, int x, int y, int anim) {
+    int name = sprite_intern(path);
+    if (name < 0) return -1;
+    if (currentsprites.count == currentsprites.cap) {
+        int cap = currentsprites.cap ? currentsprites.cap * 2 : 16;
+        sprite *items = (sprite *)realloc(currentsprites.items, cap * sizeof(sprite));
+        if (!items) return -1;
+        currentsprites.items = items;
+        currentsprites.cap = cap;
+    }
+    sprite *s = &currentsprites.items[currentsprites.count++];
+    s->x = x;
+    s->y = y;
+    s->name = name;
+    s->frame = 0;
+    s->anim = anim;
+    /* Static sprites keep 0, so a replayed screen compares equal in one memcmp */
+    s->start = anim ? timeGetTime() : 0;
+    currentsprites.hash = sprite_hash(currentsprites.hash, s);
+    if (anim) {
+        g_animRunning = 1;
+        g_animDue = s->start;
+    }
+    return 0;
+}
 
 static void backup_spritearray(void) {
-    for (int i = 0; i <= 255; i++) {
-        previoussprites[i].x = currentsprites[i].x;
-        previoussprites[i].y = currentsprites[i].y;
-        if (strlen(currentsprites[i].file) > 0) {
-            memcpy(previoussprites[i].file, currentsprites[i].file, 260);
-        } else {
-            memset(previoussprites[i].file, 0, 260);
+    if (previoussprites.cap < currentsprites.count) {
+        sprite *items = (sprite *)realloc(previoussprites.items, currentsprites.cap * sizeof(sprite));
+        if (!items) {
+            previoussprites.count = 0;
+            previoussprites.hash = 0;
+            return;
         }
+        previoussprites.items = items;
+        previoussprites.cap = currentsprites.cap;
     }
+    if (currentsprites.count > 0)
+        memcpy(previoussprites.items, currentsprites.items, currentsprites.count * sizeof(sprite));
+    previoussprites.count = currentsprites.count;
+    previoussprites.hash = currentsprites.hash;
 }
 
 static void reset_cursprites(void) {
-    for (int i = 0; i <= 255; i++) {
-        currentsprites[i].x = 0;
-        currentsprites[i].y = 0;
-        memset(currentsprites[i].file, 0, 260);
-    }
+    currentsprites.count = 0;
+    currentsprites.hash = 0;
 }
 
 static void reset_prevsprites(void) {
-    for (int i = 0; i <= 255; i++) {
-        previoussprites[i].x = 0;
-        previoussprites[i].y = 0;
-        memset(previoussprites[i].file, 0, 260);
-    }
-}
+    previoussprites.count = 0;
+    previoussprites.hash = 0;
+}
+
+static void free_sprites(void) {
+    for (int id = 0; id < g_spriteNameCount; id++) free(g_spriteNames[id]);
+    free(g_spriteNames);
+    free(g_spriteNameSlots);
+    free(currentsprites.items);
+    free(previoussprites.items);
+    g_spriteNames = NULL;
+    g_spriteNameSlots = NULL;
+    g_spriteNameCount = g_spriteNameSlotCount = 0;
+    memset(&currentsprites, 0, sizeof(currentsprites));
+    memset(&previoussprites, 0, sizeof(previoussprites));
+}
+
+/* Number of leading sprites, in z-order, shown the same way in both lists */
+static int common_sprites(void) {
+    int n = currentsprites.count < previoussprites.count ? currentsprites.count : previoussprites.count;
+    int i;
+
+    /* Same hash and length: almost certainly the same screen, confirm in one pass */
+    if (currentsprites.count == previoussprites.count && currentsprites.hash == previoussprites.hash &&
+        (n == 0 || memcmp(currentsprites.items, previoussprites.items, n * sizeof(sprite)) == 0))
+        return n;
 
-static int compare_sprites(void) {
-    for (int i = 0; i <= 255; i++) {
-        if (currentsprites[i].x != previoussprites[i].x) return 1;
-        if (currentsprites[i].y != previoussprites[i].y) return 1;
-        if (strncmp(currentsprites[i].file, previoussprites[i].file, 260) != 0) return 1;
+    for (i = 0; i < n; i++) {
+        const sprite *a = &currentsprites.items[i];
+        const sprite *b = &previoussprites.items[i];
+        if (a->name != b->name || a->x != b->x || a->y != b->y || a->frame != b->frame) break;
     }
-    return 0;
+    return i;
 }
 
 /* Display Load/Save dialog */
 static void DispLoadSave(int mode) {
+    int dx = DIALOG_DX, dy = DIALOG_DY;
     char savepath[15] = {0};
 
-    /* Fill dialog area with white - 161x129 centered in 640x320 */
-    for (int y = 96; y <= 224; y++) {
-        for (int x = 240; x <= 400; x++) {
-            g_videoram[y * SCREEN_WIDTH + x] = COLOR_WHITE;
-        }
-    }
+    /* White dialog area on the overlay - 161x129 centered in 640x320 */
+    OverlayOpen(dx + 240, dy + 96, 161, 129);
 
-    if(mode == 0) { locate(277, 96); print_string("- Loading -"); }
-    if(mode == 1) { locate(281, 96); print_string("- Saving -"); }
-    if(mode == 2) { locate(281, 96); print_string("- Delete -"); }
+    if(mode == 0) { locate(dx + 277, dy + 96); print_string("- Loading -"); }
+    if(mode == 1) { locate(dx + 281, dy + 96); print_string("- Saving -"); }
+    if(mode == 2) { locate(dx + 281, dy + 96); print_string("- Delete -"); }
 
-    DrawHLine(240, 96, 400);
-    DrawHLine(240, 224, 400);
-    DrawVLine(240, 96, 224);
-    DrawVLine(400, 96, 224);
+    DrawHLine(dx + 240, dy + 96, dx + 400);
+    DrawHLine(dx + 240, dy + 224, dx + 400);
+    DrawVLine(dx + 240, dy + 96, dy + 224);
+    DrawVLine(dx + 400, dy + 96, dy + 224);
 
     /* Left column: 1-5 */
     for (int i = 1; i <= 5; i++) {
-        locate(248, 96 + i * 16);
+        locate(dx + 248, dy + 96 + i * 16);
         snprintf(savepath, 15, "data\\sav%d.sav", i);
         if (file_exists(savepath) == 0) {
             print_char('0' + i);
@@ -1174,7 +1847,7 @@ static void DispLoadSave(int mode) {
 
     /* Right column: 6-9, 0 */
     for (int i = 6; i <= 9; i++) {
-        locate(328, (1 + i) * 16);
+        locate(dx + 328, dy + (1 + i) * 16);
         snprintf(savepath, 15, "data\\sav%d.sav", i);
         if (file_exists(savepath) == 0) {
             print_char('0' + i);
@@ -1185,14 +1858,14 @@ static void DispLoadSave(int mode) {
         }
     }
 
-    locate(328, 176);
+    locate(dx + 328, dy + 176);
     if (file_exists("data\\sav0.sav") == 0) {
         print_string("0: USED ");
     } else {
         print_string("0: EMPTY");
     }
 
-    locate(280, 208);
+    locate(dx + 280, dy + 208);
     print_string("[q] : quit");
 
     update_display();
@@ -1200,85 +1873,76 @@ static void DispLoadSave(int mode) {
 
 /* Display help dialog */
 static void DispHelp(void) {
+    int dx = DIALOG_DX, dy = DIALOG_DY;
     /* Dialog 142x162 centered in 640x320 image area */
     /* Interior 140x160 (17 chars * 8px + 2px padding each side) */
     /* Border wraps outside: x 249..390, y 79..240 */
-    for (int y = 80; y <= 239; y++) {
-        for (int x = 250; x <= 389; x++) {
-            g_videoram[y * SCREEN_WIDTH + x] = COLOR_WHITE;
-        }
-    }
+    OverlayOpen(dx + 249, dy + 79, 142, 162);
 
-    locate(252, 82);
+    locate(dx + 252, dy + 82);
     print_string("-     Usage     -");
-    locate(252, 98);
+    locate(dx + 252, dy + 98);
     print_string("[q] Quit         ");
-    locate(252, 114);
+    locate(dx + 252, dy + 114);
     print_string("[b] Back         ");
-    locate(252, 130);
+    locate(dx + 252, dy + 130);
     print_string("[l] Load save    ");
-    locate(252, 146);
+    locate(dx + 252, dy + 146);
     print_string("[s] Save state   ");
-    locate(252, 162);
+    locate(dx + 252, dy + 162);
     print_string("[e] Erase save   ");
-    locate(252, 178);
+    locate(dx + 252, dy + 178);
     print_string("[r] Restore size ");
-    locate(252, 194);
+    locate(dx + 252, dy + 194);
     print_string("[c] Config       ");
-    locate(252, 210);
+    locate(dx + 252, dy + 210);
     print_string("[ ] Advance      ");
-    locate(252, 226);
+    locate(dx + 252, dy + 226);
     print_string("[esc] Restart    ");
 
-    DrawHLine(249, 79, 390);
-    DrawHLine(249, 240, 390);
-    DrawVLine(249, 79, 240);
-    DrawVLine(390, 79, 240);
+    DrawHLine(dx + 249, dy + 79, dx + 390);
+    DrawHLine(dx + 249, dy + 240, dx + 390);
+    DrawVLine(dx + 249, dy + 79, dy + 240);
+    DrawVLine(dx + 390, dy + 79, dy + 240);
 
     update_display();
 }
 
 static void DispQuit(void) {
+    int dx = DIALOG_DX, dy = DIALOG_DY;
     /* Dialog 116x33 centered in 640x320 image area */
     /* x: (640-116)/2 = 262, y: (320-33)/2 = 144 */
-    for (int y = 144; y <= 175; y++) {
-        for (int x = 262; x <= 377; x++) {
-            g_videoram[y * SCREEN_WIDTH + x] = COLOR_WHITE;
-        }
-    }
+    OverlayOpen(dx + 262, dy + 144, 116, 33);
 
-    locate(264, 146);
+    locate(dx + 264, dy + 146);
     print_string("-    Quit    -");
-    locate(264, 162);
+    locate(dx + 264, dy + 162);
     print_string("[1] Yes [2] No");
 
-    DrawHLine(262, 144, 377);
-    DrawHLine(262, 176, 377);
-    DrawVLine(262, 144, 176);
-    DrawVLine(377, 144, 176);
+    DrawHLine(dx + 262, dy + 144, dx + 377);
+    DrawHLine(dx + 262, dy + 176, dx + 377);
+    DrawVLine(dx + 262, dy + 144, dy + 176);
+    DrawVLine(dx + 377, dy + 144, dy + 176);
 
     update_display();
 }
 
 static void DispEsc(void) {
+    int dx = DIALOG_DX, dy = DIALOG_DY;
     /* Dialog 142x34 centered in 640x320 image area */
     /* Interior 140x32 (17 chars * 8px + 2px padding each side) */
     /* Border wraps outside: x 249..390, y 143..176 */
-    for (int y = 144; y <= 175; y++) {
-        for (int x = 250; x <= 389; x++) {
-            g_videoram[y * SCREEN_WIDTH + x] = COLOR_WHITE;
-        }
-    }
+    OverlayOpen(dx + 249, dy + 143, 142, 34);
 
-    locate(252, 146);
+    locate(dx + 252, dy + 146);
     print_string("-    Restart    -");
-    locate(252, 162);
+    locate(dx + 252, dy + 162);
     print_string(" [1] Yes  [2] No ");
 
-    DrawHLine(249, 143, 390);
-    DrawHLine(249, 176, 390);
-    DrawVLine(249, 143, 176);
-    DrawVLine(390, 143, 176);
+    DrawHLine(dx + 249, dy + 143, dx + 390);
+    DrawHLine(dx + 249, dy + 176, dx + 390);
+    DrawVLine(dx + 249, dy + 143, dy + 176);
+    DrawVLine(dx + 390, dy + 143, dy + 176);
 
     update_display();
 }
@@ -1302,393 +1966,52 @@ static void FxDelayUntil(DWORD target) {
     }
 }
 
-/* Helper to fill a row with a color */
-static void FillRow(int y, uint32_t color) {
-    uint32_t *row = g_videoram + y * SCREEN_WIDTH;
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        row[x] = color;
-    }
-}
-
-/* Fill multiple rows at once for faster effects */
-static void FillRows(int y, int count, uint32_t color) {
-    for (int i = 0; i < count; i++) {
-        int row = y + i;
-        if (row >= 0 && row < 320) FillRow(row, color);
-    }
-}
-
-/* Screen transition effects */
-static void FxVWipeDown(uint32_t color) {
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int i = 0; i < 320; i += 8) {
-        FillRows(i, 8, color);
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxVWipeUp(uint32_t color) {
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int i = 312; i >= 0; i -= 8) {
-        FillRows(i, 8, color);
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxVWipeMidIn(uint32_t color) {
-    /* Wipe from edges (0 and 319) toward center (160) */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int i = 0; i < 160; i += 8) {
-        FillRows(i, 8, color);                /* Top edge moving down */
-        FillRows(312 - i, 8, color);          /* Bottom edge moving up */
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxVWipeMidOut(uint32_t color) {
-    /* Wipe from center (160) toward edges */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int i = 0; i < 160; i += 8) {
-        FillRows(160 + i, 8, color);          /* Center moving down */
-        FillRows(152 - i, 8, color);          /* Center moving up */
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxHWipeRight(uint32_t color) {
-    /* Wipe 32 pixels at a time for speed */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int col = 0; col < SCREEN_WIDTH; col += 32) {
-        for (int line = 0; line < 320; line++) {
-            uint32_t *row = g_videoram + line * SCREEN_WIDTH + col;
-            for (int p = 0; p < 32 && col + p < SCREEN_WIDTH; p++) {
-                row[p] = color;
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxHWipeLeft(uint32_t color) {
-    /* Wipe 32 pixels at a time for speed */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int col = SCREEN_WIDTH - 32; col >= 0; col -= 32) {
-        for (int line = 0; line < 320; line++) {
-            uint32_t *row = g_videoram + line * SCREEN_WIDTH + col;
-            for (int p = 0; p < 32; p++) {
-                row[p] = color;
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxHWipeMidIn(uint32_t color) {
-    /* 64 pixels at a time (32 from each side) */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int col = 0; col < SCREEN_WIDTH / 2; col += 32) {
-        for (int line = 0; line < 320; line++) {
-            uint32_t *row = g_videoram + line * SCREEN_WIDTH;
-            for (int p = 0; p < 32 && col + p < SCREEN_WIDTH / 2; p++) {
-                row[col + p] = color;
-                row[SCREEN_WIDTH - 1 - col - p] = color;
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxHWipeMidOut(uint32_t color) {
-    /* 64 pixels at a time (32 from center to each side) */
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    for (int col = 0; col < SCREEN_WIDTH / 2; col += 32) {
-        for (int line = 0; line < 320; line++) {
-            uint32_t *row = g_videoram + line * SCREEN_WIDTH;
-            for (int p = 0; p < 32 && col + p < SCREEN_WIDTH / 2; p++) {
-                row[SCREEN_WIDTH / 2 - 1 - col - p] = color;
-                row[SCREEN_WIDTH / 2 + col + p] = color;
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 15));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-/* Fill a 16-pixel wide block at position (bx*16, y) */
-static void FillBlock16(int bx, int y, uint32_t color) {
-    if (bx < 0 || bx >= 40 || y < 0 || y >= 320) return;
-    uint32_t *ptr = g_videoram + y * SCREEN_WIDTH + bx * 16;
-    for (int p = 0; p < 16; p++) {
-        ptr[p] = color;
-    }
-}
-
-static void FxCircleOut(uint32_t color) {
-    int bcx = 20;
-    int bcy = 5;
-
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    /* Process 3 radii at a time for speed */
-    for (int r = 0; r <= 23; r += 3) {
-        int r_end = (r + 2 <= 23) ? r + 2 : 23;
-        int r2 = r_end * r_end;
-        int prev_r2 = (r > 0) ? (r - 1) * (r - 1) : -1;
-
-        for (int by = 0; by < 10; by++) {
-            int dy = by - bcy;
-            int dy2 = 4 * dy * dy;
-            if (dy2 > r2) continue;
-
-            int dx = 0;
-            int target = r2 - dy2;
-            while ((dx + 1) * (dx + 1) <= target) dx++;
-
-            int prev_dx = -1;
-            if (prev_r2 >= 0 && dy2 <= prev_r2) {
-                prev_dx = 0;
-                int prev_target = prev_r2 - dy2;
-                while ((prev_dx + 1) * (prev_dx + 1) <= prev_target) prev_dx++;
-            }
-
-            for (int line = 0; line < 32; line++) {
-                int y = by * 32 + line;
-                if (y >= 320) continue;
-
-                for (int bx = bcx - dx; bx <= bcx - prev_dx - 1; bx++) {
-                    FillBlock16(bx, y, color);
-                }
-
-                for (int bx = bcx + prev_dx + 1; bx <= bcx + dx; bx++) {
-                    FillBlock16(bx, y, color);
-                }
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 40));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-static void FxCircleIn(uint32_t color) {
-    int bcx = 20;
-    int bcy = 5;
-
-    DWORD effect_start = timeGetTime();
-    int step = 0;
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-    /* Process 3 radii at a time for speed */
-    for (int r = 23; r >= 0; r -= 3) {
-        int r2 = r * r;
-        int r_end = (r - 2 >= 0) ? r - 2 : 0;
-        int next_r2 = (r_end > 0) ? (r_end - 1) * (r_end - 1) : -1;
-
-        for (int by = 0; by < 10; by++) {
-            int dy = by - bcy;
-            int dy2 = 4 * dy * dy;
-            if (dy2 > r2) continue;
-
-            int dx = 0;
-            int target = r2 - dy2;
-            while ((dx + 1) * (dx + 1) <= target) dx++;
-
-            int next_dx = -1;
-            if (next_r2 >= 0 && dy2 <= next_r2) {
-                next_dx = 0;
-                int next_target = next_r2 - dy2;
-                while ((next_dx + 1) * (next_dx + 1) <= next_target) next_dx++;
-            }
-
-            for (int line = 0; line < 32; line++) {
-                int y = by * 32 + line;
-                if (y >= 320) continue;
-
-                for (int bx = bcx - dx; bx <= bcx - next_dx - 1; bx++) {
-                    FillBlock16(bx, y, color);
-                }
-
-                for (int bx = bcx + next_dx + 1; bx <= bcx + dx; bx++) {
-                    FillBlock16(bx, y, color);
-                }
-            }
-        }
-        FxDelayUntil(effect_start + (DWORD)(++step * 40));
-        if (!g_running) break;
-    }
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    if (g_running) update_display();
-}
-
-/* Fade the image area to black in 20 steps over 2 seconds */
-static void FxFadeOut(void) {
-    const int steps = 20;
-    uint32_t *original = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
-    if (!original) return;
-
-    memcpy(original, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
-
-    DWORD effect_start = timeGetTime();
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-
-    /* Fade steps: blend original pixels towards black */
-    for (int step = 1; step <= steps; step++) {
-        uint8_t lut[256];
-        int inv = steps - step;
-        for (int i = 0; i < 256; i++)
-            lut[i] = i * inv / steps;
-
-        uint32_t *src = original;
-        uint32_t *dst = g_videoram;
-        uint32_t *dst_end = g_videoram + IMAGE_AREA_PIXELS;
-        for (; dst < dst_end; src++, dst++) {
-            uint32_t pixel = *src;
-            *dst = (pixel & 0xFF000000)
-                 | ((uint32_t)lut[(pixel >> 16) & 0xFF] << 16)
-                 | ((uint32_t)lut[(pixel >> 8) & 0xFF] << 8)
-                 | lut[pixel & 0xFF];
-        }
-
-        FxDelayUntil(effect_start + (DWORD)(step * 50));
-        if (!g_running) break;
-    }
-
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-    free(original);
-
-    /* Ensure final state is pure black */
-    if (g_running) {
-        for (uint32_t *ptr = g_videoram; ptr < g_videoram + IMAGE_AREA_PIXELS; ptr++)
-            *ptr = COLOR_BLACK;
-        update_display();
-    }
-}
-
-/* Fade from black to an image in 20 steps over 2 seconds */
-static void FxFadeIn(const char *filename) {
-    uint32_t *target_buffer = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
-    if (!target_buffer) return;
-
-    /* Load the target image */
-    uint8_t temp_palette[32];
-    if (LoadBackgroundImage(filename, temp_palette, target_buffer) != 0) {
-        free(target_buffer);
-        return;
-    }
-
-    /* Start with black screen */
-    for (uint32_t *ptr = g_videoram; ptr < g_videoram + IMAGE_AREA_PIXELS; ptr++)
-        *ptr = COLOR_BLACK;
-    update_display();
-
-    DWORD effect_start = timeGetTime();
-    SetTimer(g_hwnd, DEFER_RENDER_TIME_ID, 15, (TIMERPROC) Timer0Proc);
-
-    /* Fade steps: blend from black towards target image */
-    const int steps = 20;
-    for (int step = 1; step <= steps; step++) {
-        uint8_t lut[256];
-        for (int i = 0; i < 256; i++)
-            lut[i] = i * step / steps;
-
-        uint32_t *src = target_buffer;
-        uint32_t *dst = g_videoram;
-        uint32_t *dst_end = g_videoram + IMAGE_AREA_PIXELS;
-        for (; dst < dst_end; src++, dst++) {
-            uint32_t pixel = *src;
-            *dst = 0xFF000000
-                 | ((uint32_t)lut[(pixel >> 16) & 0xFF] << 16)
-                 | ((uint32_t)lut[(pixel >> 8) & 0xFF] << 8)
-                 | lut[pixel & 0xFF];
-        }
-
-        FxDelayUntil(effect_start + (DWORD)(step * 50));
-        if (!g_running) break;
-    }
-
-    KillTimer(g_hwnd, DEFER_RENDER_TIME_ID);
-
-    /* Ensure final state matches target image */
-    if (g_running) {
-        memcpy(g_videoram, target_buffer, IMAGE_AREA_PIXELS * sizeof(uint32_t));
-        update_display();
-    }
+/* libpng reads PNG data from a memory blob */
+typedef struct {
+    const uint8_t *data;
+    size_t left;
+} PngReader;
 
-    free(target_buffer);
+static void png_read_blob(png_structp png, png_bytep out, png_size_t len) {
+    PngReader *rd = (PngReader *)png_get_io_ptr(png);
+    if (len > rd->left) png_error(png, "Truncated PNG");
+    memcpy(out, rd->data, len);
+    rd->data += len;
+    rd->left -= len;
 }
 
 /* Load a PNG image into 32-bit BGRA buffer */
 static int LoadPngImage(const char *filename, uint32_t *background) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) return -1;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
 
     /* Check PNG signature */
-    uint8_t header[8];
-    if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8)) {
-        fclose(fp);
+    if (blob.size < 8 || png_sig_cmp((png_const_bytep)blob.data, 0, 8)) {
+        AssetFreeBlob(&blob);
         return -1;
     }
+    PngReader reader = { blob.data + 8, blob.size - 8 };
 
     png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png) {
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
     png_infop info = png_create_info_struct(png);
     if (!info) {
         png_destroy_read_struct(&png, NULL, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
     if (setjmp(png_jmpbuf(png))) {
         png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
-    png_init_io(png, fp);
+    png_set_read_fn(png, &reader, png_read_blob);
     png_set_sig_bytes(png, 8);
     png_read_info(png, info);
 
@@ -1729,7 +2052,7 @@ static int LoadPngImage(const char *filename, uint32_t *background) {
     png_bytep *row_pointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
     if (!row_pointers) {
         png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
@@ -1740,34 +2063,33 @@ static int LoadPngImage(const char *filename, uint32_t *background) {
             for (png_uint_32 j = 0; j < y; j++) free(row_pointers[j]);
             free(row_pointers);
             png_destroy_read_struct(&png, &info, NULL);
-            fclose(fp);
+            AssetFreeBlob(&blob);
             return -1;
         }
     }
 
     png_read_image(png, row_pointers);
     png_read_end(png, NULL);
-    fclose(fp);
+    AssetFreeBlob(&blob);
 
     /* Clear background buffer to white */
-    for (int i = 0; i < SCREEN_WIDTH * TEXT_AREA_START; i++) {
-        background[i] = COLOR_WHITE;
-    }
+    draw_fill(background, COLOR_WHITE, IMAGE_AREA_PIXELS);
 
     /* Copy pixels to 32-bit BGRA buffer */
-    /* Limit to screen dimensions (640x320 for image area) */
+    /* Limit to the image area */
     png_uint_32 copy_width = (width > SCREEN_WIDTH) ? SCREEN_WIDTH : width;
     png_uint_32 copy_height = (height > TEXT_AREA_START) ? TEXT_AREA_START : height;
 
     for (png_uint_32 y = 0; y < copy_height; y++) {
         png_byte *row = row_pointers[y];
+        uint32_t *dst = background + y * SCREEN_WIDTH;
         for (png_uint_32 x = 0; x < copy_width; x++) {
             /* Row is BGR format (3 bytes per pixel) */
             uint8_t b = row[x * 3 + 0];
             uint8_t g = row[x * 3 + 1];
             uint8_t r = row[x * 3 + 2];
             /* BGRA format: 0xAARRGGBB in memory */
-            background[y * SCREEN_WIDTH + x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+            dst[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
         }
     }
 
@@ -1781,44 +2103,88 @@ static int LoadPngImage(const char *filename, uint32_t *background) {
     return 0;
 }
 
-/* Check if file has PNG signature */
-static int IsPngFile(const char *filename) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) return 0;
+/* Load a W3I image into the 32-bit background buffer */
+static int LoadW3iImage(const char *filename, uint32_t *background) {
+    int width, height, flags;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
+    if (w3i_info(blob.data, blob.size, &width, &height, &flags) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+
+    /* Smaller pictures leave a white border, like PNG ones */
+    if (width < SCREEN_WIDTH || height < TEXT_AREA_START) {
+        draw_fill(background, COLOR_WHITE, IMAGE_AREA_PIXELS);
+    }
+    int ret = w3i_decode(blob.data, blob.size, background, SCREEN_WIDTH, SCREEN_WIDTH, TEXT_AREA_START);
+    AssetFreeBlob(&blob);
 
-    uint8_t header[8];
-    int is_png = 0;
-    if (fread(header, 1, 8, fp) == 8) {
-        is_png = (png_sig_cmp(header, 0, 8) == 0);
+    /* Backgrounds are opaque */
+    if (flags & W3I_ALPHA) {
+        for (int i = 0; i < IMAGE_AREA_PIXELS; i++) background[i] |= 0xFF000000;
     }
-    fclose(fp);
-    return is_png;
+    return ret;
 }
 
+/* Load the top-left view of a W3M tiled background, see scroll.c */
+static int LoadW3mImage(const char *filename, uint32_t *background) {
+    W3mInfo info;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
+    if (w3m_info(blob.data, blob.size, &info) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+
+    int w = info.width < SCREEN_WIDTH ? info.width : SCREEN_WIDTH;
+    int h = info.height < TEXT_AREA_START ? info.height : TEXT_AREA_START;
+    if (w < SCREEN_WIDTH || h < TEXT_AREA_START) {
+        draw_fill(background, COLOR_WHITE, IMAGE_AREA_PIXELS);
+    }
+    int ret = w3m_render(blob.data, &info, 0, 0, w, h, background, SCREEN_WIDTH);
+    AssetFreeBlob(&blob);
+    return ret;
+}
+
+/* Check if file has PNG signature */
+static int IsPngFile(const char *filename) {
+    return AssetIndexFormat(filename) == ASSET_FMT_PNG;
+}
+
+/* PI3 pictures are 640x320 (of 400 lines), at the top-left of larger areas */
+#define PI3_WIDTH  640
+#define PI3_HEIGHT 320
+
 /* Load a compressed background image (PI1/Degas format) and convert to 32-bit */
 static int LoadBackgroundImagePI1(const char *picture, uint8_t *bgpalette, uint32_t *background) {
     /* Temporary buffer for monochrome data */
-    uint8_t *mono = (uint8_t *)malloc(SCREEN_WIDTH * TEXT_AREA_START / 8);
+    const DWORD monosize = PI3_WIDTH * PI3_HEIGHT / 8;
+    uint8_t *mono = (uint8_t *)calloc(monosize, 1);
     if (!mono) return -1;
 
-    gzFile gzf = gzopen(picture, "rb");
-    if (gzf == NULL) {
+    /* Whole file in one read, inflated if gzipped */
+    AssetBlob blob;
+    if (AssetReadAll(picture, &blob) != 0 || AssetGunzip(&blob) != 0) {
+        AssetFreeBlob(&blob);
         free(mono);
         return -1;
     }
 
-    gzseek(gzf, 2, SEEK_CUR);  /* Skip resolution word */
-    gzread(gzf, bgpalette, 32); /* Read palette (unused in mono) */
-    gzread(gzf, mono, SCREEN_WIDTH * TEXT_AREA_START / 8);
-    gzclose(gzf);
+    /* Skip resolution word, palette is unused in mono */
+    if (blob.size >= 34) memcpy(bgpalette, blob.data + 2, 32);
+    if (blob.size > 34) memcpy(mono, blob.data + 34, blob.size - 34 < monosize ? blob.size - 34 : monosize);
+    AssetFreeBlob(&blob);
 
     /* Convert monochrome to 32-bit BGRA */
-    for (int y = 0; y < TEXT_AREA_START; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            int bytepos = (y * SCREEN_WIDTH + x) / 8;
-            int bitpos = 7 - (x % 8);
-            int bit = (mono[bytepos] >> bitpos) & 1;
-            background[y * SCREEN_WIDTH + x] = bit ? COLOR_BLACK : COLOR_WHITE;
+    if (SCREEN_WIDTH > PI3_WIDTH || TEXT_AREA_START > PI3_HEIGHT) {
+        draw_fill(background, COLOR_WHITE, IMAGE_AREA_PIXELS);
+    }
+    for (int y = 0; y < PI3_HEIGHT; y++) {
+        const uint8_t *src = mono + y * (PI3_WIDTH / 8);
+        uint32_t *dst = background + y * SCREEN_WIDTH;
+        for (int x = 0; x < PI3_WIDTH; x++) {
+            dst[x] = (src[x >> 3] >> (7 - (x & 7))) & 1 ? COLOR_BLACK : COLOR_WHITE;
         }
     }
 
@@ -1826,46 +2192,69 @@ static int LoadBackgroundImagePI1(const char *picture, uint8_t *bgpalette, uint3
     return 0;
 }
 
-/* Load a background image (auto-detects PNG or PI1 format) */
-static int LoadBackgroundImage(const char *picture, uint8_t *bgpalette, uint32_t *background) {
-    if (IsPngFile(picture)) {
+/* Decode a background image (auto-detects PNG, W3I, W3M or PI1 format) */
+static int DecodeBackground(const char *picture, uint32_t *background) {
+    uint8_t bgpalette[32];
+    int format = AssetIndexFormat(picture);
+    if (format == ASSET_FMT_PNG) {
         return LoadPngImage(picture, background);
     }
+    if (format == ASSET_FMT_W3I) {
+        return LoadW3iImage(picture, background);
+    }
+    if (format == ASSET_FMT_W3M) {
+        return LoadW3mImage(picture, background);
+    }
     return LoadBackgroundImagePI1(picture, bgpalette, background);
 }
 
-/* Display a PNG sprite with alpha transparency */
-static int DisplayPngSprite(const char *filename, int posx, int posy) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) return -1;
+/* Load a background image, from the asset cache when already decoded */
+static int LoadBackgroundImage(const char *picture, uint8_t *bgpalette, uint32_t *background) {
+    AssetImage *img = AssetLoad(picture, ASSET_BACKGROUND);
+    if (!img) return -1;
+    memcpy(background, img->pixels, IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    AssetCacheRelease(img);
+    g_pal8Scene = 1;
+    return 0;
+}
+
+/* Decode a PNG sprite with alpha transparency */
+static int DecodePngSprite(const char *filename, AssetImage *out) {
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
 
     /* Check PNG signature */
-    uint8_t header[8];
-    if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8)) {
-        fclose(fp);
+    if (blob.size < 8 || png_sig_cmp((png_const_bytep)blob.data, 0, 8)) {
+        AssetFreeBlob(&blob);
         return -1;
     }
+    PngReader reader = { blob.data + 8, blob.size - 8 };
 
     png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png) {
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
     png_infop info = png_create_info_struct(png);
     if (!info) {
         png_destroy_read_struct(&png, NULL, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
         return -1;
     }
 
+    uint32_t *volatile pixels = NULL;
+    png_bytep *volatile row_pointers = NULL;
+
     if (setjmp(png_jmpbuf(png))) {
         png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
+        free(row_pointers);
+        free(pixels);
         return -1;
     }
 
-    png_init_io(png, fp);
+    png_set_read_fn(png, &reader, png_read_blob);
     png_set_sig_bytes(png, 8);
     png_read_info(png, info);
 
@@ -1898,160 +2287,555 @@ static int DisplayPngSprite(const char *filename, int posx, int posy) {
         png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
     }
 
-    /* Request BGR order for Win32 DIB compatibility */
+    /* Request BGRA order, which is 0xAARRGGBB in memory */
     png_set_bgr(png);
 
     png_read_update_info(png, info);
 
-    /* Allocate row pointers */
-    png_bytep *row_pointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
-    if (!row_pointers) {
+    /* Decode straight into the sprite buffer */
+    pixels = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    row_pointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
+    if (!pixels || !row_pointers) {
         png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
+        AssetFreeBlob(&blob);
+        free(row_pointers);
+        free(pixels);
         return -1;
     }
 
-    size_t rowbytes = png_get_rowbytes(png, info);
     for (png_uint_32 y = 0; y < height; y++) {
-        row_pointers[y] = (png_byte *)malloc(rowbytes);
-        if (!row_pointers[y]) {
-            for (png_uint_32 j = 0; j < y; j++) free(row_pointers[j]);
-            free(row_pointers);
-            png_destroy_read_struct(&png, &info, NULL);
-            fclose(fp);
-            return -1;
-        }
+        row_pointers[y] = (png_bytep)(pixels + (size_t)y * width);
     }
 
     png_read_image(png, row_pointers);
     png_read_end(png, NULL);
-    fclose(fp);
+    AssetFreeBlob(&blob);
 
-    /* Blend sprite onto videoram with alpha */
-    for (png_uint_32 sy = 0; sy < height; sy++) {
-        int screen_y = posy + sy;
-        if (screen_y < 0) continue;
-        if (screen_y >= TEXT_AREA_START) break;
-
-        png_byte *row = row_pointers[sy];
-        for (png_uint_32 sx = 0; sx < width; sx++) {
-            int screen_x = posx + sx;
-            if (screen_x < 0) continue;
-            if (screen_x >= SCREEN_WIDTH) break;
-
-            /* Row is BGRA format (4 bytes per pixel) */
-            uint8_t b = row[sx * 4 + 0];
-            uint8_t g = row[sx * 4 + 1];
-            uint8_t r = row[sx * 4 + 2];
-            uint8_t a = row[sx * 4 + 3];
-
-            if (a == 0) {
-                /* Fully transparent - skip */
-                continue;
-            }
+    free(row_pointers);
+    png_destroy_read_struct(&png, &info, NULL);
 
-            int ppos = screen_y * SCREEN_WIDTH + screen_x;
+    out->width = (int)width;
+    out->height = (int)height;
+    out->flags = 0;
+    out->pixels = pixels;
+    return 0;
+}
 
-            if (a == 255) {
-                /* Fully opaque - direct copy */
-                g_videoram[ppos] = 0xFF000000 | (r << 16) | (g << 8) | b;
-            } else {
-                /* Alpha blend: result = src * alpha + dst * (255 - alpha) */
-                uint32_t dst = g_videoram[ppos];
-                uint8_t dst_b = dst & 0xFF;
-                uint8_t dst_g = (dst >> 8) & 0xFF;
-                uint8_t dst_r = (dst >> 16) & 0xFF;
+/* Decode a W3I sprite, converted STVN sprites keep their clipping */
+static int DecodeW3iSprite(const char *filename, AssetImage *out) {
+    int width, height, flags;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
+    if (w3i_info(blob.data, blob.size, &width, &height, &flags) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
 
-                uint8_t out_r = (r * a + dst_r * (255 - a)) / 255;
-                uint8_t out_g = (g * a + dst_g * (255 - a)) / 255;
-                uint8_t out_b = (b * a + dst_b * (255 - a)) / 255;
+    uint32_t *pixels = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    if (!pixels || w3i_decode(blob.data, blob.size, pixels, width, width, height) != 0) {
+        AssetFreeBlob(&blob);
+        free(pixels);
+        return -1;
+    }
+    AssetFreeBlob(&blob);
 
-                g_videoram[ppos] = 0xFF000000 | (out_r << 16) | (out_g << 8) | out_b;
-            }
+    out->width = width;
+    out->height = height;
+    out->flags = (flags & W3I_LEGACY) ? ASSET_LEGACY : 0;
+    out->pixels = pixels;
+    return 0;
+}
+
+/* Load a W3S run-length sprite, its rows are kept as is and drawn by runs */
+static int DecodeRunSprite(const char *filename, AssetImage *out) {
+    int width, height, flags;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
+
+    long rowsize = w3s_check(blob.data, blob.size);
+    if (rowsize < 0 || w3s_info(blob.data, blob.size, &width, &height, &flags) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+    uint8_t *runs = (uint8_t *)malloc(rowsize + 1);
+    if (!runs) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+    memcpy(runs, blob.data + W3S_HEADER_SIZE, rowsize);
+    AssetFreeBlob(&blob);
+
+    out->width = width;
+    out->height = height;
+    out->flags = (flags & W3S_LEGACY) ? ASSET_LEGACY : 0;
+    out->runs = runs;
+    out->runsize = (size_t)rowsize;
+    return 0;
+}
+
+/* Decode a text-based sprite (legacy format) */
+static int DecodeTextSprite(const char *spritefile, AssetImage *out) {
+    /* Read the whole sprite, inflated if gzipped */
+    AssetBlob blob;
+    if (AssetReadAll(spritefile, &blob) != 0) return -1;
+    if (AssetGunzip(&blob) != 0) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+    const char *pctmem = (const char *)blob.data;
+    uint32_t pctsize = blob.size;
+
+    /* First pass: measure, rows are as wide as their longest run of pixels */
+    int width = 0, height = 1, x = 0;
+    for (uint32_t pctpos = 0; pctpos < pctsize; pctpos++) {
+        if (pctmem[pctpos] == 10) {
+            height++;
+            x = 0;
+        } else if (pctmem[pctpos] == ' ' || pctmem[pctpos] == '0' || pctmem[pctpos] == '1') {
+            if (++x > width) width = x;
         }
     }
 
-    /* Free row pointers */
-    for (png_uint_32 y = 0; y < height; y++) {
-        free(row_pointers[y]);
+    uint32_t *pixels = (uint32_t *)calloc((size_t)width * height + 1, sizeof(uint32_t));
+    if (!pixels) {
+        AssetFreeBlob(&blob);
+        return -1;
     }
-    free(row_pointers);
 
-    png_destroy_read_struct(&png, &info, NULL);
+    /* Second pass: '0' is white, '1' black, ' ' stays transparent */
+    int y = 0;
+    x = 0;
+    for (uint32_t pctpos = 0; pctpos < pctsize; pctpos++) {
+        if (pctmem[pctpos] == 10) { /* Newline */
+            y++;
+            x = 0;
+        } else if (pctmem[pctpos] == ' ') { /* Transparency */
+            x++;
+        } else if (pctmem[pctpos] == '0' || pctmem[pctpos] == '1') {
+            pixels[y * width + x] = (pctmem[pctpos] == '1') ? COLOR_BLACK : COLOR_WHITE;
+            x++;
+        }
+    }
+
+    AssetFreeBlob(&blob);
+    out->width = width;
+    out->height = height;
+    out->flags = ASSET_LEGACY;
+    out->pixels = pixels;
     return 0;
 }
 
-/* Display a text-based sprite (legacy format) */
-static int DisplayTextSprite(const char *spritefile, int posx, int posy) {
-    gzFile sprite = gzopen(spritefile, "rb");
-    if (sprite == NULL) return -1;
+/* Load an animation. The "ANIM" text descriptor names the frame atlas on its
+ * second line (relative to data\, frames side by side, equally wide),
+ * followed by the duration of each frame in ms. */
+static int DecodeAnimSprite(const char *filename, AssetImage *out) {
+    uint32_t delays[ANIM_MAX_FRAMES];
+    char atlas[270];
+    int frames = 0;
+    AssetBlob blob;
+    if (AssetReadAll(filename, &blob) != 0) return -1;
+
+    char *text = (char *)malloc(blob.size + 1);
+    if (!text) {
+        AssetFreeBlob(&blob);
+        return -1;
+    }
+    memcpy(text, blob.data, blob.size);
+    text[blob.size] = '\0';
+    AssetFreeBlob(&blob);
+
+    char *name = strchr(text, '\n');
+    if (name) {
+        name++;
+        char *p = name + strcspn(name, "\r\n");
+        snprintf(atlas, sizeof(atlas), "data\\%.*s", (int)(p - name), name);
+        while (frames < ANIM_MAX_FRAMES) {
+            char *next;
+            long ms = strtol(p, &next, 10);
+            if (next == p) break;
+            delays[frames++] = ms < 10 ? 10 : (uint32_t)ms;
+            p = next;
+        }
+    }
+    free(text);
+    if (frames == 0 || AssetIndexFormat(atlas) == ASSET_FMT_ANI) return -1;
 
-    /* Get uncompressed size */
-    FILE *fp = fopen(spritefile, "rb");
-    if (!fp) {
-        gzclose(sprite);
+    if (AssetDecode(atlas, ASSET_SPRITE, out) != 0) return -1;
+    out->delays = (uint32_t *)malloc(frames * sizeof(uint32_t));
+    if (!out->delays || out->width < frames) {
+        asset_image_free(out);
+        memset(out, 0, sizeof(AssetImage));
         return -1;
     }
+    memcpy(out->delays, delays, frames * sizeof(uint32_t));
+    out->frames = frames;
+    return 0;
+}
 
-    uint16_t header;
-    fread(&header, 2, 1, fp);
+/* Premultiply a decoded sprite and list its opaque and blended spans.
+ * Short clear or opaque stretches are folded into the blended spans around
+ * them, blending them gives the same result and keeps the spans long. */
+static int PrepareSprite(AssetImage *img) {
+    const int minrun = 8;
+    size_t cap = 64, count = 0;
+
+    if (img->width > 65535) return -1;
+    PremultiplyPixels(img->pixels, (size_t)img->width * img->height);
+    img->rowspans = (uint32_t *)malloc((img->height + 1) * sizeof(uint32_t));
+    img->spans = (SpriteSpan *)malloc(cap * sizeof(SpriteSpan));
+    if (!img->rowspans || !img->spans) return -1;
+
+    for (int y = 0; y < img->height; y++) {
+        const uint32_t *row = img->pixels + (size_t)y * img->width;
+        SpriteSpan *cur = NULL;
+        img->rowspans[y] = (uint32_t)count;
+
+        for (int x = 0; x < img->width; ) {
+            uint32_t a = row[x] >> 24;
+            int cls = a == 0 ? 0 : (a == 255 ? 2 : 1);
+            int end = x + 1;
+            while (end < img->width) {
+                uint32_t b = row[end] >> 24;
+                if ((b == 0 ? 0 : (b == 255 ? 2 : 1)) != cls) break;
+                end++;
+            }
+
+            /* Clear: gap if long or at a row edge. Opaque: copied if long */
+            int len = end - x;
+            if (cls == 0 && (len >= minrun || x == 0 || end == img->width)) {
+                cur = NULL;
+            } else {
+                int opaque = cls == 2 && len >= minrun;
+                if (cur && !cur->opaque && !opaque) {
+                    cur->len = (uint16_t)(end - cur->x);
+                } else {
+                    if (count == cap) {
+                        SpriteSpan *grown = (SpriteSpan *)realloc(img->spans, cap * 2 * sizeof(SpriteSpan));
+                        if (!grown) return -1;
+                        img->spans = grown;
+                        cap *= 2;
+                    }
+                    cur = &img->spans[count++];
+                    cur->x = (uint16_t)x;
+                    cur->len = (uint16_t)len;
+                    cur->opaque = (uint16_t)opaque;
+                }
+            }
+            x = end;
+        }
+    }
+    img->rowspans[img->height] = (uint32_t)count;
+    return 0;
+}
 
-    uint32_t pctsize;
-    if (header == 0x8b1f) { /* gzip magic (little-endian) */
-        fseek(fp, -4, SEEK_END);
-        uint8_t bytes[4];
-        fread(bytes, 4, 1, fp);
-        pctsize = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+/* Decode any asset into a freshly allocated image */
+static int AssetDecode(const char *path, int kind, AssetImage *out) {
+    memset(out, 0, sizeof(AssetImage));
+    if (kind == ASSET_BACKGROUND) {
+        out->pixels = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+        if (!out->pixels) return -1;
+        if (DecodeBackground(path, out->pixels) != 0) {
+            free(out->pixels);
+            out->pixels = NULL;
+            return -1;
+        }
+        out->width = SCREEN_WIDTH;
+        out->height = TEXT_AREA_START;
+        return 0;
+    }
+    int format = AssetIndexFormat(path);
+    int ret;
+    if (format == ASSET_FMT_W3S) {
+        return DecodeRunSprite(path, out);
+    }
+    if (format == ASSET_FMT_ANI) {
+        return DecodeAnimSprite(path, out);
+    }
+    if (format == ASSET_FMT_PNG) {
+        ret = DecodePngSprite(path, out);
+    } else if (format == ASSET_FMT_W3I) {
+        ret = DecodeW3iSprite(path, out);
     } else {
-        fseek(fp, 0, SEEK_END);
-        pctsize = ftell(fp);
+        ret = DecodeTextSprite(path, out);
+    }
+    if (ret == 0 && PrepareSprite(out) != 0) {
+        asset_image_free(out);
+        memset(out, 0, sizeof(AssetImage));
+        ret = -1;
     }
-    fclose(fp);
+    return ret;
+}
 
-    char *pctmem = (char *)malloc(pctsize);
-    if (!pctmem) {
-        gzclose(sprite);
-        return -1;
+/* Get a referenced decoded asset, decoding it now on a cache miss */
+static AssetImage *AssetLoad(const char *path, int kind) {
+    AssetImage *img = AssetCacheAcquire(path, kind);
+    if (img) return img;
+
+    AssetImage decoded;
+    if (AssetDecode(path, kind, &decoded) != 0) return NULL;
+    return AssetCacheInsert(path, kind, &decoded);
+}
+
+/* Fill [x, x + len) of a videoram row, clipped to [left, right) */
+static void FillSpan(uint32_t *row, int x, int len, int left, int right, uint32_t color) {
+    if (x < left) {
+        len -= left - x;
+        x = left;
     }
+    if (x + len > right) len = right - x;
+    draw_fill(row + x, color, len);
+}
 
-    gzread(sprite, pctmem, pctsize);
-    gzclose(sprite);
+/* Draw a W3S sprite: skips cost nothing, runs become black/white fills */
+static void BlitRunSprite(const AssetImage *img, int posx, int posy, const RECT *clip) {
+    int left = clip->left;
+    int right = (img->flags & ASSET_LEGACY) ? SCREEN_WIDTH - 1 : SCREEN_WIDTH;
+    const uint8_t *p = img->runs;
+    const uint8_t *end = img->runs + img->runsize;
+    if (right > clip->right) right = clip->right;
 
-    int x = 0, y = 0;
-    for (uint32_t pctpos = 0; pctpos < pctsize; pctpos++) {
-        if (pctmem[pctpos] == 10) { /* Newline */
-            if (posy + y < TEXT_AREA_START) {
-                y++;
-                x = 0;
-            } else {
-                break;
+    for (int sy = 0; sy < img->height; sy++) {
+        int screen_y = posy + sy;
+        if (screen_y >= clip->bottom) break;
+
+        uint32_t *row = g_videoram + screen_y * SCREEN_WIDTH;
+        uint32_t spans = w3s_varint(&p, end);
+        int x = posx;
+        while (spans-- > 0) {
+            x += (int)w3s_varint(&p, end);
+            int len = (int)w3s_varint(&p, end);
+            const uint8_t *bits = p;
+            p += (len + 7) / 8;
+            if (screen_y < clip->top || x >= right || x + len <= left) {
+                x += len;
+                continue;
             }
-        } else if (pctmem[pctpos] == ' ') { /* Transparency */
-            if (x + posx < 639) x++;
-        } else if (pctmem[pctpos] == '0' || pctmem[pctpos] == '1') {
-            if (x + posx < 639 && posy + y < TEXT_AREA_START) {
-                int ppos = (y + posy) * SCREEN_WIDTH + x + posx;
-                g_videoram[ppos] = (pctmem[pctpos] == '1') ? COLOR_BLACK : COLOR_WHITE;
-                x++;
+
+            /* Group equal bits into fills, whole 0x00/0xff bytes at once */
+            int i = 0;
+            while (i < len) {
+                int bit = (bits[i >> 3] >> (7 - (i & 7))) & 1;
+                int n = i + 1;
+                while (n < len) {
+                    if ((n & 7) == 0 && n + 8 <= len && bits[n >> 3] == (bit ? 0xff : 0x00)) {
+                        n += 8;
+                    } else if (((bits[n >> 3] >> (7 - (n & 7))) & 1) == bit) {
+                        n++;
+                    } else {
+                        break;
+                    }
+                }
+                FillSpan(row, x + i, n - i, left, right, bit ? COLOR_BLACK : COLOR_WHITE);
+                i = n;
             }
+            x += len;
         }
     }
+}
 
-    free(pctmem);
-    return 0;
+/* Draw the part of a sprite inside 'clip': opaque spans are copied, the others blended */
+static void BlitSpriteClip(const AssetImage *img, int posx, int posy, const RECT *clip) {
+    /* Legacy sprites never touched the last column */
+    int left = clip->left;
+    int right = (img->flags & ASSET_LEGACY) ? SCREEN_WIDTH - 1 : SCREEN_WIDTH;
+    if (right > clip->right) right = clip->right;
+
+    if (img->runs) {
+        BlitRunSprite(img, posx, posy, clip);
+        return;
+    }
+
+    for (int sy = 0; sy < img->height; sy++) {
+        int screen_y = posy + sy;
+        if (screen_y < clip->top) continue;
+        if (screen_y >= clip->bottom) break;
+
+        const uint32_t *row = img->pixels + (size_t)sy * img->width;
+        uint32_t *dst = g_videoram + screen_y * SCREEN_WIDTH;
+        for (uint32_t s = img->rowspans[sy]; s < img->rowspans[sy + 1]; s++) {
+            const SpriteSpan *span = &img->spans[s];
+            int x0 = posx + span->x;
+            int x1 = x0 + span->len;
+            int skip = x0 < left ? left - x0 : 0;
+            if (x1 > right) x1 = right;
+            if (x0 + skip >= x1) continue;
+
+            if (span->opaque) {
+                memcpy(dst + x0 + skip, row + span->x + skip, (x1 - x0 - skip) * sizeof(uint32_t));
+            } else {
+                BlendSpan(dst + x0 + skip, row + span->x + skip, x1 - x0 - skip);
+            }
+        }
+    }
+}
+
+/* Load the image of a sprite list entry, NULL if it can't be shown */
+static AssetImage *sprite_image(const sprite *s) {
+    return AssetLoad(g_spriteNames[s->name], ASSET_SPRITE);
 }
 
-/* Display a sprite (auto-detects PNG or legacy text format) */
-static int DisplaySprite(const char *spritefile, int posx, int posy) {
-    if (IsPngFile(spritefile)) {
-        return DisplayPngSprite(spritefile, posx, posy);
+/* Width of one frame, animation atlases hold their frames side by side */
+static int sprite_frame_width(const AssetImage *img) {
+    return img->frames > 1 ? img->width / img->frames : img->width;
+}
+
+/* Draw the frame shown by a sprite list entry, clipped to 'clip' */
+static void draw_sprite(const sprite *s, const AssetImage *img, const RECT *clip) {
+    int fw = sprite_frame_width(img);
+    RECT box, area;
+    SetRect(&box, s->x, s->y, s->x + fw, s->y + img->height);
+    if (!IntersectRect(&area, &box, clip)) return;
+    BlitSpriteClip(img, s->x - s->frame * fw, s->y, &area);
+}
+
+/* Draw a sprite list entry over the image area */
+static void DrawSprite(const sprite *s) {
+    RECT clip;
+    AssetImage *img = sprite_image(s);
+    if (!img) return;
+    SetRect(&clip, 0, 0, SCREEN_WIDTH, TEXT_AREA_START);
+    draw_sprite(s, img, &clip);
+    AssetCacheRelease(img);
+}
+
+/* Grow 'r' by the image area part of a sprite */
+static void sprite_bounds(const sprite *s, const AssetImage *img, RECT *r) {
+    int fw = sprite_frame_width(img);
+    int x0 = s->x < 0 ? 0 : s->x;
+    int y0 = s->y < 0 ? 0 : s->y;
+    int x1 = s->x + fw > SCREEN_WIDTH ? SCREEN_WIDTH : s->x + fw;
+    int y1 = s->y + img->height > TEXT_AREA_START ? TEXT_AREA_START : s->y + img->height;
+    if (x0 >= x1 || y0 >= y1) return;
+    if (r->left >= r->right) {
+        SetRect(r, x0, y0, x1, y1);
+        return;
+    }
+    if (x0 < r->left) r->left = x0;
+    if (y0 < r->top) r->top = y0;
+    if (x1 > r->right) r->right = x1;
+    if (y1 > r->bottom) r->bottom = y1;
+}
+
+/* Restore the background under 'r' and repaint the first 'count' sprites there */
+static void repaint_rect(const RECT *r, int count) {
+    draw_copy_rect(g_videoram, g_background, SCREEN_WIDTH, r->left, r->top,
+                   r->right - r->left, r->bottom - r->top);
+    for (int i = 0; i < count; i++) {
+        const sprite *sp = &currentsprites.items[i];
+        AssetImage *img = sprite_image(sp);
+        if (!img) continue;
+        draw_sprite(sp, img, r);
+        AssetCacheRelease(img);
+    }
+}
+
+/* Take the image area from previoussprites to currentsprites over the same
+ * background. Sprites past the common prefix were removed or moved: the
+ * background is restored under them, the kept sprites are repainted in that
+ * rectangle only, and the new sprites are drawn on top in z-order. */
+static void RedrawSpriteDiff(void) {
+    int keep = common_sprites();
+    RECT dirty = {0, 0, 0, 0};
+
+    for (int i = keep; i < previoussprites.count; i++) {
+        AssetImage *img = sprite_image(&previoussprites.items[i]);
+        if (!img) continue;
+        sprite_bounds(&previoussprites.items[i], img, &dirty);
+        AssetCacheRelease(img);
+    }
+    if (dirty.left < dirty.right) repaint_rect(&dirty, keep);
+
+    for (int i = keep; i < currentsprites.count; i++) {
+        DrawSprite(&currentsprites.items[i]);
+    }
+}
+
+/* Redraw one sprite's box, after its frame changed */
+static void redraw_sprite_box(const sprite *s) {
+    RECT box = {0, 0, 0, 0};
+    AssetImage *img = sprite_image(s);
+    if (!img) return;
+    sprite_bounds(s, img, &box);
+    AssetCacheRelease(img);
+    if (box.left < box.right) repaint_rect(&box, currentsprites.count);
+}
+
+/* Frame shown 'elapsed' ms into a looping animation, and ms until the next one */
+static int anim_frame(const AssetImage *img, DWORD elapsed, DWORD *left) {
+    DWORD total = 0;
+    for (int i = 0; i < img->frames; i++) total += img->delays[i];
+    elapsed %= total;
+    for (int i = 0; i < img->frames - 1; i++) {
+        if (elapsed < img->delays[i]) {
+            *left = img->delays[i] - elapsed;
+            return i;
+        }
+        elapsed -= img->delays[i];
+    }
+    *left = img->delays[img->frames - 1] - elapsed;
+    return img->frames - 1;
+}
+
+/* Advance running animations, called from the input and delay loops. Only
+ * the box of a sprite whose frame changed is redrawn, from the background
+ * plane and the sprites over it. */
+static void AnimTick(void) {
+    if (!g_animRunning) return;
+    DWORD now = timeGetTime();
+    if ((int)(now - g_animDue) < 0) return;
+
+    DWORD next = 1000;
+    int running = 0;
+    int changed = 0;
+    for (int i = 0; i < currentsprites.count; i++) {
+        sprite *sp = &currentsprites.items[i];
+        if (!sp->anim) continue;
+        AssetImage *img = sprite_image(sp);
+        if (!img) continue;
+
+        int frame = sp->frame;
+        if (img->frames > 1) {
+            DWORD left;
+            frame = anim_frame(img, now - sp->start, &left);
+            if (left < next) next = left;
+            running = 1;
+        }
+        AssetCacheRelease(img);
+        if (frame != sp->frame) {
+            sp->frame = frame;
+            redraw_sprite_box(sp);
+            changed = 1;
+        }
+    }
+    g_animRunning = running;
+    g_animDue = now + next;
+    if (changed) update_display();
+}
+
+/* Stop the animations of 'path' (all of them if NULL), back on their first
+ * frame. 'redraw' is 0 while replaying, when nothing is on screen yet. */
+static void StopAnimations(const char *path, int redraw) {
+    int name = path ? sprite_intern(path) : -1;
+    for (int i = 0; i < currentsprites.count; i++) {
+        sprite *sp = &currentsprites.items[i];
+        if (!sp->anim || (name >= 0 && sp->name != name)) continue;
+        sp->anim = 0;
+        if (sp->frame != 0) {
+            sp->frame = 0;
+            if (redraw) redraw_sprite_box(sp);
+        }
     }
-    return DisplayTextSprite(spritefile, posx, posy);
 }
 
 /* ── Main engine MIDI SFX ───────────────────────────────────────────────── */
+#define MIDI_SFX_NOTES  16
+#define MIDI_SFX_MS     500     /* a quarter note at 120 bpm, like the file */
+
 static char g_midiSfxTmp[260] = "";
 static UINT g_midiSfxMciId = 0;
+static HMIDIOUT g_midiSfxOut = NULL;
+static DWORD g_midiSfxOff[MIDI_SFX_NOTES]; /* note-off of each sounding note, 0 = none */
+static DWORD g_midiSfxDue[MIDI_SFX_NOTES];
 
 /* Generate a 42-byte single-note MIDI file for Wine SFX */
 static void gen_sfx_midi(const char *path, BYTE status, BYTE note, BYTE vel) {
@@ -2076,7 +2860,7 @@ static void gen_sfx_midi(const char *path, BYTE status, BYTE note, BYTE vel) {
     if (f) { fwrite(mid, 1, sizeof(mid), f); fclose(f); }
 }
 
-static void CloseMidiSfx(void) {
+static void midi_sfx_mci_close(void) {
     if (g_midiSfxMciId) {
         mciSendCommand(g_midiSfxMciId, MCI_STOP, 0, 0);
         mciSendCommand(g_midiSfxMciId, MCI_CLOSE, 0, 0);
@@ -2088,12 +2872,83 @@ static void CloseMidiSfx(void) {
     }
 }
 
+/* Release the MIDI mapper, notes still sounding are cut */
+static void midi_sfx_out_close(void) {
+    if (g_midiSfxOut) {
+        KillTimer(g_hwnd, SFX_TIMER_ID);
+        midiOutReset(g_midiSfxOut);
+        midiOutClose(g_midiSfxOut);
+        g_midiSfxOut = NULL;
+    }
+    memset(g_midiSfxOff, 0, sizeof(g_midiSfxOff));
+}
+
+static void CloseMidiSfx(void) {
+    midi_sfx_out_close();
+    midi_sfx_mci_close();
+}
+
+/* SFX_TIMER_ID: end the notes that are due, and release the mapper once
+ * none is left so MCI can have it for MIDI music */
+static void MidiSfxTick(void) {
+    DWORD now = timeGetTime();
+    int left = 0;
+    for (int i = 0; i < MIDI_SFX_NOTES; i++) {
+        if (!g_midiSfxOff[i]) continue;
+        if ((int)(now - g_midiSfxDue[i]) >= 0) {
+            midiOutShortMsg(g_midiSfxOut, g_midiSfxOff[i]);
+            g_midiSfxOff[i] = 0;
+        } else {
+            left++;
+        }
+    }
+    if (!left) midi_sfx_out_close();
+}
+
+/* Send the message straight to the MIDI mapper, a note-on ending
+ * MIDI_SFX_MS later. Returns -1 if the mapper can't be opened */
+static int midi_sfx_out(BYTE status, BYTE note, BYTE vel) {
+    if (!g_midiSfxOut && midiOutOpen(&g_midiSfxOut, MIDI_MAPPER, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR) {
+        g_midiSfxOut = NULL;
+        return -1;
+    }
+    DWORD off = (DWORD)status | ((DWORD)note << 8);
+    int slot = -1;
+    if ((status & 0xF0) == 0x90) {
+        /* The same note again takes its slot, else the one ending first */
+        for (int i = 0; i < MIDI_SFX_NOTES && slot < 0; i++) {
+            if (g_midiSfxOff[i] == off) slot = i;
+        }
+        for (int i = 0; i < MIDI_SFX_NOTES && slot < 0; i++) {
+            if (!g_midiSfxOff[i]) slot = i;
+        }
+        if (slot < 0) {
+            slot = 0;
+            for (int i = 1; i < MIDI_SFX_NOTES; i++) {
+                if ((int)(g_midiSfxDue[i] - g_midiSfxDue[slot]) < 0) slot = i;
+            }
+        }
+        if (g_midiSfxOff[slot]) midiOutShortMsg(g_midiSfxOut, g_midiSfxOff[slot]);
+    }
+    midiOutShortMsg(g_midiSfxOut, off | ((DWORD)vel << 16));
+    if (slot >= 0) {
+        g_midiSfxOff[slot] = off;
+        g_midiSfxDue[slot] = timeGetTime() + MIDI_SFX_MS;
+    }
+    SetTimer(g_hwnd, SFX_TIMER_ID, 50, NULL);
+    return 0;
+}
+
 static void PlayMidiSfx(DWORD msg) {
     BYTE status = (BYTE)(msg & 0xFF);
     BYTE note   = (BYTE)((msg >> 8) & 0xFF);
     BYTE vel    = (BYTE)((msg >> 16) & 0xFF);
     BYTE scaled_vel = (BYTE)((vel * g_sfxVolume + 50) / 100);
 
+    /* Wine: midiOut doesn't route through FluidSynth, it gets the note as
+       a one-note file over MCI, like Windows when the mapper is busy */
+    if (!IsWine() && midi_sfx_out(status, note, scaled_vel) == 0) return;
+
     if (g_midiSfxMciId) {
         mciSendCommand(g_midiSfxMciId, MCI_STOP, 0, 0);
         mciSendCommand(g_midiSfxMciId, MCI_CLOSE, 0, 0);
@@ -2207,7 +3062,7 @@ static void scale_wav_buf(unsigned char *buf, long fsize, int vol_pct) {
     }
 }
 
-static void CloseWavSfx(void) {
+static void wav_sfx_mci_close(void) {
     if (g_wavSfxMciId) {
         mciSendCommand(g_wavSfxMciId, MCI_STOP, 0, 0);
         mciSendCommand(g_wavSfxMciId, MCI_CLOSE, 0, 0);
@@ -2219,17 +3074,27 @@ static void CloseWavSfx(void) {
     }
 }
 
+static void CloseWavSfx(void) {
+    MixerStop();
+    wav_sfx_mci_close();
+}
+
 static void PlayWavSfx(const char *filename) {
     char srcpath[260], playpath[260];
     MCI_OPEN_PARMS mo;
     MCI_PLAY_PARMS pp;
 
     snprintf(srcpath, sizeof(srcpath), "data\\%s", filename);
-    CloseWavSfx();
 
-    if (g_sfxVolume == 0)
+    if (g_sfxVolume == 0 || file_exists(srcpath) != 0)
         return;
 
+    /* PCM and ADPCM WAVs go to the mixer, MCI plays what it can't decode,
+     * one at a time */
+    if (MixerPlay(srcpath, g_sfxVolume) == 0)
+        return;
+    wav_sfx_mci_close();
+
     if (g_sfxVolume < 100) {
         /* Scale PCM samples into a temp file */
         FILE *f;
@@ -2245,15 +3110,13 @@ static void PlayWavSfx(const char *filename) {
             snprintf(g_wavSfxTmp, sizeof(g_wavSfxTmp), "%s\\sfx_wav.wav", tmpdir);
         }
 
-        f = fopen(srcpath, "rb");
-        if (!f) return;
-        fseek(f, 0, SEEK_END);
-        fsize = ftell(f);
-        fseek(f, 0, SEEK_SET);
+        AssetBlob blob;
+        if (AssetReadAll(srcpath, &blob) != 0) return;
+        fsize = (long)blob.size;
         wav = (unsigned char *)malloc(fsize);
-        if (!wav) { fclose(f); return; }
-        if ((long)fread(wav, 1, fsize, f) != fsize) { free(wav); fclose(f); return; }
-        fclose(f);
+        if (!wav) { AssetFreeBlob(&blob); return; }
+        memcpy(wav, blob.data, fsize);
+        AssetFreeBlob(&blob);
 
         scale_wav_buf(wav, fsize, g_sfxVolume);
 
@@ -2265,9 +3128,8 @@ static void PlayWavSfx(const char *filename) {
 
         strncpy(playpath, g_wavSfxTmp, 259);
         playpath[259] = '\0';
-    } else {
-        strncpy(playpath, srcpath, 259);
-        playpath[259] = '\0';
+    } else if (AssetLocalPath(srcpath, playpath, sizeof(playpath)) != 0) {
+        return;
     }
 
     memset(&mo, 0, sizeof mo);
@@ -2358,6 +3220,7 @@ static void SetMasterVolume(int pos) {
         char cmd[64];
         int vol = (pos * 1000) / 100;
         g_wineVolume = pos;
+        MusicSetVolume(pos);
         if (g_mciDeviceID != 0) {
             snprintf(cmd, sizeof(cmd), "setaudio w3vn_music volume to %d", vol);
             mciSendString(cmd, NULL, 0, NULL);
@@ -2798,7 +3661,12 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         case WM_KEYDOWN:
             if (wParam == 'C') {
                 ShowConfigDialog();
-            } else if (!g_effectrunning) {
+            } else if (wParam == 'P') {
+                if (GetKeyState(VK_SHIFT) < 0) CaptureRecord();
+                else CaptureScreen();
+            } else if (g_effectrunning) {
+                if (wParam == VK_SPACE || wParam == VK_ESCAPE) g_effectskip = 1;
+            } else {
                 switch (wParam) {
                     case VK_SPACE: g_lastkey = 1; break;
                     case 'Q': g_lastkey = 2; break;
@@ -2829,6 +3697,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             } else if (g_windowactive) {
                 g_mouseclick = 1;
                 g_lastkey = 1;
+                if (g_effectrunning) g_effectskip = 1;
             }
             break;
 
@@ -2874,6 +3743,18 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             break;
         }
 
+        case WM_QUERYNEWPALETTE:
+            /* Realize our palette again on getting the focus back */
+            if (g_hpal) {
+                update_display();
+                return TRUE;
+            }
+            return FALSE;
+
+        case WM_PALETTECHANGED:
+            if ((HWND)wParam != hwnd && g_hpal) update_display();
+            break;
+
         case WM_VIDEO_REPAINT:
             if (g_videoPlaying && g_videoWindow) {
                 InvalidateRect(g_videoWindow, NULL, TRUE);
@@ -2908,10 +3789,10 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         case MM_MCINOTIFY:
             /* MIDI SFX finished - close device to release MIDI hardware */
             if (g_midiSfxMciId != 0 && (UINT)lParam == g_midiSfxMciId) {
-                CloseMidiSfx();
+                midi_sfx_mci_close();
             /* WAV SFX finished - close device immediately to free waveaudio */
             } else if (g_wavSfxMciId != 0 && (UINT)lParam == g_wavSfxMciId) {
-                CloseWavSfx();
+                wav_sfx_mci_close();
             /* Music finished playing - restart for looping */
             } else if (wParam == MCI_NOTIFY_SUCCESSFUL && g_mciDeviceID != 0 && (UINT)lParam == g_mciDeviceID) {
                 RestartMusic();
@@ -2922,6 +3803,10 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             /* Poll music status for Win32s compatibility */
             if (wParam == MUSIC_TIMER_ID) {
                 CheckMusicStatus();
+            } else if (wParam == SFX_TIMER_ID) {
+                MidiSfxTick();
+            } else if (wParam == MIXER_TIMER_ID) {
+                MixerIdle();
             }
             break;
 
@@ -12,6 +12,7 @@
 #include <windows.h>
 #include <mmsystem.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
@@ -20,23 +21,59 @@
 #include <zlib.h>
 #include <png.h>
 
+#include "draw.h"
+#include "pal8.h"
+#include "rgb16.h"
+
 #pragma comment(lib, "winmm.lib")
 
-/* Screen dimensions */
-#define SCREEN_WIDTH  640
-#define SCREEN_HEIGHT 400
-#define TEXT_AREA_START 320
+/* Screen dimensions, 640x400 unless the 'G' line of stvn.ini sets another
+ * size at startup. The text box keeps its height, the image area gets the
+ * rest */
+#define BASE_WIDTH       640
+#define BASE_HEIGHT      400
+#define MAX_WIDTH        2048
+#define MAX_HEIGHT       1536
+#define TEXT_AREA_HEIGHT 80     /* sayer and 4 text lines of the 8x15 font */
+
+static int g_screenWidth = BASE_WIDTH;
+static int g_screenHeight = BASE_HEIGHT;
+
+#define SCREEN_WIDTH  g_screenWidth
+#define SCREEN_HEIGHT g_screenHeight
+#define TEXT_AREA_START (SCREEN_HEIGHT - TEXT_AREA_HEIGHT)
+
+/* Text box lines: sayer name, then the first of the 15 pixel text lines */
+#define TEXT_SAYER_Y (TEXT_AREA_START + 2)
+#define TEXT_LINE_Y (TEXT_AREA_START + 17)
+
+/* Dialogs are laid out for a 640x320 image area, this centers them */
+#define DIALOG_DX ((SCREEN_WIDTH - BASE_WIDTH) / 2)
+#define DIALOG_DY ((TEXT_AREA_START - (BASE_HEIGHT - TEXT_AREA_HEIGHT)) / 2)
 
 /* Colors in BGRA format */
 #define COLOR_WHITE 0xFFFFFFFF
 #define COLOR_BLACK 0xFF000000
 
-/* Music timer ID */
+/* Timer IDs */
 #define MUSIC_TIMER_ID 1
-#define DEFER_RENDER_TIME_ID 2
+#define SFX_TIMER_ID   2        /* note-offs of 'Q' MIDI SFX */
+#define MIXER_TIMER_ID 3        /* SFX mixer refill on Win32s */
 
 #define IMAGE_AREA_PIXELS (SCREEN_WIDTH * TEXT_AREA_START)
-#define TEXT_AREA_PIXELS (SCREEN_WIDTH * 80)
+#define TEXT_AREA_PIXELS (SCREEN_WIDTH * TEXT_AREA_HEIGHT)
+
+/* Decoded asset cache */
+#define ASSET_CACHE_SLOTS  64
+#define ASSET_CACHE_BUDGET ((size_t)IMAGE_AREA_PIXELS * 30)  /* 6 MB at 640x400 */
+#define ASSET_BACKGROUND   0
+#define ASSET_SPRITE       1
+
+/* Most frames in an animated sprite */
+#define ANIM_MAX_FRAMES    64
+
+/* Default script lookahead depth, in lines ('L' line in stvn.ini) */
+#define PREFETCH_DEFAULT_DEPTH 64
 
 /* Rhythm game high score file */
 #define RGSCORE_FILE "data\\rgscore.txt"
@@ -0,0 +1,88 @@
+/*
+ *      Screen layers for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      g_videoram holds the scene plane (background + sprites, the rows
+ *      above TEXT_AREA_START) and the text plane (the text box, the last
+ *      TEXT_AREA_HEIGHT rows). Dialogs draw into
+ *      the UI overlay plane instead, and their rectangles are laid over the
+ *      other planes only when a frame is presented, so closing a dialog has
+ *      nothing to restore. Text box clears copy back just the rows that were
+ *      printed on since the last clear.
+ */
+
+/* Included into w3vn.c before func.c */
+
+#define OVERLAY_MAX 4
+
+typedef struct {
+    int x, y, w, h;
+} OverlayRect;
+
+static uint32_t *g_overlay = NULL;      /* UI overlay plane, SCREEN_WIDTH x SCREEN_HEIGHT */
+static OverlayRect g_overlayRects[OVERLAY_MAX];
+static int g_overlayCount = 0;
+
+/* Whether the scene and text planes may fit the 8-bpp palette. Cleared
+ * when one turns out to have more than 256 colors, set again once it is
+ * drawn anew (a background loaded, the text box cleared) */
+static int g_pal8Scene = 1;
+static int g_pal8Text = 1;
+
+/* Text box rows printed on since the last ClearTextArea(), none until
+ * clear_screen() */
+static int g_textDirtyTop = 0;
+static int g_textDirtyBottom = 0;
+
+/* Plane the text and line primitives draw into */
+static uint32_t *LayerDrawPlane(void) {
+    return g_overlayCount > 0 ? g_overlay : g_videoram;
+}
+
+/* Open a white dialog rectangle on the overlay, drawing goes there until it is closed */
+static void OverlayOpen(int x, int y, int w, int h) {
+    if (!draw_clip(&x, &y, &w, &h, SCREEN_WIDTH, SCREEN_HEIGHT)) return;
+    if (!g_overlay || g_overlayCount == OVERLAY_MAX) return;
+
+    draw_rect(g_overlay, SCREEN_WIDTH, x, y, w, h, SCREEN_WIDTH, SCREEN_HEIGHT, COLOR_WHITE);
+    OverlayRect *r = &g_overlayRects[g_overlayCount++];
+    r->x = x;
+    r->y = y;
+    r->w = w;
+    r->h = h;
+}
+
+/* Close the topmost dialog, the planes under it were never drawn on */
+static void OverlayClose(void) {
+    if (g_overlayCount > 0) g_overlayCount--;
+}
+
+/* Compose one row of the presented frame: scene or text, then open dialogs */
+static void LayerComposeRow(uint32_t *out, int y) {
+    memcpy(out, g_videoram + y * SCREEN_WIDTH, SCREEN_WIDTH * sizeof(uint32_t));
+    for (int i = 0; i < g_overlayCount; i++) {
+        const OverlayRect *r = &g_overlayRects[i];
+        if (y >= r->y && y < r->y + r->h) {
+            memcpy(out + r->x, g_overlay + y * SCREEN_WIDTH + r->x, r->w * sizeof(uint32_t));
+        }
+    }
+}
+
+/* Record text box rows drawn on */
+static void TextMarkRows(int y, int count) {
+    if (y < g_textDirtyTop) g_textDirtyTop = y < TEXT_AREA_START ? TEXT_AREA_START : y;
+    if (y + count > g_textDirtyBottom) g_textDirtyBottom = y + count > SCREEN_HEIGHT ? SCREEN_HEIGHT : y + count;
+}
+
+/* Blank the text box from the g_textarea template, over the printed rows only.
+ * The border is left to RedrawBorder() as before. */
+static void ClearTextArea(void) {
+    if (g_textDirtyTop < g_textDirtyBottom) {
+        int offset = (g_textDirtyTop - TEXT_AREA_START) * SCREEN_WIDTH;
+        memcpy(g_videoram + IMAGE_AREA_PIXELS + offset, g_textarea + offset,
+               (g_textDirtyBottom - g_textDirtyTop) * SCREEN_WIDTH * sizeof(uint32_t));
+    }
+    g_textDirtyTop = SCREEN_HEIGHT;
+    g_textDirtyBottom = TEXT_AREA_START;
+    g_pal8Text = 1;
+}
@@ -0,0 +1,666 @@
+/*
+ *      Sound mixer for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Plays 'K' sound effects and WAV music on a waveOut device of its own
+ *      rather than an MCI device each. WAVs may be PCM or IMA and MS ADPCM.
+ *      Effects are decoded once to 16-bit stereo at the mixer rate and kept
+ *      in memory, up to MIXER_CACHE_BUDGET bytes. Music is streamed from
+ *      the file or the archive, one chunk read while the other plays, an
+ *      ADPCM block at a time, and loops with no gap between its loop
+ *      points. A new track can crossfade with the previous one. Up to
+ *      MIXER_VOICES effects and the music are mixed, each at its own
+ *      volume, into a ring of buffers that holds MIXER_LATENCY_MS of sound
+ *      in all, so a new effect is heard at most that late. A worker thread
+ *      refills the buffers as waveOut hands them back and reads the music
+ *      ahead, a timer and the idle slices do on Win32s which has no threads
+ *      and gets a longer ring. The device is only open while something
+ *      plays, so MCI can still have it in between.
+ */
+
+/* Included into w3vn.c after func.c */
+
+#define MIXER_BUFFERS       4
+#define MIXER_SOUNDS        32
+#define MIXER_VOICES        8
+#define MIXER_CACHE_BUDGET  (4 * 1024 * 1024)
+#define MIXER_MAX_SECONDS   60
+#define MIXER_TIMER_MS      20
+#define MIXER_LATENCY_MS    40      /* whole ring, the most a sound starts late */
+#define MIXER_LATENCY_WIN32S_MS 160 /* the timer only ticks every 55 ms there */
+#define MUSIC_STREAMS       2       /* the track and the one fading out */
+#define MUSIC_CHUNK_FRAMES  16384   /* file frames per read */
+#define MUSIC_GAIN_ONE      0x10000000 /* full gain, 28 fraction bits */
+
+typedef struct {
+    char path[260];
+    int16_t *samples;           /* stereo at g_mixerRate, NULL when free */
+    uint32_t frames;
+    unsigned long used;         /* last play, for eviction */
+} MixerSound;
+
+typedef struct {
+    int sound;                  /* -1 when free */
+    uint32_t pos;               /* next frame */
+    int volume;                 /* 0-256 */
+    unsigned long started;
+} MixerVoice;
+
+typedef struct {
+    int16_t *samples;           /* stereo at the file rate */
+    uint32_t frames;
+    volatile int ready;         /* set once read, cleared once mixed */
+} MusicChunk;
+
+typedef struct {
+    int open;                   /* being mixed */
+    volatile int done;          /* faded out or failed, the reader closes it */
+    AssetStream in;
+    WavInfo info;
+    uint32_t offset;            /* of the samples in the file */
+    uint32_t loopstart, loopend; /* frames, loopend not included */
+    uint32_t readpos;           /* next frame to read */
+    uint8_t *raw;
+    int16_t *block;             /* ADPCM block being read, decoded */
+    uint32_t blockno, blockframes; /* which one, frames it has */
+    MusicChunk chunk[2];        /* one is mixed while the other is read */
+    int fill, play;             /* next chunk to read, chunk being mixed */
+    uint32_t playpos;           /* next frame in it */
+    uint32_t step, frac;        /* 16.16 file frames per output frame */
+    int prev[2], cur[2];        /* frames interpolated between */
+    int32_t gain, fade;         /* 0-MUSIC_GAIN_ONE, change per output frame */
+} MusicStream;
+
+static HWAVEOUT g_mixerOut = NULL;
+static WAVEHDR g_mixerHdr[MIXER_BUFFERS];
+static int16_t *g_mixerData = NULL;
+static int32_t *g_mixerAcc = NULL;
+static int g_mixerNext = 0;     /* next buffer to queue */
+static int g_mixerRate = 44100;
+static int g_mixerFrames = 441; /* per buffer */
+static MixerSound g_mixerSounds[MIXER_SOUNDS];
+static size_t g_mixerCacheBytes = 0;
+static MixerVoice g_mixerVoices[MIXER_VOICES];
+static unsigned long g_mixerClock = 0;
+static CRITICAL_SECTION g_mixerLock;
+static HANDLE g_mixerThread = NULL;
+static HANDLE g_mixerWake = NULL;
+static volatile int g_mixerQuit = 0;
+
+static MusicStream g_music[MUSIC_STREAMS];
+static int g_musicVolume = 256;
+static CRITICAL_SECTION g_musicLock; /* held to read, open or close streams */
+
+/* Open the device and prepare the buffers, with the lock held */
+static int mixer_open(void) {
+    WAVEFORMATEX wf;
+    MMRESULT ret;
+    memset(&wf, 0, sizeof(wf));
+    wf.wFormatTag = WAVE_FORMAT_PCM;
+    wf.nChannels = 2;
+    wf.nSamplesPerSec = g_mixerRate;
+    wf.wBitsPerSample = 16;
+    wf.nBlockAlign = 4;
+    wf.nAvgBytesPerSec = g_mixerRate * 4;
+    if (g_mixerThread) {
+        ret = waveOutOpen(&g_mixerOut, WAVE_MAPPER, &wf, (DWORD)g_mixerWake, 0, CALLBACK_EVENT);
+    } else {
+        ret = waveOutOpen(&g_mixerOut, WAVE_MAPPER, &wf, 0, 0, CALLBACK_NULL);
+    }
+    if (ret != MMSYSERR_NOERROR) {
+        g_mixerOut = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < MIXER_BUFFERS; i++) {
+        memset(&g_mixerHdr[i], 0, sizeof(WAVEHDR));
+        g_mixerHdr[i].lpData = (LPSTR)(g_mixerData + i * g_mixerFrames * 2);
+        g_mixerHdr[i].dwBufferLength = g_mixerFrames * 4;
+        waveOutPrepareHeader(g_mixerOut, &g_mixerHdr[i], sizeof(WAVEHDR));
+        g_mixerHdr[i].dwFlags |= WHDR_DONE;
+    }
+    g_mixerNext = 0;
+    if (!g_mixerThread) SetTimer(g_hwnd, MIXER_TIMER_ID, MIXER_TIMER_MS, NULL);
+    return 0;
+}
+
+/* Cut whatever is queued and give the device back, with the lock held */
+static void mixer_close(void) {
+    if (!g_mixerOut) return;
+    if (!g_mixerThread) KillTimer(g_hwnd, MIXER_TIMER_ID);
+    waveOutReset(g_mixerOut);
+    for (int i = 0; i < MIXER_BUFFERS; i++) {
+        waveOutUnprepareHeader(g_mixerOut, &g_mixerHdr[i], sizeof(WAVEHDR));
+    }
+    waveOutClose(g_mixerOut);
+    g_mixerOut = NULL;
+}
+
+/* Next file frame into the interpolator, -1 if its chunk isn't read yet */
+static int music_next(MusicStream *m) {
+    MusicChunk *c = &m->chunk[m->play];
+    if (!c->ready) return -1;
+    m->prev[0] = m->cur[0];
+    m->prev[1] = m->cur[1];
+    m->cur[0] = c->samples[m->playpos * 2];
+    m->cur[1] = c->samples[m->playpos * 2 + 1];
+    if (++m->playpos == c->frames) {
+        c->ready = 0;
+        m->play ^= 1;
+        m->playpos = 0;
+    }
+    return 0;
+}
+
+/* Add 'frames' output frames of the stream to the mix. A late reader
+ * leaves the rest silent, the stream picks up from there next time */
+static void music_mix(MusicStream *m, int32_t *acc, int frames) {
+    for (int i = 0; i < frames; i++) {
+        while (m->frac >= 0x10000) {
+            if (music_next(m) != 0) return;
+            m->frac -= 0x10000;
+        }
+        /* frac halved so the product stays within 31 bits */
+        int f = (int)(m->frac >> 1), g = ((m->gain >> 20) * g_musicVolume) >> 8;
+        acc[i * 2] += ((m->prev[0] + (((m->cur[0] - m->prev[0]) * f) >> 15)) * g) >> 8;
+        acc[i * 2 + 1] += ((m->prev[1] + (((m->cur[1] - m->prev[1]) * f) >> 15)) * g) >> 8;
+        m->frac += m->step;
+        if (m->fade) {
+            m->gain += m->fade;
+            if (m->gain >= MUSIC_GAIN_ONE) {
+                m->gain = MUSIC_GAIN_ONE;
+                m->fade = 0;
+            } else if (m->gain <= 0) {
+                m->done = 1;
+                return;
+            }
+        }
+    }
+}
+
+/* Mix and queue the free buffers while voices or music play, close the
+ * device once they are all done. Called with the lock held */
+static void mixer_pump(void) {
+    int active = 1;
+    if (!g_mixerOut) return;
+
+    while (active && (g_mixerHdr[g_mixerNext].dwFlags & WHDR_DONE)) {
+        int16_t *out = (int16_t *)g_mixerHdr[g_mixerNext].lpData;
+        int n = g_mixerFrames * 2;
+        active = 0;
+        memset(g_mixerAcc, 0, n * sizeof(int32_t));
+        for (int v = 0; v < MIXER_VOICES; v++) {
+            MixerVoice *voice = &g_mixerVoices[v];
+            if (voice->sound < 0) continue;
+            const MixerSound *s = &g_mixerSounds[voice->sound];
+            uint32_t left = s->frames - voice->pos;
+            int count = left < (uint32_t)g_mixerFrames ? (int)left * 2 : n;
+            const int16_t *src = s->samples + voice->pos * 2;
+            for (int i = 0; i < count; i++) g_mixerAcc[i] += (src[i] * voice->volume) >> 8;
+            voice->pos += count / 2;
+            if (voice->pos >= s->frames) voice->sound = -1;
+            active = 1;
+        }
+        for (int i = 0; i < MUSIC_STREAMS; i++) {
+            if (g_music[i].open && !g_music[i].done) {
+                music_mix(&g_music[i], g_mixerAcc, g_mixerFrames);
+                active = 1;
+            }
+        }
+        if (!active) break;
+
+        for (int i = 0; i < n; i++) {
+            int32_t a = g_mixerAcc[i];
+            out[i] = (int16_t)(a > 32767 ? 32767 : a < -32768 ? -32768 : a);
+        }
+        waveOutWrite(g_mixerOut, &g_mixerHdr[g_mixerNext], sizeof(WAVEHDR));
+        g_mixerNext = (g_mixerNext + 1) % MIXER_BUFFERS;
+    }
+
+    if (!active) {
+        for (int i = 0; i < MIXER_BUFFERS; i++) {
+            if (!(g_mixerHdr[i].dwFlags & WHDR_DONE)) return;
+        }
+        mixer_close();
+    }
+}
+
+static void music_close(MusicStream *m) {
+    AssetStreamClose(&m->in);
+    free(m->raw);
+    free(m->block);
+    free(m->chunk[0].samples);
+    free(m->chunk[1].samples);
+    memset(m, 0, sizeof(MusicStream));
+}
+
+/* Up to 'n' frames from readpos to 'dst', from the ADPCM block it is in,
+ * which is read and decoded unless it already is. 0 if it can't be read */
+static uint32_t music_block(MusicStream *m, int16_t *dst, uint32_t n) {
+    uint32_t no = m->readpos / m->info.blockframes, skip = m->readpos % m->info.blockframes;
+    if (no != m->blockno) {
+        uint32_t at = no * m->info.align, len = m->info.size - at;
+        if (len > (uint32_t)m->info.align) len = m->info.align;
+        m->blockno = no;
+        m->blockframes = 0;
+        if (AssetStreamRead(&m->in, m->offset + at, m->raw, len) != 0) return 0;
+        m->blockframes = wav_decode_block(&m->info, m->raw, len, m->info.blockframes, m->block);
+    }
+    if (skip >= m->blockframes) return 0;
+    if (n > m->blockframes - skip) n = m->blockframes - skip;
+    memcpy(dst, m->block + skip * 2, n * 4);
+    return n;
+}
+
+/* Read the chunks the mixer is done with, looping between the loop
+ * points. Called with g_musicLock held, not the mixer lock */
+static void music_fill(MusicStream *m) {
+    while (!m->done && !m->chunk[m->fill].ready) {
+        MusicChunk *c = &m->chunk[m->fill];
+        uint32_t got = 0;
+        while (got < MUSIC_CHUNK_FRAMES) {
+            uint32_t n = m->loopend - m->readpos;
+            if (n > MUSIC_CHUNK_FRAMES - got) n = MUSIC_CHUNK_FRAMES - got;
+            if (m->block) {
+                n = music_block(m, c->samples + got * 2, n);
+            } else if (AssetStreamRead(&m->in, m->offset + m->readpos * m->info.align, m->raw,
+                                       n * m->info.align) == 0) {
+                wav_pcm16(&m->info, m->raw, n, c->samples + got * 2);
+            } else {
+                n = 0;
+            }
+            if (n == 0) {
+                m->done = 1;
+                return;
+            }
+            got += n;
+            m->readpos += n;
+            if (m->readpos == m->loopend) m->readpos = m->loopstart;
+        }
+        c->frames = got;
+        EnterCriticalSection(&g_mixerLock);
+        c->ready = 1;
+        LeaveCriticalSection(&g_mixerLock);
+        m->fill ^= 1;
+    }
+}
+
+/* Read ahead of the mixer and close the streams it is done with */
+static void music_read(void) {
+    EnterCriticalSection(&g_musicLock);
+    for (int i = 0; i < MUSIC_STREAMS; i++) {
+        MusicStream *m = &g_music[i];
+        if (!m->open) continue;
+        music_fill(m);
+        if (m->done) {
+            EnterCriticalSection(&g_mixerLock);
+            music_close(m);
+            LeaveCriticalSection(&g_mixerLock);
+        }
+    }
+    LeaveCriticalSection(&g_musicLock);
+}
+
+/* Mix on each buffer waveOut hands back, then read the music outside the
+ * mixer lock so a slow disk doesn't hold the mixing up */
+static DWORD WINAPI MixerThreadProc(LPVOID param) {
+    (void)param;
+    while (!g_mixerQuit) {
+        WaitForSingleObject(g_mixerWake, INFINITE);
+        if (g_mixerQuit) break;
+        EnterCriticalSection(&g_mixerLock);
+        mixer_pump();
+        LeaveCriticalSection(&g_mixerLock);
+        music_read();
+    }
+    return 0;
+}
+
+/* Allocate the buffers and start the worker (not on Win32s), whose event
+ * waveOut signals as it finishes with a buffer */
+static void MixerInit(void) {
+    InitializeCriticalSection(&g_mixerLock);
+    InitializeCriticalSection(&g_musicLock);
+    wav_init();
+    for (int v = 0; v < MIXER_VOICES; v++) g_mixerVoices[v].sound = -1;
+
+    /* The ring holds MIXER_LATENCY_MS in all, a new sound goes into the
+     * first buffer to come back. Win32s: lower rate and a longer ring,
+     * refilled on a 55 ms timer */
+    if (IsWin32s()) {
+        g_mixerRate = 22050;
+        g_mixerFrames = g_mixerRate * MIXER_LATENCY_WIN32S_MS / 1000 / MIXER_BUFFERS;
+    } else {
+        g_mixerFrames = g_mixerRate * MIXER_LATENCY_MS / 1000 / MIXER_BUFFERS;
+    }
+    g_mixerData = (int16_t *)malloc(MIXER_BUFFERS * g_mixerFrames * 4);
+    g_mixerAcc = (int32_t *)malloc(g_mixerFrames * 2 * sizeof(int32_t));
+
+    if (!IsWin32s()) {
+        DWORD tid;
+        g_mixerWake = CreateEventA(NULL, FALSE, FALSE, NULL);
+        if (g_mixerWake) {
+            g_mixerThread = CreateThread(NULL, 0, MixerThreadProc, NULL, 0, &tid);
+            if (g_mixerThread) {
+                SetThreadPriority(g_mixerThread, THREAD_PRIORITY_HIGHEST);
+            } else {
+                CloseHandle(g_mixerWake);
+                g_mixerWake = NULL;
+            }
+        }
+    }
+}
+
+static void MixerShutdown(void) {
+    if (g_mixerThread) {
+        g_mixerQuit = 1;
+        SetEvent(g_mixerWake);
+        WaitForSingleObject(g_mixerThread, INFINITE);
+        CloseHandle(g_mixerThread);
+        g_mixerThread = NULL;
+    }
+    for (int i = 0; i < MUSIC_STREAMS; i++) {
+        if (g_music[i].open) music_close(&g_music[i]);
+    }
+    mixer_close();
+    if (g_mixerWake) {
+        CloseHandle(g_mixerWake);
+        g_mixerWake = NULL;
+    }
+    for (int i = 0; i < MIXER_SOUNDS; i++) free(g_mixerSounds[i].samples);
+    memset(g_mixerSounds, 0, sizeof(g_mixerSounds));
+    g_mixerCacheBytes = 0;
+    free(g_mixerData);
+    free(g_mixerAcc);
+    g_mixerData = NULL;
+    g_mixerAcc = NULL;
+    DeleteCriticalSection(&g_mixerLock);
+    DeleteCriticalSection(&g_musicLock);
+}
+
+/* Stereo frames at 'rate' to the mixer rate, by linear interpolation.
+ * Returns 'src' itself when the rates match */
+static int16_t *mixer_resample(int16_t *src, uint32_t frames, int rate, uint32_t *outframes) {
+    if (rate == g_mixerRate) {
+        *outframes = frames;
+        return src;
+    }
+    uint32_t n = (uint32_t)((double)frames * g_mixerRate / rate);
+    uint32_t step = (uint32_t)((double)rate * 65536.0 / g_mixerRate);
+    uint32_t idx = 0, frac = 0;
+    int16_t *out = (int16_t *)malloc((size_t)(n ? n : 1) * 4);
+    if (!out) return NULL;
+    for (uint32_t i = 0; i < n && idx < frames; i++) {
+        const int16_t *a = src + idx * 2;
+        const int16_t *b = idx + 1 < frames ? a + 2 : a;
+        /* frac halved so the product stays within 31 bits */
+        out[i * 2] = (int16_t)(a[0] + (((b[0] - a[0]) * (int)(frac >> 1)) >> 15));
+        out[i * 2 + 1] = (int16_t)(a[1] + (((b[1] - a[1]) * (int)(frac >> 1)) >> 15));
+        frac += step;
+        idx += frac >> 16;
+        frac &= 0xffff;
+    }
+    *outframes = n;
+    return out;
+}
+
+/* Whether a voice plays sound 's', with the lock held */
+static int mixer_playing(int s) {
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        if (g_mixerVoices[v].sound == s) return 1;
+    }
+    return 0;
+}
+
+/* Cached sound of 'path', decoding it on first use. -1 if it can't be */
+static int mixer_sound(const char *path) {
+    for (int i = 0; i < MIXER_SOUNDS; i++) {
+        if (g_mixerSounds[i].samples && strcmp(g_mixerSounds[i].path, path) == 0) return i;
+    }
+
+    AssetBlob blob;
+    WavInfo info;
+    int16_t *samples = NULL;
+    uint32_t frames = 0;
+    if (AssetReadAll(path, &blob) != 0) return -1;
+    if (wav_info(blob.data, blob.size, &info) == 0 && wav_decodable(&info) && info.frames > 0 &&
+        info.frames <= (uint32_t)info.rate * MIXER_MAX_SECONDS) {
+        int16_t *pcm = (int16_t *)malloc((size_t)info.frames * 4);
+        if (pcm) {
+            wav_decode(&info, pcm);
+            samples = mixer_resample(pcm, info.frames, info.rate, &frames);
+            if (samples != pcm) free(pcm);
+        }
+    }
+    AssetFreeBlob(&blob);
+    if (!samples) return -1;
+
+    /* Make room from the least recently played sounds that are not playing */
+    size_t bytes = (size_t)frames * 4;
+    int slot = -1;
+    EnterCriticalSection(&g_mixerLock);
+    for (;;) {
+        int lru = -1;
+        slot = -1;
+        for (int i = 0; i < MIXER_SOUNDS; i++) {
+            if (!g_mixerSounds[i].samples) {
+                if (slot < 0) slot = i;
+            } else if (!mixer_playing(i) && (lru < 0 || g_mixerSounds[i].used < g_mixerSounds[lru].used)) {
+                lru = i;
+            }
+        }
+        if (slot >= 0 && g_mixerCacheBytes + bytes <= MIXER_CACHE_BUDGET) break;
+        if (lru < 0) break;
+        g_mixerCacheBytes -= (size_t)g_mixerSounds[lru].frames * 4;
+        free(g_mixerSounds[lru].samples);
+        g_mixerSounds[lru].samples = NULL;
+    }
+    /* A sound larger than the budget is still kept, next to the playing ones */
+    if (slot >= 0) {
+        snprintf(g_mixerSounds[slot].path, sizeof(g_mixerSounds[slot].path), "%s", path);
+        g_mixerSounds[slot].samples = samples;
+        g_mixerSounds[slot].frames = frames;
+        g_mixerCacheBytes += bytes;
+    }
+    LeaveCriticalSection(&g_mixerLock);
+    if (slot < 0) free(samples);
+    return slot;
+}
+
+/* Start 'path' at 'volume' (0-100) on a free voice, or the oldest one.
+ * Returns -1 when it is no WAV the mixer decodes or no device can be opened */
+static int MixerPlay(const char *path, int volume) {
+    int s = mixer_sound(path);
+    if (s < 0 || !g_mixerData || !g_mixerAcc) return -1;
+
+    EnterCriticalSection(&g_mixerLock);
+    if (!g_mixerOut && mixer_open() != 0) {
+        LeaveCriticalSection(&g_mixerLock);
+        return -1;
+    }
+    MixerVoice *voice = &g_mixerVoices[0];
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        if (g_mixerVoices[v].sound < 0) {
+            voice = &g_mixerVoices[v];
+            break;
+        }
+        if (g_mixerVoices[v].started < voice->started) voice = &g_mixerVoices[v];
+    }
+    voice->sound = s;
+    voice->pos = 0;
+    voice->volume = (volume * 256 + 50) / 100;
+    voice->started = ++g_mixerClock;
+    g_mixerSounds[s].used = g_mixerClock;
+    mixer_pump();
+    LeaveCriticalSection(&g_mixerLock);
+    return 0;
+}
+
+/* Whether the music is mixed, with the lock held */
+static int music_playing(void) {
+    for (int i = 0; i < MUSIC_STREAMS; i++) {
+        if (g_music[i].open) return 1;
+    }
+    return 0;
+}
+
+/* Silence every effect at once, the device goes unless music plays */
+static void MixerStop(void) {
+    EnterCriticalSection(&g_mixerLock);
+    for (int v = 0; v < MIXER_VOICES; v++) g_mixerVoices[v].sound = -1;
+    if (!music_playing()) mixer_close();
+    LeaveCriticalSection(&g_mixerLock);
+}
+
+/* Refill the buffers and read the music without a worker, on the timer
+ * and idle slices */
+static void MixerIdle(void) {
+    if (g_mixerThread || !g_mixerOut) return;
+    EnterCriticalSection(&g_mixerLock);
+    mixer_pump();
+    LeaveCriticalSection(&g_mixerLock);
+    music_read();
+}
+
+/* Open the WAV at 'path' for streaming. The loop goes from loopstart to
+ * loopend - 1 when they make sense, else that of a smpl chunk, else the
+ * whole file */
+static int music_open(MusicStream *m, const char *path, long loopstart, long loopend) {
+    uint8_t h[12], c[WAV_FMT_MAX];
+    uint32_t pos = 12, smplstart = 0, smplend = 0, fact = 0;
+    int fmt = 0, data = 0, smpl = 0;
+    memset(m, 0, sizeof(MusicStream));
+    if (AssetStreamOpen(path, &m->in) != 0) return -1;
+    if (AssetStreamRead(&m->in, 0, h, 12) != 0 || memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0) {
+        music_close(m);
+        return -1;
+    }
+
+    /* The chunks are walked with a read per header, the data is skipped */
+    while (pos + 8 <= m->in.size && AssetStreamRead(&m->in, pos, h, 8) == 0) {
+        uint32_t len = wav_get32(h + 4);
+        if (len > m->in.size - pos - 8) len = m->in.size - pos - 8;
+        uint32_t take = len < sizeof(c) ? len : sizeof(c);
+        if (memcmp(h, "fmt ", 4) == 0 && AssetStreamRead(&m->in, pos + 8, c, take) == 0) {
+            fmt = wav_fmt(c, take, &m->info) == 0;
+        } else if (memcmp(h, "fact", 4) == 0 && len >= 4 && AssetStreamRead(&m->in, pos + 8, c, 4) == 0) {
+            fact = wav_get32(c);
+        } else if (memcmp(h, "data", 4) == 0 && fmt && !data) {
+            m->offset = pos + 8;
+            m->info.size = len;
+            data = 1;
+        } else if (memcmp(h, "smpl", 4) == 0 && AssetStreamRead(&m->in, pos + 8, c, take) == 0) {
+            smpl = wav_smpl(c, take, &smplstart, &smplend) == 0;
+        }
+        pos += 8 + len + (len & 1); /* chunks are word-aligned */
+    }
+    if (!data || !wav_decodable(&m->info) || m->info.blockframes < 1) {
+        music_close(m);
+        return -1;
+    }
+    wav_frames(&m->info, fact);
+    if (m->info.frames == 0) {
+        music_close(m);
+        return -1;
+    }
+
+    m->loopend = m->info.frames;
+    if (loopstart >= 0 && loopend > loopstart && (uint32_t)loopend <= m->info.frames) {
+        m->loopstart = (uint32_t)loopstart;
+        m->loopend = (uint32_t)loopend;
+    } else if (smpl && smplend <= m->info.frames) {
+        m->loopstart = smplstart;
+        m->loopend = smplend;
+    }
+
+    /* PCM is read a chunk at a time, ADPCM a block */
+    if (m->info.format == WAV_PCM) {
+        m->raw = (uint8_t *)malloc(MUSIC_CHUNK_FRAMES * m->info.align);
+    } else {
+        m->raw = (uint8_t *)malloc(m->info.align);
+        m->block = (int16_t *)malloc((size_t)m->info.blockframes * 4);
+        m->blockno = 0xffffffffu;
+    }
+    m->chunk[0].samples = (int16_t *)malloc(MUSIC_CHUNK_FRAMES * 4);
+    m->chunk[1].samples = (int16_t *)malloc(MUSIC_CHUNK_FRAMES * 4);
+    if (!m->raw || (m->info.format != WAV_PCM && !m->block) || !m->chunk[0].samples || !m->chunk[1].samples) {
+        music_close(m);
+        return -1;
+    }
+    m->step = (uint32_t)((double)m->info.rate * 65536.0 / g_mixerRate);
+    m->frac = 0x10000;
+    return 0;
+}
+
+/* Stream the WAV at 'path' in place of the current track, crossfading over
+ * 'fade' ms when there is one. Loop points as in music_open(). Returns -1
+ * if the mixer can't play it, MCI is left to try */
+static int MusicStart(const char *path, int fade, long loopstart, long loopend) {
+    if (!g_mixerData || !g_mixerAcc) return -1;
+    EnterCriticalSection(&g_musicLock);
+
+    /* The tail of an earlier crossfade makes room */
+    EnterCriticalSection(&g_mixerLock);
+    for (int i = 0; i < MUSIC_STREAMS; i++) {
+        if (g_music[i].open && (g_music[i].fade < 0 || g_music[i].done)) music_close(&g_music[i]);
+    }
+    LeaveCriticalSection(&g_mixerLock);
+    MusicStream *m = &g_music[g_music[0].open ? 1 : 0];
+    MusicStream *old = &g_music[g_music[0].open ? 0 : 1];
+
+    /* The first chunks are read before it is mixed */
+    if (music_open(m, path, loopstart, loopend) != 0) {
+        LeaveCriticalSection(&g_musicLock);
+        return -1;
+    }
+    music_fill(m);
+
+    EnterCriticalSection(&g_mixerLock);
+    if (m->done || (!g_mixerOut && mixer_open() != 0)) {
+        music_close(m);
+        LeaveCriticalSection(&g_mixerLock);
+        LeaveCriticalSection(&g_musicLock);
+        return -1;
+    }
+    /* Rounded, so even long fades come out within a fraction of a percent */
+    int32_t ramp = 0;
+    if (fade > 0) {
+        double frames = (double)fade * g_mixerRate / 1000.0;
+        ramp = (int32_t)(MUSIC_GAIN_ONE / frames + 0.5);
+        if (ramp < 1) ramp = 1;
+    }
+    if (old->open && ramp) {
+        old->fade = -ramp;
+        m->fade = ramp;
+    } else {
+        if (old->open) music_close(old);
+        m->gain = MUSIC_GAIN_ONE;
+    }
+    m->open = 1;
+    mixer_pump();
+    LeaveCriticalSection(&g_mixerLock);
+    LeaveCriticalSection(&g_musicLock);
+    return 0;
+}
+
+/* Stop the music at once, the device goes unless effects play */
+static void MusicStop(void) {
+    EnterCriticalSection(&g_musicLock);
+    EnterCriticalSection(&g_mixerLock);
+    for (int i = 0; i < MUSIC_STREAMS; i++) {
+        if (g_music[i].open) music_close(&g_music[i]);
+    }
+    int voices = 0;
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        if (g_mixerVoices[v].sound >= 0) voices = 1;
+    }
+    if (!voices) mixer_close();
+    LeaveCriticalSection(&g_mixerLock);
+    LeaveCriticalSection(&g_musicLock);
+}
+
+/* Music volume 0-100, where the system mixer can't be used (Wine). Also
+ * set from the INI before the mixer starts, a single store needs no lock */
+static void MusicSetVolume(int volume) {
+    g_musicVolume = (volume * 256 + 50) / 100;
+}
@@ -0,0 +1,132 @@
+/*
+ *      Native animations for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Plays W3V animations ('M' lines) straight into the image area, with
+ *      no MCI device or child window. Each frame is applied on top of the
+ *      previous one when its time comes on the clock, and only the area it
+ *      changed is presented, at the display's depth like any other frame.
+ *      The keyframe is presented whole, so its colors are in the palette
+ *      realized on palette displays. Frames that are late are applied
+ *      together and presented once. Only the file and one inflated frame
+ *      are kept.
+ */
+
+/* Included into w3vn.c after func.c */
+
+typedef struct {
+    int open;
+    AssetBlob blob;
+    W3vInfo info;
+    uint8_t *raw;               /* inflated frame */
+    uint32_t rawcap;
+    int next;                   /* next frame to apply */
+    int x, y;                   /* top-left in the image area */
+    DWORD due;                  /* when the next frame is due */
+    int paused;
+    DWORD pausedat;
+} Movie;
+
+static Movie g_movie;
+
+static void MovieClose(void) {
+    AssetFreeBlob(&g_movie.blob);
+    free(g_movie.raw);
+    memset(&g_movie, 0, sizeof(g_movie));
+}
+
+/* Open 'path' centered in a black image area, the first frame due now */
+static int MovieOpen(const char *path) {
+    MovieClose();
+    if (AssetReadAll(path, &g_movie.blob) != 0) return -1;
+    if (w3v_info(g_movie.blob.data, g_movie.blob.size, &g_movie.info) != 0 ||
+        g_movie.info.width > SCREEN_WIDTH || g_movie.info.height > TEXT_AREA_START) {
+        MovieClose();
+        return -1;
+    }
+    g_movie.x = (SCREEN_WIDTH - g_movie.info.width) / 2;
+    g_movie.y = (TEXT_AREA_START - g_movie.info.height) / 2;
+    g_movie.open = 1;
+
+    draw_fill(g_videoram, COLOR_BLACK, IMAGE_AREA_PIXELS);
+    g_pal8Scene = 1;
+    update_display();
+    g_movie.due = timeGetTime();
+    return 0;
+}
+
+/* Payload of a frame, inflated if needed. NULL when it is bad */
+static const uint8_t *movie_payload(const W3vFrame *f, uint32_t *size) {
+    if (!(f->flags & W3V_DEFLATED)) {
+        *size = f->size;
+        return f->data;
+    }
+    /* No frame can be larger than every pixel sent on its own */
+    if (f->rawsize > (uint32_t)g_movie.info.width * g_movie.info.height * 8 + 65536) return NULL;
+    if (f->rawsize > g_movie.rawcap) {
+        uint8_t *raw = (uint8_t *)realloc(g_movie.raw, f->rawsize);
+        if (!raw) return NULL;
+        g_movie.raw = raw;
+        g_movie.rawcap = f->rawsize;
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int ret = Z_DATA_ERROR;
+    if (inflateInit2(&zs, -MAX_WBITS) == Z_OK) {
+        zs.next_in = (Bytef *)f->data;
+        zs.avail_in = f->size;
+        zs.next_out = g_movie.raw;
+        zs.avail_out = f->rawsize;
+        ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+    }
+    if (ret != Z_STREAM_END || zs.total_out != f->rawsize) return NULL;
+    *size = f->rawsize;
+    return g_movie.raw;
+}
+
+/* Apply the frames that are due and present what they changed. Returns 0
+ * once the last frame has been on screen for its delay */
+static int MovieTick(void) {
+    if (!g_movie.open) return 0;
+    if (g_movie.paused) return 1;
+
+    DWORD now = timeGetTime();
+    RECT dirty;
+    int key = g_movie.next == 0;
+    SetRectEmpty(&dirty);
+    while (g_movie.next < g_movie.info.frames && (int)(now - g_movie.due) >= 0) {
+        W3vFrame f;
+        uint32_t size;
+        int rect[4];
+        w3v_frame(g_movie.blob.data, &g_movie.info, g_movie.next, &f);
+        const uint8_t *p = movie_payload(&f, &size);
+        /* A bad frame still reports what it drew before failing */
+        if (p) {
+            w3v_apply(p, size, &g_movie.info, g_videoram + g_movie.y * SCREEN_WIDTH + g_movie.x,
+                      SCREEN_WIDTH, rect);
+            if (rect[2] > rect[0]) {
+                RECT r;
+                SetRect(&r, g_movie.x + rect[0], g_movie.y + rect[1], g_movie.x + rect[2], g_movie.y + rect[3]);
+                UnionRect(&dirty, &dirty, &r);
+            }
+        }
+        g_movie.due += f.delay;
+        g_movie.next++;
+    }
+    if (key && g_movie.next > 0) update_display();
+    else if (!IsRectEmpty(&dirty)) PresentRect(&dirty);
+    return g_movie.next < g_movie.info.frames || (int)(now - g_movie.due) < 0;
+}
+
+/* Hold the clock while a dialog is up */
+static void MoviePause(int pause) {
+    if (pause && !g_movie.paused) {
+        g_movie.pausedat = timeGetTime();
+        g_movie.paused = 1;
+    } else if (!pause && g_movie.paused) {
+        g_movie.due += timeGetTime() - g_movie.pausedat;
+        g_movie.paused = 0;
+    }
+}
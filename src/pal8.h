@@ -0,0 +1,67 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      8-bpp indexed frames, shared by the engine and w3bench. A composed
+ *      32-bit frame is turned into one byte per pixel and a palette of up
+ *      to 256 colors, found as it goes in a small open-addressed table.
+ *      Runs of one color, most of a 1-bit or low-color screen, take a
+ *      single lookup. Frames with more colors are left to the 32-bit path.
+ */
+
+#ifndef PAL8_H
+#define PAL8_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PAL8_COLORS  256
+#define PAL8_HASH    1024       /* table slots, a power of two */
+
+typedef struct {
+    uint32_t colors[PAL8_COLORS];   /* 0x00RRGGBB, laid out as RGBQUADs */
+    int count;
+    uint32_t keys[PAL8_HASH];
+    uint16_t slots[PAL8_HASH];      /* palette index + 1, 0 when free */
+} Pal8;
+
+static inline void pal8_reset(Pal8 *p) {
+    p->count = 0;
+    memset(p->slots, 0, sizeof(p->slots));
+}
+
+/* Index of color 'c' (0x00RRGGBB), added if new. -1 once the palette is full */
+static inline int pal8_lookup(Pal8 *p, uint32_t c) {
+    uint32_t h = (c * 2654435761u) >> 22;
+    while (p->slots[h]) {
+        if (p->keys[h] == c) return p->slots[h] - 1;
+        h = (h + 1) & (PAL8_HASH - 1);
+    }
+    if (p->count == PAL8_COLORS) return -1;
+    p->keys[h] = c;
+    p->slots[h] = (uint16_t)(p->count + 1);
+    p->colors[p->count] = c;
+    return p->count++;
+}
+
+/* Index 'count' 0xAARRGGBB pixels, alpha ignored. 0, or -1 past 256 colors */
+static inline int pal8_index_row(Pal8 *p, const uint32_t *src, uint8_t *dst, int count) {
+    int i = 0;
+    while (i < count) {
+        uint32_t c = src[i] & 0xffffff;
+        int idx = pal8_lookup(p, c);
+        if (idx < 0) return -1;
+        int end = i + 1;
+        while (end < count && (src[end] & 0xffffff) == c) end++;
+        memset(dst + i, idx, end - i);
+        i = end;
+    }
+    return 0;
+}
+
+/* Back to opaque 0xAARRGGBB pixels */
+static inline void pal8_expand_row(const Pal8 *p, const uint8_t *src, uint32_t *dst, int count) {
+    for (int i = 0; i < count; i++) dst[i] = 0xff000000u | p->colors[src[i]];
+}
+
+#endif /* PAL8_H */
@@ -0,0 +1,294 @@
+/*
+ *      Lookahead asset prefetcher for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Keeps the script in memory and, whenever the interpreter waits for
+ *      input, scans the next lines (following 'J' and both sides of 'B')
+ *      for 'I', 'A', 'Y', 'X96', 'X99' and 'G' images. These are decoded
+ *      into the asset cache by a worker thread, or one per idle slice on
+ *      Win32s which has no threads.
+ */
+
+/* Included into w3vn.c after func.c */
+
+#define PREFETCH_QUEUE_MAX   16
+#define PREFETCH_MAX_PATHS   8
+
+typedef struct {
+    char path[260];
+    int kind;
+} PrefetchItem;
+
+typedef struct {
+    long line;
+    int depth;
+} PrefetchPath;
+
+static char *g_scriptText = NULL;
+static char **g_scriptLines = NULL;
+static long g_scriptLineCount = 0;
+static long *g_labelHash = NULL;     /* line index + 1 of each label, 0 = empty */
+static long g_labelHashSize = 0;
+static int g_prefetchDepth = PREFETCH_DEFAULT_DEPTH;
+
+static PrefetchItem g_prefetchQueue[PREFETCH_QUEUE_MAX];
+static int g_prefetchHead = 0;
+static int g_prefetchCount = 0;
+static CRITICAL_SECTION g_prefetchLock;
+static HANDLE g_prefetchThread = NULL;
+static HANDLE g_prefetchWake = NULL;
+static volatile int g_prefetchQuit = 0;
+
+static unsigned long label_hash(const char *label) {
+    unsigned long h = 5381;
+    for (int i = 0; i < 5; i++) h = h * 33 + (unsigned char)label[i];
+    return h;
+}
+
+/* Find the first line starting with the 5-char label, -1 if none */
+static long label_find(const char *label) {
+    if (!g_labelHash) return -1;
+    unsigned long h = label_hash(label) & (g_labelHashSize - 1);
+    while (g_labelHash[h]) {
+        long idx = g_labelHash[h] - 1;
+        if (strncmp(g_scriptLines[idx], label, 5) == 0) return idx;
+        h = (h + 1) & (g_labelHashSize - 1);
+    }
+    return -1;
+}
+
+/* Load the script into a line table split exactly like get_line() does */
+static int load_script_lines(const char *scriptfile) {
+    FILE *fp = fopen(scriptfile, "rb");
+    if (!fp) return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *raw = (char *)malloc(size + 1);
+    if (!raw) {
+        fclose(fp);
+        return -1;
+    }
+    size = (long)fread(raw, 1, size, fp);
+    fclose(fp);
+
+    /* fgets() hands out at most 299 chars per line */
+    long count = 0;
+    for (long pos = 0; pos < size; count++) {
+        for (long len = 0; pos < size && len < 299; len++) {
+            if (raw[pos++] == '\n') break;
+        }
+    }
+
+    g_scriptText = (char *)malloc(size + count + 1);
+    g_scriptLines = (char **)malloc((count + 1) * sizeof(char *));
+    if (!g_scriptText || !g_scriptLines) {
+        free(raw);
+        return -1;
+    }
+
+    char *out = g_scriptText;
+    for (long pos = 0, n = 0; n < count; n++) {
+        long len = 0;
+        g_scriptLines[n] = out;
+        while (pos < size && len < 299) {
+            out[len++] = raw[pos];
+            if (raw[pos++] == '\n') break;
+        }
+        out[len] = '\0';
+        if (len > 0 && out[len - 1] == '\n') out[len - 1] = '\0';
+        if (len > 1 && out[len - 2] == '\r') out[len - 2] = '\0';
+        out += len + 1;
+    }
+    free(raw);
+    g_scriptLineCount = count;
+
+    /* Label table: first line for every 5-char prefix */
+    g_labelHashSize = 64;
+    while (g_labelHashSize < count * 2) g_labelHashSize <<= 1;
+    g_labelHash = (long *)calloc(g_labelHashSize, sizeof(long));
+    if (!g_labelHash) return -1;
+    for (long i = 0; i < count; i++) {
+        if (strlen(g_scriptLines[i]) < 5 || label_find(g_scriptLines[i]) >= 0) continue;
+        unsigned long h = label_hash(g_scriptLines[i]) & (g_labelHashSize - 1);
+        while (g_labelHash[h]) h = (h + 1) & (g_labelHashSize - 1);
+        g_labelHash[h] = i + 1;
+    }
+    return 0;
+}
+
+/* Decode the next queued asset, returns 0 when the queue is empty */
+static int PrefetchStep(void) {
+    PrefetchItem item;
+
+    EnterCriticalSection(&g_prefetchLock);
+    if (g_prefetchCount == 0) {
+        LeaveCriticalSection(&g_prefetchLock);
+        return 0;
+    }
+    item = g_prefetchQueue[g_prefetchHead];
+    g_prefetchHead = (g_prefetchHead + 1) % PREFETCH_QUEUE_MAX;
+    g_prefetchCount--;
+    LeaveCriticalSection(&g_prefetchLock);
+
+    AssetEntry *slot = AssetCacheReserve(item.path, item.kind);
+    if (slot) {
+        AssetImage img;
+        if (AssetDecode(item.path, item.kind, &img) == 0) {
+            AssetCacheFill(slot, &img);
+        } else {
+            AssetCacheFill(slot, NULL);
+        }
+    }
+    return 1;
+}
+
+static DWORD WINAPI PrefetchThreadProc(LPVOID param) {
+    (void)param;
+    while (!g_prefetchQuit) {
+        WaitForSingleObject(g_prefetchWake, INFINITE);
+        while (!g_prefetchQuit && PrefetchStep());
+    }
+    return 0;
+}
+
+/* Load the script lines and start the worker (not on Win32s) */
+static void PrefetchInit(const char *scriptfile) {
+    InitializeCriticalSection(&g_prefetchLock);
+    if (g_prefetchDepth <= 0) return;
+
+    if (load_script_lines(scriptfile) != 0) {
+        g_prefetchDepth = 0;
+        return;
+    }
+
+    if (!IsWin32s()) {
+        DWORD tid;
+        g_prefetchWake = CreateEventA(NULL, FALSE, FALSE, NULL);
+        if (g_prefetchWake) {
+            g_prefetchThread = CreateThread(NULL, 0, PrefetchThreadProc, NULL, 0, &tid);
+            if (g_prefetchThread) {
+                SetThreadPriority(g_prefetchThread, THREAD_PRIORITY_BELOW_NORMAL);
+            } else {
+                CloseHandle(g_prefetchWake);
+                g_prefetchWake = NULL;
+            }
+        }
+    }
+}
+
+static void PrefetchShutdown(void) {
+    if (g_prefetchThread) {
+        g_prefetchQuit = 1;
+        SetEvent(g_prefetchWake);
+        WaitForSingleObject(g_prefetchThread, INFINITE);
+        CloseHandle(g_prefetchThread);
+        CloseHandle(g_prefetchWake);
+        g_prefetchThread = NULL;
+        g_prefetchWake = NULL;
+    }
+    DeleteCriticalSection(&g_prefetchLock);
+    free(g_labelHash);
+    free(g_scriptLines);
+    free(g_scriptText);
+    g_labelHash = NULL;
+    g_scriptLines = NULL;
+    g_scriptText = NULL;
+    g_scriptLineCount = 0;
+}
+
+/* Append an asset to the scan result, skipping duplicates */
+static int prefetch_add(PrefetchItem *items, int count, int kind, const char *name, int len) {
+    if (count >= PREFETCH_QUEUE_MAX || len <= 0) return count;
+    if (len > 250) len = 250;
+    snprintf(items[count].path, sizeof(items[count].path), "data\\%.*s", len, name);
+    items[count].kind = kind;
+    for (int i = 0; i < count; i++) {
+        if (items[i].kind == kind && strcmp(items[i].path, items[count].path) == 0) return count;
+    }
+    return count + 1;
+}
+
+/* Scan ahead of lineNumber (lines already executed) and queue every image
+ * the reader may reach within g_prefetchDepth lines */
+static void PrefetchSchedule(long lineNumber) {
+    PrefetchItem items[PREFETCH_QUEUE_MAX];
+    PrefetchPath paths[PREFETCH_MAX_PATHS];
+    int count = 0;
+    int npaths = 0;
+    size_t budget = 0;
+
+    if (g_prefetchDepth <= 0 || !g_scriptLines) return;
+
+    paths[npaths].line = lineNumber;
+    paths[npaths].depth = g_prefetchDepth;
+    npaths++;
+
+    for (int p = 0; p < npaths && count < PREFETCH_QUEUE_MAX; p++) {
+        long idx = paths[p].line;
+        int depth = paths[p].depth;
+
+        while (depth-- > 0 && idx >= 0 && idx < g_scriptLineCount && count < PREFETCH_QUEUE_MAX) {
+            const char *line = g_scriptLines[idx++];
+            int len = (int)strlen(line);
+            int before = count;
+
+            if (*line == 'I') {
+                count = prefetch_add(items, count, ASSET_BACKGROUND, line + 1, len - 1);
+            } else if (*line == 'X' && len >= 4 && (strncmp(line + 1, "99", 2) == 0 || strncmp(line + 1, "96", 2) == 0)) {
+                count = prefetch_add(items, count, ASSET_BACKGROUND, line + 3, len - 3);
+            } else if ((*line == 'A' || (*line == 'Y' && line[1] != 'S')) && len >= 8) {
+                count = prefetch_add(items, count, ASSET_SPRITE, line + 7, len - 7);
+            } else if (*line == 'G' && len > 10) {
+                const char *args = line + 10;
+                const char *sep = strchr(args, '|');
+                if (line[1] == '0' && sep) {
+                    count = prefetch_add(items, count, ASSET_BACKGROUND, args, (int)(sep - args));
+                } else if (line[1] == '1') {
+                    count = prefetch_add(items, count, ASSET_BACKGROUND, args, len - 10);
+                }
+            } else if (*line == 'J' && len >= 6) {
+                idx = label_find(line + 1);
+                if (idx >= 0) idx++;
+            } else if (*line == 'B' && len == 8 && npaths < PREFETCH_MAX_PATHS) {
+                /* Follow the taken side later, keep scanning the fall-through */
+                long target = label_find(line + 3);
+                int seen = 0;
+                for (int i = 0; i < npaths; i++) {
+                    if (paths[i].line == target + 1) seen = 1;
+                }
+                if (target >= 0 && !seen) {
+                    paths[npaths].line = target + 1;
+                    paths[npaths].depth = depth;
+                    npaths++;
+                }
+            } else if (*line == 'F') {
+                break;
+            }
+
+            /* Don't queue more than half the cache worth of backgrounds */
+            if (count > before && items[before].kind == ASSET_BACKGROUND) {
+                budget += IMAGE_AREA_PIXELS * sizeof(uint32_t);
+                if (budget > ASSET_CACHE_BUDGET / 2) break;
+            }
+        }
+    }
+
+    /* Replace whatever is still pending, the reader has moved on */
+    EnterCriticalSection(&g_prefetchLock);
+    g_prefetchHead = 0;
+    g_prefetchCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (AssetCacheContains(items[i].path, items[i].kind)) continue;
+        g_prefetchQueue[g_prefetchCount++] = items[i];
+    }
+    LeaveCriticalSection(&g_prefetchLock);
+
+    if (g_prefetchThread && g_prefetchCount > 0) SetEvent(g_prefetchWake);
+}
+
+/* Idle slice while waiting for input: decode one asset without a worker */
+static void PrefetchIdle(void) {
+    if (!g_prefetchThread && g_prefetchDepth > 0) PrefetchStep();
+}
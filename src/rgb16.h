@@ -0,0 +1,114 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      32 to 16-bit pixel conversion, shared by the engine and w3bench.
+ *      Rows go to RGB565 or RGB555, optionally through a 4x4 ordered
+ *      dither: each channel gets a bias below one output step, from the
+ *      Bayer matrix cell of the pixel, before it is truncated. With SSE2
+ *      eight pixels are done at a time, the bias of a row repeating every
+ *      four pixels.
+ */
+
+#ifndef RGB16_H
+#define RGB16_H
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RGB16_SSE2 1
+#endif
+
+#define RGB16_565  0
+#define RGB16_555  1
+
+static const uint8_t rgb16_bayer[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+/* Dither bias of pixel x of row y as 0x00RRGGBB, half a step of 8 (5 bits)
+ * or 4 (6 bits) per Bayer level out of 16 */
+static inline uint32_t rgb16_bias(int x, int y, int format) {
+    uint32_t t = rgb16_bayer[y & 3][x & 3];
+    uint32_t g = format == RGB16_565 ? t >> 2 : t >> 1;
+    return (t >> 1) << 16 | g << 8 | t >> 1;
+}
+
+static inline uint16_t rgb16_pixel(uint32_t c, int format) {
+    if (format == RGB16_565)
+        return (uint16_t)(((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f));
+    return (uint16_t)(((c >> 9) & 0x7c00) | ((c >> 6) & 0x03e0) | ((c >> 3) & 0x001f));
+}
+
+/* Add a bias to each channel, saturating at 255 */
+static inline uint32_t rgb16_adds(uint32_t c, uint32_t bias) {
+    uint32_t r = ((c >> 16) & 0xff) + (bias >> 16);
+    uint32_t g = ((c >> 8) & 0xff) + ((bias >> 8) & 0xff);
+    uint32_t b = (c & 0xff) + (bias & 0xff);
+    return (r > 255 ? 255 : r) << 16 | (g > 255 ? 255 : g) << 8 | (b > 255 ? 255 : b);
+}
+
+#if defined(RGB16_SSE2)
+/* Eight pixels to 16 bits, packed with signed saturation after a sign
+ * extension so values past 0x7fff come through unchanged */
+static inline __m128i rgb16_pack8(__m128i a, __m128i b, int format) {
+    const __m128i rmask = _mm_set1_epi32(format == RGB16_565 ? 0xf800 : 0x7c00);
+    const __m128i gmask = _mm_set1_epi32(format == RGB16_565 ? 0x07e0 : 0x03e0);
+    const __m128i bmask = _mm_set1_epi32(0x001f);
+    __m128i pa, pb;
+    if (format == RGB16_565) {
+        pa = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(a, 8), rmask),
+                                       _mm_and_si128(_mm_srli_epi32(a, 5), gmask)),
+                          _mm_and_si128(_mm_srli_epi32(a, 3), bmask));
+        pb = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(b, 8), rmask),
+                                       _mm_and_si128(_mm_srli_epi32(b, 5), gmask)),
+                          _mm_and_si128(_mm_srli_epi32(b, 3), bmask));
+    } else {
+        pa = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(a, 9), rmask),
+                                       _mm_and_si128(_mm_srli_epi32(a, 6), gmask)),
+                          _mm_and_si128(_mm_srli_epi32(a, 3), bmask));
+        pb = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(b, 9), rmask),
+                                       _mm_and_si128(_mm_srli_epi32(b, 6), gmask)),
+                          _mm_and_si128(_mm_srli_epi32(b, 3), bmask));
+    }
+    pa = _mm_srai_epi32(_mm_slli_epi32(pa, 16), 16);
+    pb = _mm_srai_epi32(_mm_slli_epi32(pb, 16), 16);
+    return _mm_packs_epi32(pa, pb);
+}
+#endif
+
+/* Convert pixels x0 to x1 - 1 of row y (0xAARRGGBB) to 16 bits */
+static inline void rgb16_row(const uint32_t *src, uint16_t *dst, int x0, int x1, int y, int format, int dither) {
+    uint32_t bias[4] = {0, 0, 0, 0};
+    int x = x0;
+    if (dither) {
+        for (int i = 0; i < 4; i++) bias[i] = rgb16_bias(i, y, format);
+    }
+#if defined(RGB16_SSE2)
+    /* Scalar up to a multiple of 4, so the bias vector lines up */
+    for (; x < x1 && (x & 3); x++) {
+        dst[x] = rgb16_pixel(dither ? rgb16_adds(src[x], bias[x & 3]) : src[x], format);
+    }
+    __m128i vbias = _mm_set_epi32((int)bias[3], (int)bias[2], (int)bias[1], (int)bias[0]);
+    for (; x + 8 <= x1; x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + x + 4));
+        if (dither) {
+            a = _mm_adds_epu8(a, vbias);
+            b = _mm_adds_epu8(b, vbias);
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), rgb16_pack8(a, b, format));
+    }
+#endif
+    if (!dither) {
+        for (; x < x1; x++) dst[x] = rgb16_pixel(src[x], format);
+        return;
+    }
+    for (; x < x1; x++) dst[x] = rgb16_pixel(rgb16_adds(src[x], bias[x & 3]), format);
+}
+
+#endif /* RGB16_H */
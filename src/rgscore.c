@@ -76,8 +76,6 @@ int ShowRgScore(const char *img_path) {
         if (k == 1) return -3; /* Space */
         if (k == 5) return -1; /* B */
         if (k == 2) { /* Q: show quit dialog */
-            uint32_t *qsave = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
-            if (qsave) memcpy(qsave, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
             DispQuit();
             int qn = read_keyboard_status();
             while (qn != 9 && qn != 10 && qn != 11 && g_running) {
@@ -85,7 +83,7 @@ int ShowRgScore(const char *img_path) {
                 qn = read_keyboard_status();
                 Sleep(5);
             }
-            if (qsave) { memcpy(g_videoram, qsave, IMAGE_AREA_PIXELS * sizeof(uint32_t)); free(qsave); }
+            OverlayClose();
             update_display();
             if (qn == 10) return -2; /* confirmed quit */
         }
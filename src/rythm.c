@@ -29,13 +29,6 @@ extern void update_display(void);
 
 static float rg_fabsf(float x) { return (x < 0.0f) ? -x : x; }
 
-static int rg_isqrt(int n) {
-    if (n <= 0) return 0;
-    int x = n, y = 1;
-    while (x > y) { x = (x + y) / 2; y = n / x; }
-    return x;
-}
-
 #define IsWine() (GetProcAddress(GetModuleHandle("ntdll.dll"), "wine_get_version") != NULL)
 
 /* ── colours (BGRA) ─────────────────────────────────────────────────────── */
@@ -103,27 +96,11 @@ static unsigned int rg_hash_string(const char *s) {
 
 /* ── pixel helpers ───────────────────────────────────────────────────────── */
 static void rg_rect(int x, int y, int w, int h, uint32_t c) {
-    if (x < 0) { w += x; x = 0; }
-    if (y < 0) { h += y; y = 0; }
-    if (w <= 0 || h <= 0) return;
-    if (x + w > SCREEN_WIDTH)  w = SCREEN_WIDTH  - x;
-    if (y + h > TEXT_AREA_START) h = TEXT_AREA_START - y;
-    if (w <= 0 || h <= 0) return;
-    for (int py = y; py < y + h; py++)
-        for (int px = x; px < x + w; px++)
-            g_videoram[py * SCREEN_WIDTH + px] = c;
+    draw_rect(g_videoram, SCREEN_WIDTH, x, y, w, h, SCREEN_WIDTH, TEXT_AREA_START, c);
 }
 
 static void rg_circle(int cx, int cy, int r, uint32_t c) {
-    for (int dy = -r; dy <= r; dy++) {
-        int w = rg_isqrt(r * r - dy * dy);
-        int y = cy + dy;
-        if (y < 0 || y >= TEXT_AREA_START) continue;
-        int x1 = cx - w < 0 ? 0 : cx - w;
-        int x2 = cx + w >= SCREEN_WIDTH ? SCREEN_WIDTH - 1 : cx + w;
-        for (int x = x1; x <= x2; x++)
-            g_videoram[y * SCREEN_WIDTH + x] = c;
-    }
+    draw_circle(g_videoram, SCREEN_WIDTH, cx, cy, r, SCREEN_WIDTH, TEXT_AREA_START, c);
 }
 
 /* White directional arrow centred at (cx, cy) for the given track */
@@ -178,67 +155,39 @@ static void rg_draw_note(int track, int y_center, int is_large) {
     rg_arrow (x, y_center, track);
 }
 
-/* ── text helpers (uses g_font8x15 from func.c, same TU) ────────────────── */
-static void rg_putc(int x, int y, char c, uint32_t fg) {
-    unsigned char uc = (unsigned char)c;
-    if (uc < 32) return;
-    int idx = uc - 32;
-    if (idx >= 224) return;
-    for (int row = 0; row < 15; row++) {
-        int py = y + row;
-        if (py < 0 || py >= TEXT_AREA_START) continue;
-        uint8_t g = g_font8x15[idx][row];
-        for (int bit = 0; bit < 8; bit++) {
-            int px = x + bit;
-            if (px < 0 || px >= SCREEN_WIDTH) continue;
-            if (g & (0x80 >> bit))
-                g_videoram[py * SCREEN_WIDTH + px] = fg;
+/* ── text helpers (glyph cache from func.c, same TU) ───────────────────── */
+/* String with a 1px black outline, one blit per glyph */
+static void rg_puts_outlined(int x, int y, const char *s, uint32_t fg) {
+    const uint8_t *prev = NULL;
+    for (; *s; s++, x += 8) {
+        unsigned char uc = (unsigned char)*s;
+        if (uc < 32) {
+            prev = NULL;
+            continue;
         }
+        const uint8_t *cls = &g_glyphOutlined[uc - 32][0][0];
+        GlyphBlitOutlined(cls, GLYPH_CELL_W, GLYPH_CELL_H, x - 1, y - 1, fg, prev);
+        prev = cls;
     }
 }
 
-static void rg_puts(int x, int y, const char *s, uint32_t fg) {
-    while (*s) { rg_putc(x, y, *s++, fg); x += 8; }
-}
-
-static void rg_puts_outlined(int x, int y, const char *s, uint32_t fg) {
-    int dx, dy;
-    for (dy = -1; dy <= 1; dy++)
-        for (dx = -1; dx <= 1; dx++)
-            if (dx != 0 || dy != 0)
-                rg_puts(x + dx, y + dy, s, COLOR_BLACK);
-    rg_puts(x, y, s, fg);
-}
-
-/* Draw a single character scaled up (each font pixel → scale×scale block) */
-static void rg_putc_big(int x, int y, char c, int scale, uint32_t fg) {
+/* Single character scaled up (each font pixel → scale×scale block), outlined */
+static void rg_putc_big_outlined(int x, int y, char c, int scale, uint32_t fg) {
     unsigned char uc = (unsigned char)c;
     if (uc < 32) return;
-    int idx = uc - 32;
-    if (idx >= 224) return;
-    for (int row = 0; row < 15; row++) {
-        uint8_t g = g_font8x15[idx][row];
-        for (int bit = 0; bit < 8; bit++) {
-            if (g & (0x80 >> bit))
-                rg_rect(x + bit*scale, y + row*scale, scale, scale, fg);
-        }
-    }
-}
-static void rg_putc_big_outlined(int x, int y, char c, int scale, uint32_t fg) {
-    int dx, dy;
-    for (dy = -1; dy <= 1; dy++)
-        for (dx = -1; dx <= 1; dx++)
-            if (dx != 0 || dy != 0)
-                rg_putc_big(x + dx, y + dy, c, scale, COLOR_BLACK);
-    rg_putc_big(x, y, c, scale, fg);
+    const ScaledGlyph *g = glyph_scaled(uc - 32, scale);
+    if (g) GlyphBlitOutlined(g->cls, g->w, g->h, x - 1, y - 1, fg, NULL);
 }
 
 /* ── beatmap loader ──────────────────────────────────────────────────────── */
 /* stride: keep every Nth note (1 = all, 2 = every other, matching Ren'Py default) */
 static int rg_load_beatmap(const char *path, RhythmGame *gm, int stride) {
-    FILE *fp = fopen(path, "r");
+    char localpath[260];
+    FILE *fp = NULL;
     int n = 0, kept = 0, idx = 0, i = 0;
     char line[64];
+    if (AssetLocalPath(path, localpath, sizeof(localpath)) == 0)
+        fp = fopen(localpath, "r");
     if (!fp) return -1;
     if (stride < 1) stride = 1;
     while (fgets(line, sizeof line, fp))
@@ -313,10 +262,11 @@ static int rg_init(const char *bg, const char *audio, const char *bmap, int stri
         }
     }
 
-    /* Resolve audio path */
-    char fullpath[260];
-    if (GetFullPathNameA(audio, 260, fullpath, NULL) == 0) {
-        strncpy(fullpath, audio, 259); fullpath[259] = '\0';
+    /* Resolve audio path, extracting it from data.w3p if packed */
+    char fullpath[260], localpath[260];
+    if (AssetLocalPath(audio, localpath, sizeof(localpath)) != 0) localpath[0] = '\0';
+    if (GetFullPathNameA(localpath, 260, fullpath, NULL) == 0) {
+        strncpy(fullpath, localpath, 259); fullpath[259] = '\0';
     }
     if (GetFileAttributesA(fullpath) == INVALID_FILE_ATTRIBUTES) {
         free(gm->onset_times); free(gm->track_indices); free(gm->hit_status);
@@ -451,8 +401,7 @@ static void rg_render(RhythmGame *gm) {
     if (gm->bg_pixels)
         memcpy(g_videoram, gm->bg_pixels, IMAGE_AREA_PIXELS * sizeof(uint32_t));
     else
-        for (int i = 0; i < IMAGE_AREA_PIXELS; i++)
-            g_videoram[i] = COLOR_BLACK;
+        draw_fill(g_videoram, COLOR_BLACK, IMAGE_AREA_PIXELS);
 
     /* Countdown: large white digit centred on screen, with 1px black outline */
     if (gm->countdown > 0) {
@@ -595,10 +544,8 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
                             mciSendCommand(gm.mci_device_id, MCI_STATUS, MCI_STATUS_ITEM, (DWORD)(LPVOID)&sp);
                             pause_pos = sp.dwReturn;
                         }
-                        /* Show quit dialog (use temp buffer to avoid corrupting g_background) */
+                        /* Show quit dialog on the overlay, the game screen stays untouched */
                         g_effectrunning = 0;
-                        uint32_t *qsave = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
-                        if (qsave) memcpy(qsave, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
                         DispQuit();
                         int qn = read_keyboard_status();
                         while ((qn != 9 && qn != 10 && qn != 11) && g_running) {
@@ -609,7 +556,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
                         if (qn == 10) {
                             quit = 1; gm.has_ended = 1;
                         }
-                        if (qsave) { memcpy(g_videoram, qsave, IMAGE_AREA_PIXELS * sizeof(uint32_t)); free(qsave); }
+                        OverlayClose();
                         update_display();
                         g_effectrunning = 1;
                         if (!quit) {
@@ -745,6 +692,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
                         if (lines[j][0] != '\0')
                             fprintf(fp, "%s\n", lines[j]);
                     fclose(fp);
+                    AssetIndexUpdate(RGSCORE_FILE);
                 }
             }
         }
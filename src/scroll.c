@@ -0,0 +1,187 @@
+/*
+ *      Scrolling backgrounds for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Pans the view over a W3M tiled background ('O' lines). Loading one
+ *      with 'I' shows its top-left corner. Tiles are decoded when they
+ *      first come into view and dropped once they are more than a tile
+ *      away from it. A pan step shifts the background plane by the
+ *      distance moved and only draws the newly exposed strips from the
+ *      tiles, at the pace of the clock like the transitions.
+ */
+
+/* Included into w3vn.c after func.c */
+
+#define SCROLL_FRAME_MS 15
+
+typedef struct {
+    char path[260];             /* empty when no map is open */
+    AssetBlob blob;
+    W3mInfo info;
+    uint32_t **tiles;           /* decoded tiles, NULL until in view */
+    int x, y;                   /* top-left of the view in the map */
+} ScrollMap;
+
+static ScrollMap g_scroll;
+
+static void ScrollClose(void) {
+    if (g_scroll.tiles) {
+        for (int i = 0; i < g_scroll.info.cols * g_scroll.info.rows; i++) free(g_scroll.tiles[i]);
+        free(g_scroll.tiles);
+    }
+    AssetFreeBlob(&g_scroll.blob);
+    memset(&g_scroll, 0, sizeof(g_scroll));
+}
+
+/* Open the map at 'path', the background showing its top-left view */
+static int scroll_open(const char *path) {
+    if (g_scroll.path[0] && strcmp(g_scroll.path, path) == 0) return 0;
+    ScrollClose();
+    if (AssetReadAll(path, &g_scroll.blob) != 0) return -1;
+    if (w3m_info(g_scroll.blob.data, g_scroll.blob.size, &g_scroll.info) != 0) {
+        ScrollClose();
+        return -1;
+    }
+    g_scroll.tiles = (uint32_t **)calloc(g_scroll.info.cols * g_scroll.info.rows, sizeof(uint32_t *));
+    if (!g_scroll.tiles) {
+        ScrollClose();
+        return -1;
+    }
+    snprintf(g_scroll.path, sizeof(g_scroll.path), "%s", path);
+    return 0;
+}
+
+/* A background was (re)loaded: it shows the top-left view of 'path' */
+static void ScrollLoaded(const char *path) {
+    if (g_scroll.path[0] && strcmp(g_scroll.path, path) != 0) ScrollClose();
+    g_scroll.x = 0;
+    g_scroll.y = 0;
+}
+
+/* Whether the background shows the view at x, y of 'path' */
+static int ScrollAt(const char *path, int x, int y) {
+    if (!g_scroll.path[0] || strcmp(g_scroll.path, path) != 0) return x == 0 && y == 0;
+    return g_scroll.x == x && g_scroll.y == y;
+}
+
+/* Decoded tile, NULL if out of memory. Bad tiles come out white */
+static const uint32_t *scroll_tile(int index) {
+    if (!g_scroll.tiles[index]) {
+        int size = g_scroll.info.tile * g_scroll.info.tile;
+        uint32_t *tile = (uint32_t *)malloc(size * sizeof(uint32_t));
+        if (!tile) return NULL;
+        if (w3m_decode_tile(g_scroll.blob.data, &g_scroll.info, index, tile, g_scroll.info.tile) != 0) {
+            draw_fill(tile, COLOR_WHITE, size);
+        }
+        g_scroll.tiles[index] = tile;
+    }
+    return g_scroll.tiles[index];
+}
+
+/* Draw the view rectangle sx, sy, w, h of the background from the tiles */
+static void scroll_draw(int sx, int sy, int w, int h) {
+    int x = g_scroll.x + sx, y = g_scroll.y + sy, size = g_scroll.info.tile;
+    if (w <= 0 || h <= 0) return;
+    for (int row = y / size; row <= (y + h - 1) / size; row++) {
+        for (int col = x / size; col <= (x + w - 1) / size; col++) {
+            int index = row * g_scroll.info.cols + col;
+            const uint32_t *tile = scroll_tile(index);
+            if (tile) {
+                w3m_copy_tile(tile, &g_scroll.info, index, x, y, w, h,
+                              g_background + sy * SCREEN_WIDTH + sx, SCREEN_WIDTH);
+            }
+        }
+    }
+}
+
+/* Drop the tiles more than a tile away from the view */
+static void scroll_evict(void) {
+    int size = g_scroll.info.tile;
+    int c0 = (g_scroll.x - size) / size, c1 = (g_scroll.x + SCREEN_WIDTH + size) / size;
+    int r0 = (g_scroll.y - size) / size, r1 = (g_scroll.y + TEXT_AREA_START + size) / size;
+    for (int row = 0; row < g_scroll.info.rows; row++) {
+        for (int col = 0; col < g_scroll.info.cols; col++) {
+            uint32_t **tile = &g_scroll.tiles[row * g_scroll.info.cols + col];
+            if (*tile && (col < c0 || col > c1 || row < r0 || row > r1)) {
+                free(*tile);
+                *tile = NULL;
+            }
+        }
+    }
+}
+
+/* Move the view to x, y: shift what stays in view, draw what comes in */
+static void scroll_move(int x, int y) {
+    int vw = g_scroll.info.width < SCREEN_WIDTH ? g_scroll.info.width : SCREEN_WIDTH;
+    int vh = g_scroll.info.height < TEXT_AREA_START ? g_scroll.info.height : TEXT_AREA_START;
+    int dx = x - g_scroll.x, dy = y - g_scroll.y;
+    if (dx == 0 && dy == 0) return;
+    g_scroll.x = x;
+    g_scroll.y = y;
+
+    if (dx >= vw || -dx >= vw || dy >= vh || -dy >= vh) {
+        scroll_draw(0, 0, vw, vh);
+    } else {
+        /* Rows that stay, walked so none is overwritten before it moves */
+        int x0 = dx < 0 ? -dx : 0, w = vw - (dx < 0 ? -dx : dx);
+        int y0 = dy < 0 ? -dy : 0, h = vh - (dy < 0 ? -dy : dy);
+        for (int i = 0; i < h; i++) {
+            int row = dy > 0 ? y0 + i : y0 + h - 1 - i;
+            memmove(g_background + row * SCREEN_WIDTH + x0,
+                    g_background + (row + dy) * SCREEN_WIDTH + x0 + dx, w * sizeof(uint32_t));
+        }
+        if (dx > 0) scroll_draw(vw - dx, y0, dx, h);
+        if (dx < 0) scroll_draw(0, y0, -dx, h);
+        if (dy > 0) scroll_draw(0, vh - dy, vw, dy);
+        if (dy < 0) scroll_draw(0, 0, vw, -dy);
+    }
+    scroll_evict();
+}
+
+/* Keep the view inside the map */
+static void scroll_clamp(int *x, int *y) {
+    int maxx = g_scroll.info.width - SCREEN_WIDTH, maxy = g_scroll.info.height - TEXT_AREA_START;
+    if (*x > maxx) *x = maxx;
+    if (*y > maxy) *y = maxy;
+    if (*x < 0) *x = 0;
+    if (*y < 0) *y = 0;
+}
+
+/* Background to the screen, sprites back on top */
+static void scroll_show(void) {
+    memcpy(g_videoram, g_background, IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    for (int i = 0; i < currentsprites.count; i++) {
+        DrawSprite(&currentsprites.items[i]);
+    }
+    update_display();
+}
+
+/* Set the background to the view at x, y of 'path' without showing it */
+static void ScrollJump(const char *path, int x, int y) {
+    if (scroll_open(path) != 0) return;
+    scroll_clamp(&x, &y);
+    scroll_move(x, y);
+}
+
+/* Pan the view to x, y of 'path' in 'duration' ms, straight and at an even
+ * pace. A key press or a click ends it at the destination */
+static void ScrollPan(const char *path, int x, int y, DWORD duration) {
+    if (scroll_open(path) != 0) return;
+    scroll_clamp(&x, &y);
+
+    int x0 = g_scroll.x, y0 = g_scroll.y;
+    DWORD start = timeGetTime();
+    int frame = 0;
+    while (g_running) {
+        DWORD elapsed = timeGetTime() - start;
+        int done = g_effectskip || elapsed >= duration;
+        int nx = done ? x : x0 + (int)((long)(x - x0) * (long)elapsed / (long)duration);
+        int ny = done ? y : y0 + (int)((long)(y - y0) * (long)elapsed / (long)duration);
+        if (nx != g_scroll.x || ny != g_scroll.y) {
+            scroll_move(nx, ny);
+            scroll_show();
+        }
+        if (done) break;
+        FxDelayUntil(start + (DWORD)(++frame * SCROLL_FRAME_MS));
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ *      Screen transitions for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      The stock wipes and circles ('X' 01-40) and rule image wipes ('X97')
+ *      share one player. The threshold map (see w3t.h) is split into runs
+ *      once, then every frame fills the runs the clock went past since the
+ *      previous frame, so a slow machine drops frames instead of slowing the
+ *      transition down. Fades and crossfades ('X96' to 'X99') mix two images
+ *      with LerpSpan() at the same pace, the new image being decoded before
+ *      they start. A key press or a click finishes any of them at once.
+ */
+
+/* Included into w3vn.c after func.c */
+
+#include "w3t.h"
+
+#define TRANS_FRAME_MS 15
+#define TRANS_FADE_MS  1000
+
+/* Cover the image area with 'color' following a threshold map */
+static void FxPlayMap(const uint8_t *map, uint32_t color, DWORD duration) {
+    W3tPlan plan;
+    if (w3t_plan(map, SCREEN_WIDTH, TEXT_AREA_START, &plan) != 0) return;
+
+    DWORD start = timeGetTime();
+    int done = 0;
+    int frame = 0;
+    while (g_running) {
+        int level = g_effectskip ? W3T_LEVELS : w3t_level(timeGetTime() - start, duration);
+        if (level > done) {
+            w3t_fill(&plan, done, level, g_videoram, color);
+            done = level;
+            update_display();
+        }
+        if (done == W3T_LEVELS) break;
+        FxDelayUntil(start + (DWORD)(++frame * TRANS_FRAME_MS));
+    }
+    free(plan.runs);
+}
+
+/* Stock transition, W3T_VWIPE_DOWN to W3T_CIRCLE_IN */
+static void FxWipe(int kind, uint32_t color) {
+    uint8_t *map = (uint8_t *)malloc(IMAGE_AREA_PIXELS);
+    if (!map) return;
+    if (w3t_build(kind, map, SCREEN_WIDTH, TEXT_AREA_START) == 0) {
+        FxPlayMap(map, color, w3t_stock_ms[kind]);
+    }
+    free(map);
+}
+
+/* Wipe following a grayscale rule image, loaded like a background. If it
+ * can't be loaded the area is just filled, to end on the same screen. */
+static void FxRuleWipe(const char *filename, uint32_t color, DWORD duration) {
+    uint32_t *rule = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    uint8_t *map = (uint8_t *)malloc(IMAGE_AREA_PIXELS);
+    uint8_t palette[32];
+
+    if (rule && map && LoadBackgroundImage(filename, palette, rule) == 0) {
+        w3t_from_image(rule, map, IMAGE_AREA_PIXELS);
+        free(rule);
+        rule = NULL;
+        FxPlayMap(map, color, duration);
+    } else {
+        draw_fill(g_videoram, color, IMAGE_AREA_PIXELS);
+        update_display();
+    }
+    free(rule);
+    free(map);
+}
+
+/* Mix the image area from 'from' to 'to' over 'duration' ms, ending on 'to' */
+static void FxCrossfade(const uint32_t *from, const uint32_t *to, DWORD duration) {
+    DWORD start = timeGetTime();
+    int done = 0;
+    int frame = 0;
+    while (g_running) {
+        int level = g_effectskip ? W3T_LEVELS : w3t_level(timeGetTime() - start, duration);
+        if (level > done) {
+            LerpSpan(g_videoram, from, to, IMAGE_AREA_PIXELS, level);
+            done = level;
+            update_display();
+        }
+        if (done == W3T_LEVELS) break;
+        FxDelayUntil(start + (DWORD)(++frame * TRANS_FRAME_MS));
+    }
+}
+
+/* Decode an image for a fade, NULL on failure */
+static uint32_t *fade_target(const char *filename) {
+    uint8_t palette[32];
+    uint32_t *image = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    if (image && LoadBackgroundImage(filename, palette, image) != 0) {
+        free(image);
+        image = NULL;
+    }
+    return image;
+}
+
+/* Black image area, for fades from and to black */
+static uint32_t *fade_black(void) {
+    uint32_t *black = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    if (black) draw_fill(black, COLOR_BLACK, IMAGE_AREA_PIXELS);
+    return black;
+}
+
+/* Fade the image area to black */
+static void FxFadeOut(void) {
+    uint32_t *original = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    uint32_t *black = fade_black();
+    if (original && black) {
+        memcpy(original, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
+        FxCrossfade(original, black, TRANS_FADE_MS);
+    }
+    free(black);
+    free(original);
+}
+
+/* Fade from black to an image */
+static void FxFadeIn(const char *filename) {
+    uint32_t *image = fade_target(filename);
+    uint32_t *black = fade_black();
+    if (image && black) {
+        memcpy(g_videoram, black, IMAGE_AREA_PIXELS * sizeof(uint32_t));
+        update_display();
+        FxCrossfade(black, image, TRANS_FADE_MS);
+    }
+    free(black);
+    free(image);
+}
+
+/* Crossfade from the image area on screen to an image */
+static void FxDissolve(const char *filename) {
+    uint32_t *image = fade_target(filename);
+    uint32_t *original = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
+    if (image && original) {
+        memcpy(original, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
+        FxCrossfade(original, image, TRANS_FADE_MS);
+    }
+    free(original);
+    free(image);
+}
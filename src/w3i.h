@@ -0,0 +1,137 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      .w3i lossless image layout and decoder, shared by the engine and
+ *      w3iconv. All integers are little-endian.
+ *
+ *      header  "W3I1", u16 width, u16 height, u8 flags, u8 0, u16 0,
+ *              u32 color_size
+ *      color   color_size bytes of QOI-style ops over the BGR pixels:
+ *                00iiiiii                    index into the 64 recent colors
+ *                01rrggbb                    r/g/b delta, -2..1
+ *                10gggggg rrrrbbbb           g delta -32..31, r/b relative to it -8..7
+ *                11nnnnnn                    repeat previous pixel n+1 times (1..62)
+ *                11111110 b g r              literal pixel
+ *              The recent colors table is hashed on (r*3 + g*5 + b*7) & 63.
+ *      alpha   only with W3I_ALPHA: RLE of the width*height alpha bytes,
+ *                0nnnnnnn ...                n+1 literal bytes
+ *                1nnnnnnn a                  byte a repeated n+3 times
+ *
+ *      Pixels are decoded straight to 0xAARRGGBB, the DIB layout.
+ */
+
+#ifndef W3I_H
+#define W3I_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define W3I_MAGIC        "W3I1"
+#define W3I_HEADER_SIZE  16
+
+/* Header flags */
+#define W3I_ALPHA        1      /* alpha plane follows the colors */
+#define W3I_LEGACY       2      /* converted STVN sprite, keeps its clipping */
+
+#define W3I_OP_INDEX     0x00
+#define W3I_OP_DIFF      0x40
+#define W3I_OP_LUMA      0x80
+#define W3I_OP_RUN       0xc0
+#define W3I_OP_RGB       0xfe
+#define W3I_MASK         0xc0
+
+#define W3I_HASH(c) ((((c) >> 16 & 0xff) * 3 + ((c) >> 8 & 0xff) * 5 + ((c) & 0xff) * 7) & 63)
+
+/* Read the header, returns 0 when valid */
+static inline int w3i_info(const uint8_t *data, uint32_t size, int *width, int *height, int *flags) {
+    if (size < W3I_HEADER_SIZE || memcmp(data, W3I_MAGIC, 4) != 0) return -1;
+    *width = data[4] | (data[5] << 8);
+    *height = data[6] | (data[7] << 8);
+    *flags = data[8];
+    uint32_t color_size = data[12] | (data[13] << 8) | (data[14] << 16) | ((uint32_t)data[15] << 24);
+    if (*width == 0 || *height == 0 || color_size > size - W3I_HEADER_SIZE) return -1;
+    return 0;
+}
+
+/* Decode into pixels (rows 'stride' pixels apart), keeping only the top-left
+ * clip_w x clip_h part. Without an alpha plane pixels are opaque. */
+static inline int w3i_decode(const uint8_t *data, uint32_t size, uint32_t *pixels, int stride,
+                      int clip_w, int clip_h) {
+    uint32_t recent[64];
+    uint32_t px = 0xff000000;
+    int width, height, flags, run = 0;
+
+    if (w3i_info(data, size, &width, &height, &flags) != 0) return -1;
+    uint32_t color_size = data[12] | (data[13] << 8) | (data[14] << 16) | ((uint32_t)data[15] << 24);
+    const uint8_t *p = data + W3I_HEADER_SIZE;
+    const uint8_t *end = p + color_size;
+    if (clip_w > width) clip_w = width;
+    if (clip_h > height) clip_h = height;
+    memset(recent, 0, sizeof(recent));
+
+    for (int y = 0; y < clip_h; y++) {
+        uint32_t *row = pixels + (size_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            if (run > 0) {
+                run--;
+            } else {
+                if (p >= end) return -1;
+                int op = *p++;
+                if (op == W3I_OP_RGB) {
+                    if (end - p < 3) return -1;
+                    px = 0xff000000 | (p[2] << 16) | (p[1] << 8) | p[0];
+                    p += 3;
+                } else if ((op & W3I_MASK) == W3I_OP_INDEX) {
+                    px = recent[op];
+                } else if ((op & W3I_MASK) == W3I_OP_DIFF) {
+                    int r = ((px >> 16) + ((op >> 4) & 3) - 2) & 0xff;
+                    int g = ((px >> 8) + ((op >> 2) & 3) - 2) & 0xff;
+                    int b = (px + (op & 3) - 2) & 0xff;
+                    px = 0xff000000 | (r << 16) | (g << 8) | b;
+                } else if ((op & W3I_MASK) == W3I_OP_LUMA) {
+                    if (p >= end) return -1;
+                    int dg = (op & 0x3f) - 32;
+                    int r = ((px >> 16) + dg - 8 + (*p >> 4)) & 0xff;
+                    int g = ((px >> 8) + dg) & 0xff;
+                    int b = (px + dg - 8 + (*p & 0x0f)) & 0xff;
+                    p++;
+                    px = 0xff000000 | (r << 16) | (g << 8) | b;
+                } else {
+                    run = op & 0x3f;
+                }
+                recent[W3I_HASH(px)] = px;
+            }
+            if (x < clip_w) row[x] = px;
+        }
+    }
+
+    if (!(flags & W3I_ALPHA)) return 0;
+
+    /* Alpha plane, only its first clip_h rows are needed */
+    p = data + W3I_HEADER_SIZE + color_size;
+    end = data + size;
+    int x = 0, y = 0;
+    while (y < clip_h) {
+        if (p >= end) return -1;
+        int op = *p++;
+        int count = (op & 0x80) ? (op & 0x7f) + 3 : op + 1;
+        int literal = !(op & 0x80);
+        if (end - p < (literal ? count : 1)) return -1;
+        for (int i = 0; i < count && y < clip_h; i++) {
+            uint32_t a = literal ? p[i] : p[0];
+            if (x < clip_w) {
+                uint32_t *dst = pixels + (size_t)y * stride + x;
+                *dst = (*dst & 0x00ffffff) | (a << 24);
+            }
+            if (++x == width) {
+                x = 0;
+                y++;
+            }
+        }
+        p += literal ? count : 1;
+    }
+    return 0;
+}
+
+#endif /* W3I_H */
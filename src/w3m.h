@@ -0,0 +1,115 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      .w3m tiled background layout, shared by the engine and w3iconv. A
+ *      picture larger than the image area is cut into square tiles, each
+ *      one a W3I image of its own, so that only the tiles in view have to
+ *      be decoded. All integers are little-endian.
+ *
+ *      header  "W3M1", u16 width, u16 height, u16 tile, u16 cols,
+ *              u16 rows, u16 0
+ *      index   cols * rows entries of u32 offset, u32 size, row by row,
+ *              offsets from the start of the file
+ *      tiles   W3I images, tile x tile pixels, less on the last column
+ *              and row
+ */
+
+#ifndef W3M_H
+#define W3M_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "w3i.h"
+
+#define W3M_MAGIC        "W3M1"
+#define W3M_HEADER_SIZE  16
+#define W3M_ENTRY_SIZE   8
+#define W3M_TILE         64     /* default tile size */
+
+typedef struct {
+    int width, height;
+    int tile, cols, rows;
+} W3mInfo;
+
+static inline uint32_t w3m_get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Read the header and check the index, returns 0 when valid */
+static inline int w3m_info(const uint8_t *data, uint32_t size, W3mInfo *info) {
+    if (size < W3M_HEADER_SIZE || memcmp(data, W3M_MAGIC, 4) != 0) return -1;
+    info->width = data[4] | (data[5] << 8);
+    info->height = data[6] | (data[7] << 8);
+    info->tile = data[8] | (data[9] << 8);
+    info->cols = data[10] | (data[11] << 8);
+    info->rows = data[12] | (data[13] << 8);
+    if (info->width == 0 || info->height == 0 || info->tile == 0 ||
+        info->cols != (info->width + info->tile - 1) / info->tile ||
+        info->rows != (info->height + info->tile - 1) / info->tile) return -1;
+
+    uint32_t count = (uint32_t)info->cols * info->rows;
+    if (count > (size - W3M_HEADER_SIZE) / W3M_ENTRY_SIZE) return -1;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *e = data + W3M_HEADER_SIZE + i * W3M_ENTRY_SIZE;
+        uint32_t offset = w3m_get32(e), len = w3m_get32(e + 4);
+        if (offset > size || len > size - offset) return -1;
+    }
+    return 0;
+}
+
+/* Size of tile column 'col' (or row), the last one may be cut short */
+static inline int w3m_span(int total, int tile, int index) {
+    int left = total - index * tile;
+    return left < tile ? left : tile;
+}
+
+/* Decode tile 'index' into pixels 'stride' apart, returns 0 when valid */
+static inline int w3m_decode_tile(const uint8_t *data, const W3mInfo *info, int index,
+                           uint32_t *pixels, int stride) {
+    const uint8_t *e = data + W3M_HEADER_SIZE + index * W3M_ENTRY_SIZE;
+    const uint8_t *tile = data + w3m_get32(e);
+    uint32_t size = w3m_get32(e + 4);
+    int w, h, flags;
+    if (w3i_info(tile, size, &w, &h, &flags) != 0) return -1;
+    if (w != w3m_span(info->width, info->tile, index % info->cols) ||
+        h != w3m_span(info->height, info->tile, index / info->cols)) return -1;
+    return w3i_decode(tile, size, pixels, stride, w, h);
+}
+
+/* Copy the part of decoded tile 'index' inside the map rectangle x, y, w, h
+ * to 'dst', which holds that rectangle with rows 'stride' pixels apart */
+static inline void w3m_copy_tile(const uint32_t *tile, const W3mInfo *info, int index,
+                          int x, int y, int w, int h, uint32_t *dst, int stride) {
+    int tx = (index % info->cols) * info->tile, ty = (index / info->cols) * info->tile;
+    int tw = w3m_span(info->width, info->tile, index % info->cols);
+    int th = w3m_span(info->height, info->tile, index / info->cols);
+    int x0 = tx > x ? tx : x, x1 = tx + tw < x + w ? tx + tw : x + w;
+    int y0 = ty > y ? ty : y, y1 = ty + th < y + h ? ty + th : y + h;
+    for (int row = y0; row < y1; row++) {
+        memcpy(dst + (size_t)(row - y) * stride + (x0 - x),
+               tile + (size_t)(row - ty) * info->tile + (x0 - tx), (x1 - x0) * sizeof(uint32_t));
+    }
+}
+
+/* Decode the map rectangle x, y, w, h into 'dst', tile by tile, only the
+ * tiles it touches. The rectangle must lie inside the map */
+static inline int w3m_render(const uint8_t *data, const W3mInfo *info, int x, int y, int w, int h,
+                      uint32_t *dst, int stride) {
+    uint32_t *tile = (uint32_t *)malloc((size_t)info->tile * info->tile * sizeof(uint32_t));
+    int ret = 0;
+    if (!tile) return -1;
+    for (int row = y / info->tile; row <= (y + h - 1) / info->tile; row++) {
+        for (int col = x / info->tile; col <= (x + w - 1) / info->tile; col++) {
+            int index = row * info->cols + col;
+            if (w3m_decode_tile(data, info, index, tile, info->tile) != 0) ret = -1;
+            else w3m_copy_tile(tile, info, index, x, y, w, h, dst, stride);
+        }
+    }
+    free(tile);
+    return ret;
+}
+
+#endif /* W3M_H */
@@ -0,0 +1,74 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      .w3p packed asset archive layout, shared by the engine and w3pack.
+ *      All integers are little-endian.
+ *
+ *      header     "W3P1", u32 count, u32 dir_offset, u32 dir_size
+ *      data       entry payloads, stored or raw deflate
+ *      directory  'count' records sorted by name (strcmp order):
+ *                 u32 offset, u32 size, u32 rawsize, u32 crc32,
+ *                 u8 method, u8 format, u16 namelen, name
+ *
+ *      Names are relative to data\, lowercased, with backslashes.
+ */
+
+#ifndef W3P_H
+#define W3P_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define W3P_MAGIC        "W3P1"
+#define W3P_HEADER_SIZE  16
+#define W3P_RECORD_SIZE  20
+
+/* Entry compression */
+#define W3P_STORED       0
+#define W3P_DEFLATE      8
+
+/* Sniffed content format, same values as ASSET_FMT_* */
+#define W3P_FMT_RAW      0
+#define W3P_FMT_PNG      1
+#define W3P_FMT_GZIP     2
+#define W3P_FMT_W3I      3
+#define W3P_FMT_W3S      4
+#define W3P_FMT_ANI      5      /* "ANIM" text animation descriptor */
+#define W3P_FMT_W3M      6      /* tiled background */
+#define W3P_FMT_W3V      7      /* native animation */
+
+static inline uint32_t w3p_get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t w3p_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void w3p_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void w3p_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/* Content format from the first bytes of an entry */
+static inline int w3p_sniff(const uint8_t *data, uint32_t size) {
+    static const uint8_t png_sig[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (size >= 8 && memcmp(data, png_sig, 8) == 0) return W3P_FMT_PNG;
+    if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) return W3P_FMT_GZIP;
+    if (size >= 4 && memcmp(data, "W3I1", 4) == 0) return W3P_FMT_W3I;
+    if (size >= 4 && memcmp(data, "W3S1", 4) == 0) return W3P_FMT_W3S;
+    if (size >= 4 && memcmp(data, "ANIM", 4) == 0) return W3P_FMT_ANI;
+    if (size >= 4 && memcmp(data, "W3M1", 4) == 0) return W3P_FMT_W3M;
+    if (size >= 4 && memcmp(data, "W3V1", 4) == 0) return W3P_FMT_W3V;
+    return W3P_FMT_RAW;
+}
+
+#endif /* W3P_H */
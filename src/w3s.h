@@ -0,0 +1,78 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      .w3s run-length monochrome sprite layout, shared by the engine and
+ *      w3sconv. Integers are little-endian, 'v' numbers are LEB128 varints
+ *      (7 bits per byte, low bits first, high bit set on all but the last).
+ *
+ *      header  "W3S1", u16 width, u16 height, u8 flags, u8 0, u16 0
+ *      rows    'height' rows of: v span count, then per span
+ *                v skip        transparent pixels before the run
+ *                v length      opaque pixels in the run
+ *                bits          (length + 7) / 8 bytes, MSB first, 1 = black
+ *
+ *      This is the STVN sprite palette: opaque pixels are black or white.
+ */
+
+#ifndef W3S_H
+#define W3S_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define W3S_MAGIC        "W3S1"
+#define W3S_HEADER_SIZE  12
+
+/* Header flags */
+#define W3S_LEGACY       1      /* converted STVN sprite, keeps its clipping */
+
+/* Read a varint, 0 past 'end' (the caller checks with w3s_check first) */
+static inline uint32_t w3s_varint(const uint8_t **p, const uint8_t *end) {
+    uint32_t v = 0;
+    int shift = 0;
+    while (*p < end && shift < 32) {
+        uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+        shift += 7;
+    }
+    *p = end;
+    return 0;
+}
+
+static inline int w3s_info(const uint8_t *data, uint32_t size, int *width, int *height, int *flags) {
+    if (size < W3S_HEADER_SIZE || memcmp(data, W3S_MAGIC, 4) != 0) return -1;
+    *width = data[4] | (data[5] << 8);
+    *height = data[6] | (data[7] << 8);
+    *flags = data[8];
+    return 0;
+}
+
+/* Walk every row once, so the blitter can trust the spans. Returns the size
+ * of the row data, -1 if it overruns the file or the sprite width. */
+static inline long w3s_check(const uint8_t *data, uint32_t size) {
+    int width, height, flags;
+    if (w3s_info(data, size, &width, &height, &flags) != 0) return -1;
+
+    const uint8_t *p = data + W3S_HEADER_SIZE;
+    const uint8_t *end = data + size;
+    for (int y = 0; y < height; y++) {
+        if (p >= end) return -1;
+        uint32_t spans = w3s_varint(&p, end);
+        uint32_t x = 0;
+        while (spans-- > 0) {
+            if (p >= end) return -1;
+            uint32_t skip = w3s_varint(&p, end);
+            if (p >= end) return -1;
+            uint32_t len = w3s_varint(&p, end);
+            x += skip + len;
+            if (skip > (uint32_t)width || len > (uint32_t)width || x > (uint32_t)width) return -1;
+            if ((uint32_t)(end - p) < (len + 7) / 8) return -1;
+            p += (len + 7) / 8;
+        }
+    }
+    return (long)(p - (data + W3S_HEADER_SIZE));
+}
+
+#endif /* W3S_H */
@@ -0,0 +1,172 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      Transition threshold maps, shared by the engine and w3rule. A map
+ *      holds one byte per image area pixel: a pixel is covered once the
+ *      transition level (0-256, from the clock) goes past its byte. Maps are
+ *      built for the stock wipes and circles, or read from a grayscale rule
+ *      image, dark pixels first.
+ *
+ *      For playback a map is turned into runs of same-threshold pixels on a
+ *      row, sorted by threshold, so a frame only fills the runs crossed since
+ *      the previous one.
+ */
+
+#ifndef W3T_H
+#define W3T_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "draw.h"
+
+/* Stock transitions, in 'X' effect order */
+#define W3T_VWIPE_DOWN    0
+#define W3T_VWIPE_UP      1
+#define W3T_VWIPE_MIDIN   2
+#define W3T_VWIPE_MIDOUT  3
+#define W3T_HWIPE_RIGHT   4
+#define W3T_HWIPE_LEFT    5
+#define W3T_HWIPE_MIDIN   6
+#define W3T_HWIPE_MIDOUT  7
+#define W3T_CIRCLE_OUT    8
+#define W3T_CIRCLE_IN     9
+#define W3T_STOCK_COUNT   10
+
+#define W3T_LEVELS        256
+
+typedef struct {
+    uint32_t offset;    /* first pixel, y * width + x */
+    uint16_t len;
+    uint8_t level;      /* threshold */
+    uint8_t pad;
+} W3tRun;
+
+typedef struct {
+    W3tRun *runs;
+    uint32_t start[W3T_LEVELS + 1];     /* first run of each threshold */
+} W3tPlan;
+
+/* Duration in ms of each stock transition, the pace of the old fixed steps */
+static const uint16_t w3t_stock_ms[W3T_STOCK_COUNT] = {
+    600, 600, 300, 300, 300, 300, 150, 150, 320, 320
+};
+
+/* Threshold of step 'i' out of 'n' */
+static inline uint8_t w3t_step(int i, int n) {
+    return (uint8_t)(i * W3T_LEVELS / n);
+}
+
+/* Smallest r with r * r >= v */
+static inline int w3t_isqrt_up(int v) {
+    int r = 0;
+    while (r * r < v) r++;
+    return r;
+}
+
+/* Build a stock map for a width x height image area. The bands and blocks
+ * are the ones the fixed-step effects used: 8-row bands, 32-column bands
+ * and 16x32 blocks for the circles. */
+static inline int w3t_build(int kind, uint8_t *map, int width, int height) {
+    int rows = (height + 7) / 8;
+    int cols = (width + 31) / 32;
+    int bw = (width + 15) / 16;
+    int bh = (height + 31) / 32;
+    int bcx = bw / 2, bcy = bh / 2;
+    int maxr = w3t_isqrt_up(bcx * bcx + 4 * bcy * bcy) + 1;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = map + (size_t)y * width;
+        int band = y / 8;
+        int mid = band < rows / 2 ? band : rows - 1 - band;
+        for (int x = 0; x < width; x++) {
+            int col = x / 32;
+            int half = x < width / 2 ? x : width - 1 - x;
+            int dx = x / 16 - bcx, dy = y / 32 - bcy;
+            int r = kind >= W3T_CIRCLE_OUT ? w3t_isqrt_up(dx * dx + 4 * dy * dy) : 0;
+            uint8_t t;
+            switch (kind) {
+                case W3T_VWIPE_DOWN:   t = w3t_step(band, rows); break;
+                case W3T_VWIPE_UP:     t = w3t_step(rows - 1 - band, rows); break;
+                case W3T_VWIPE_MIDIN:  t = w3t_step(mid, (rows + 1) / 2); break;
+                case W3T_VWIPE_MIDOUT: t = w3t_step((rows + 1) / 2 - 1 - mid, (rows + 1) / 2); break;
+                case W3T_HWIPE_RIGHT:  t = w3t_step(col, cols); break;
+                case W3T_HWIPE_LEFT:   t = w3t_step(cols - 1 - col, cols); break;
+                case W3T_HWIPE_MIDIN:  t = w3t_step(half / 32, (cols + 1) / 2); break;
+                case W3T_HWIPE_MIDOUT: t = w3t_step((cols + 1) / 2 - 1 - half / 32, (cols + 1) / 2); break;
+                case W3T_CIRCLE_OUT:   t = w3t_step(r, maxr); break;
+                case W3T_CIRCLE_IN:    t = w3t_step(maxr - 1 - r, maxr); break;
+                default: return -1;
+            }
+            row[x] = t;
+        }
+    }
+    return 0;
+}
+
+/* Rule image (0xAARRGGBB) to a map: luma, dark pixels go first */
+static inline void w3t_from_image(const uint32_t *px, uint8_t *map, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t c = px[i];
+        map[i] = (uint8_t)((((c >> 16) & 0xff) * 77 + ((c >> 8) & 0xff) * 150 + (c & 0xff) * 29) >> 8);
+    }
+}
+
+/* Split a map into runs, counting-sorted by threshold. 0 or -1 */
+static inline int w3t_plan(const uint8_t *map, int width, int height, W3tPlan *plan) {
+    uint32_t count = 0;
+    uint32_t pos[W3T_LEVELS];
+
+    memset(plan->start, 0, sizeof(plan->start));
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = map + (size_t)y * width;
+        for (int x = 0; x < width; ) {
+            int n = 1;
+            while (x + n < width && row[x + n] == row[x] && n < 0xffff) n++;
+            plan->start[row[x] + 1]++;
+            count++;
+            x += n;
+        }
+    }
+    for (int i = 0; i < W3T_LEVELS; i++) {
+        plan->start[i + 1] += plan->start[i];
+        pos[i] = plan->start[i];
+    }
+
+    plan->runs = (W3tRun *)malloc((count ? count : 1) * sizeof(W3tRun));
+    if (!plan->runs) return -1;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = map + (size_t)y * width;
+        for (int x = 0; x < width; ) {
+            int n = 1;
+            while (x + n < width && row[x + n] == row[x] && n < 0xffff) n++;
+            W3tRun *r = &plan->runs[pos[row[x]]++];
+            r->offset = (uint32_t)y * width + x;
+            r->len = (uint16_t)n;
+            r->level = row[x];
+            r->pad = 0;
+            x += n;
+        }
+    }
+    return 0;
+}
+
+/* Transition level after 'elapsed' of 'duration' ms (up to 65535), W3T_LEVELS when done */
+static inline int w3t_level(uint32_t elapsed, uint32_t duration) {
+    if (duration == 0 || elapsed >= duration) return W3T_LEVELS;
+    return (int)(elapsed * W3T_LEVELS / duration);
+}
+
+/* Fill the runs crossed going from level 'from' to 'to', returns pixels set */
+static inline uint32_t w3t_fill(const W3tPlan *plan, int from, int to, uint32_t *dst, uint32_t color) {
+    uint32_t touched = 0;
+    for (uint32_t i = plan->start[from]; i < plan->start[to]; i++) {
+        draw_fill(dst + plan->runs[i].offset, color, plan->runs[i].len);
+        touched += plan->runs[i].len;
+    }
+    return touched;
+}
+
+#endif /* W3T_H */
@@ -0,0 +1,140 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      .w3v animation layout, shared by the engine and w3vconv. The first
+ *      frame is a keyframe, the next ones only hold the rows and spans
+ *      that changed since the previous frame. Pixels are palette indices
+ *      when the animation has 256 colors or less, BGR triplets otherwise.
+ *      A frame may be raw-deflated when that makes it smaller. All integers
+ *      are little-endian.
+ *
+ *      header  "W3V1", u16 width, u16 height, u16 frames, u16 colors
+ *              (0: BGR pixels), u16 0, u16 0
+ *      palette colors entries of u32 0x00RRGGBB
+ *      index   frames entries of u32 offset, u32 size, u32 rawsize,
+ *              u16 delay in ms, u16 flags
+ *      frame   u16 first row, u16 rows, then for each row u16 spans and
+ *              the spans: u16 x, u16 length, then 'length' pixels, or a
+ *              single pixel repeated when bit 15 of the length is set
+ */
+
+#ifndef W3V_H
+#define W3V_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define W3V_MAGIC        "W3V1"
+#define W3V_HEADER_SIZE  16
+#define W3V_ENTRY_SIZE   16
+#define W3V_FILL         0x8000 /* span length flag: one repeated pixel */
+
+/* Frame flags */
+#define W3V_KEY          1      /* covers the whole frame */
+#define W3V_DEFLATED     2      /* payload is raw deflate */
+
+typedef struct {
+    int width, height, frames, colors;
+    uint32_t palette[256];      /* 0xFFRRGGBB */
+} W3vInfo;
+
+typedef struct {
+    const uint8_t *data;        /* inside the file */
+    uint32_t size, rawsize;
+    int delay, flags;
+} W3vFrame;
+
+static inline uint32_t w3v_get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int w3v_get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+/* Read the header, palette and index, returns 0 when valid */
+static inline int w3v_info(const uint8_t *data, uint32_t size, W3vInfo *info) {
+    if (size < W3V_HEADER_SIZE || memcmp(data, W3V_MAGIC, 4) != 0) return -1;
+    info->width = w3v_get16(data + 4);
+    info->height = w3v_get16(data + 6);
+    info->frames = w3v_get16(data + 8);
+    info->colors = w3v_get16(data + 10);
+    if (info->width == 0 || info->height == 0 || info->frames == 0 || info->colors > 256) return -1;
+
+    uint32_t index = W3V_HEADER_SIZE + info->colors * 4;
+    if (index > size || (uint32_t)info->frames > (size - index) / W3V_ENTRY_SIZE) return -1;
+    for (int i = 0; i < 256; i++) {
+        info->palette[i] = i < info->colors ? 0xff000000u | w3v_get32(data + W3V_HEADER_SIZE + i * 4) : 0xff000000u;
+    }
+    for (int i = 0; i < info->frames; i++) {
+        const uint8_t *e = data + index + i * W3V_ENTRY_SIZE;
+        uint32_t offset = w3v_get32(e), len = w3v_get32(e + 4);
+        if (offset > size || len > size - offset) return -1;
+    }
+    return 0;
+}
+
+static inline void w3v_frame(const uint8_t *data, const W3vInfo *info, int index, W3vFrame *frame) {
+    const uint8_t *e = data + W3V_HEADER_SIZE + info->colors * 4 + index * W3V_ENTRY_SIZE;
+    frame->data = data + w3v_get32(e);
+    frame->size = w3v_get32(e + 4);
+    frame->rawsize = w3v_get32(e + 8);
+    frame->delay = w3v_get16(e + 12);
+    frame->flags = w3v_get16(e + 14);
+}
+
+/* Apply an inflated frame to the previous one in 'dst', rows 'stride'
+ * pixels apart. 'rect' gets the changed area as x0, y0, x1, y1, empty when
+ * nothing changed. Returns 0 when valid, a bad frame stops where it fails */
+static inline int w3v_apply(const uint8_t *p, uint32_t size, const W3vInfo *info,
+                     uint32_t *dst, int stride, int rect[4]) {
+    const uint8_t *end = p + size;
+    int bpp = info->colors ? 1 : 3;
+    rect[0] = info->width;
+    rect[1] = info->height;
+    rect[2] = 0;
+    rect[3] = 0;
+    if (size < 4) return -1;
+    int y0 = w3v_get16(p), rows = w3v_get16(p + 2);
+    p += 4;
+    if (y0 + rows > info->height) return -1;
+
+    for (int y = y0; y < y0 + rows; y++) {
+        if (end - p < 2) return -1;
+        int spans = w3v_get16(p);
+        uint32_t *row = dst + (size_t)y * stride;
+        p += 2;
+        for (int s = 0; s < spans; s++) {
+            if (end - p < 4) return -1;
+            int x = w3v_get16(p), len = w3v_get16(p + 2);
+            int fill = len & W3V_FILL;
+            len &= ~W3V_FILL;
+            p += 4;
+            if (x + len > info->width || end - p < (fill ? bpp : bpp * len)) return -1;
+            if (len == 0) continue;
+
+            if (x < rect[0]) rect[0] = x;
+            if (x + len > rect[2]) rect[2] = x + len;
+            if (y < rect[1]) rect[1] = y;
+            if (y + 1 > rect[3]) rect[3] = y + 1;
+
+            if (fill) {
+                uint32_t c = bpp == 1 ? info->palette[*p] :
+                             0xff000000u | p[2] << 16 | p[1] << 8 | p[0];
+                for (int i = 0; i < len; i++) row[x + i] = c;
+                p += bpp;
+            } else if (bpp == 1) {
+                for (int i = 0; i < len; i++) row[x + i] = info->palette[p[i]];
+                p += len;
+            } else {
+                for (int i = 0; i < len; i++, p += 3) {
+                    row[x + i] = 0xff000000u | p[2] << 16 | p[1] << 8 | p[0];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+#endif /* W3V_H */
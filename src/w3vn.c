@@ -34,7 +34,10 @@ static volatile int g_windowactive = 1;
 static volatile int g_ignoreclick = 0;
 static volatile int g_ignorerclick = 0;
 static volatile int g_effectrunning = 0;
+static volatile int g_effectskip = 0;   /* key or click during an effect, finish it */
 static volatile int g_hq2x = 0;
+static int g_outputbits = 0;    /* 'B' line: 15, 16 or 32, 0 to follow the display */
+static int g_dither = 1;        /* ordered dither on 16-bit output */
 static char g_volumedevice[128] = "volume";
 static int g_origvolume = 100;
 
@@ -59,11 +62,22 @@ static HWND g_videoWindow = NULL;
 /* Function declarations */
 int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beatmap_path, int stride);
 
+#include "archive.c"
+#include "assetidx.c"
+#include "cache.c"
+#include "blend.c"
+#include "layers.c"
 #include "func.c"
+#include "trans.c"
+#include "scroll.c"
+#include "movie.c"
+#include "prefetch.c"
+#include "capture.c"
+#include "mixer.c"
 #include "rythm.c"
 #include "rgscore.c"
 
-/* Macros */
+/* Macros: copy the background plane into the scene, or the scene back into it */
 #define RestoreScreen() memcpy(g_videoram, g_background, IMAGE_AREA_PIXELS * sizeof(uint32_t))
 #define SaveScreen() memcpy(g_background, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t))
 
@@ -80,7 +94,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
     if (next != 2 && next != 9) {\
         HandleSaveFilename(next);\
         FILE *fd = fopen(savefile, "w");\
-        RestoreScreen();\
+        OverlayClose();\
         if (fd != NULL) {\
             int _err = 0;\
             _err |= fprintf(fd, "%06ld%d%d%d%d%d%d%d%d%d%d\n", savepointer,\
@@ -91,6 +105,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
                 _err |= fprintf(fd, "%d\n", savehistory[i]) < 0;\
             }\
             _err |= fclose(fd) != 0;\
+            AssetIndexUpdate(savefile);\
             if (_err) DispSaveError();\
         } else {\
             DispSaveError();\
@@ -111,6 +126,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
             if (remove(savefile) != 0) {\
                 DispEraseError();\
             }\
+            AssetIndexUpdate(savefile);\
         }\
     }\
 }
@@ -146,23 +162,28 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
 }
 
 #define DispEraseError() {\
-    RestoreScreen();\
+    const char *_msg = "Delete failed! Press Space...";\
+    OverlayClose();\
+    OverlayOpen(0, 0, (int)strlen(_msg) * 8, 15);\
     locate(0, 0);\
-    print_string("Delete failed! Press Space...");\
+    print_string(_msg);\
     update_display();\
     while (read_keyboard_status() != 1 && g_running) {\
         Sleep(5);\
     }\
+    OverlayClose();\
 }
 
 #define DispSaveError() {\
+    const char *_msg = "Save failed! Press Space...";\
+    OverlayOpen(0, 0, (int)strlen(_msg) * 8, 15);\
     locate(0, 0);\
-    print_string("Save failed! Press Space...");\
+    print_string(_msg);\
     update_display();\
     while (read_keyboard_status() != 1 && g_running) {\
         Sleep(5);\
     }\
-    RestoreScreen();\
+    OverlayClose();\
 }
 
 #define ResetEngine() {\
@@ -170,7 +191,6 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
     lineNumber = 0;\
     savepointer = 0;\
     willplaying = 0;\
-    spritecount = 0;\
     memset(musicfile, 0, sizeof(musicfile));\
     memset(oldmusicfile, 0, sizeof(oldmusicfile));\
     memset(picture, 0, sizeof(picture));\
@@ -192,6 +212,7 @@ int PlayRhythmGame(const char *bg_path, const char *audio_path, const char *beat
     clear_screen();\
     CloseMidiSfx();\
     CloseWavSfx();\
+    AssetIndexBuild();\
 }
 
 #define QuitMacro() {\
@@ -225,6 +246,8 @@ static void run(void) {
     char *line;
     char picture[260] = {0};
     char oldpicture[260] = {0};
+    char shownpicture[260] = {0};
+    int panx = 0, pany = 0;     /* 'O' view of the background, on replay */
     char musicfile[260] = {0};
     char oldmusicfile[260] = {0};
     char sayername[260] = {0};
@@ -252,7 +275,6 @@ static void run(void) {
     reset_cursprites();
     reset_prevsprites();
 
-    int spritecount = 0;
     char scriptfile[260] = "data\\stvn.vns";
 
     int restorevolume=0;
@@ -263,6 +285,10 @@ static void run(void) {
 
     clear_screen();
 
+    /* Index data\ once, existence and format checks use it from now on */
+    ArchiveOpen();
+    AssetIndexBuild();
+
     /* Parse config file */
     if (file_exists("stvn.ini") == 0) {
         config = fopen("stvn.ini", "r");
@@ -288,6 +314,13 @@ static void run(void) {
                 if (*line == 'R') {
                     if (strlen(line) > 1 && line[1] == '1') restorevolume=1;
                 }
+                if (*line == 'B') {
+                    if (strlen(line) >= 3) {
+                        g_outputbits = atoi(line + 1);
+                        if (g_outputbits != 15 && g_outputbits != 16 && g_outputbits != 32) g_outputbits = 0;
+                    }
+                    if (strlen(line) >= 4 && (line[3] == 'N' || line[3] == 'n')) g_dither = 0;
+                }
                 if (*line == 'V') {
                     if (strlen(line) >= 4) {
                         vol = atoi(line + 1);
@@ -303,6 +336,12 @@ static void run(void) {
                     strncpy(g_volumedevice, line + 1, sizeof(g_volumedevice) - 1);
                     g_volumedevice[sizeof(g_volumedevice) - 1] = '\0';
                 }
+                if (*line == 'L') {
+                    if (strlen(line) >= 4) {
+                        g_prefetchDepth = atoi(line + 1);
+                        if (g_prefetchDepth < 0) g_prefetchDepth = 0;
+                    }
+                }
                 if (*line == 'X') {
                     if (strlen(line) >= 4) {
                         g_sfxVolume = atoi(line + 1);
@@ -333,11 +372,16 @@ static void run(void) {
     }
 
     RestoreWindowSize();
+    Present16Init();
 
     /* Wine fix, avoid having the window almost out of screen */
     if(IsWine() && g_hq2x == 1) CenterWindow();
 
-    script = fopen(scriptfile, "r");
+    /* A script packed in data.w3p is read from a temp copy */
+    char localscript[260];
+    script = NULL;
+    if (AssetLocalPath(scriptfile, localscript, sizeof(localscript)) == 0)
+        script = fopen(localscript, "r");
     if (script == NULL) {
         clear_screen();
         locate(0, 0);
@@ -354,6 +398,10 @@ static void run(void) {
         return;
     }
 
+    PrefetchInit(localscript);
+    CaptureInit();
+    MixerInit();
+
     /* Main loop */
     while (g_running) {
         line = get_line(script);
@@ -361,50 +409,50 @@ static void run(void) {
         lineNumber++;
 
         if (strlen(line) > 0) {
+            /* Let queued text finish before anything else happens */
+            if (*line != 'T') TextRevealWait();
+
             /* Reset text delay when leaving a text block */
             if (*line != 'T' && *line != 'N') g_textskip = 0;
 
             /* 'W': Wait for input */
             if (*line == 'W') {
                 update_display();
+                PrefetchSchedule(lineNumber);
                 g_mouseclick = 0;  /* Clear any pending click */
                 next = read_keyboard_status();
                 while (next != 1 && !g_mouseclick && g_running) {
                     if (next == 2) {
-                        SaveScreen();
                         DispQuit();
                         QuitMacro();
                         next = 0;
-                        RestoreScreen();
+                        OverlayClose();
                         update_display();
                     }
 
                     /* Save */
                     if (next == 3) {
-                        SaveScreen();
                         DispLoadSave(1);
                         SaveMacro();
                         next = 0;
-                        RestoreScreen();
+                        OverlayClose();
                         update_display();
                     }
 
                     if (next == 8) {
-                        SaveScreen();
                         DispLoadSave(2);
                         DeleteMacro();
                         next = 0;
-                        RestoreScreen();
+                        OverlayClose();
                         update_display();
                     }
 
                     if (next == 9) {
-                        SaveScreen();
                         DispEsc();
                         EscMacro();
                         next = 0;
                         if (lineNumber == 0) break;
-                        RestoreScreen();
+                        OverlayClose();
                         update_display();
                     }
                     /* Back */
@@ -414,8 +462,8 @@ static void run(void) {
                         savehistory_idx--;
                         skipnexthistory = 1;
 
-                        memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
-                        locate(0, 337);
+                        ClearTextArea();
+                        locate(0, TEXT_LINE_Y);
                         RedrawBorder();
                         print_string(" Rolling back...");
                         update_display();
@@ -424,7 +472,6 @@ static void run(void) {
 
                     /* Help */
                     if (next == 6) {
-                        SaveScreen();
                         DispHelp();
                         while (next != 2 && next != 9 && g_running) {
                             if (next == 7) RestoreWindowSize();
@@ -432,7 +479,7 @@ static void run(void) {
                             Sleep(5);
                         }
                         next = 0;
-                        RestoreScreen();
+                        OverlayClose();
                         update_display();
                     }
 
@@ -441,7 +488,6 @@ static void run(void) {
 
                     /* Load */
                     if (next == 4) {
-                        SaveScreen();
                         DispLoadSave(0);
 
                         while (NoValidSaveChoice(next) && g_running) {
@@ -449,7 +495,7 @@ static void run(void) {
                             next = read_keyboard_status();
                             Sleep(5);
                         }
-                        RestoreScreen();
+                        OverlayClose();
 
                     lblloadsave:
                         if (next != 2 && next != 9) {
@@ -457,8 +503,8 @@ static void run(void) {
                             HandleSaveFilename(next);
 
                             if (file_exists(savefile) == 0) {
-                                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
-                                locate(0, 337);
+                                ClearTextArea();
+                                locate(0, TEXT_LINE_Y);
                                 print_string(" Loading...");
                                 RedrawBorder();
                                 update_display();
@@ -495,11 +541,11 @@ static void run(void) {
                                 skipnexthistory = 1;
 
                             seektoline:
+                                memcpy(shownpicture, picture, sizeof(shownpicture));
                                 rewind(script);
                                 lineNumber = 0;
                                 savepointer = 0;
                                 willplaying = 0;
-                                spritecount = 0;
                                 uint32_t bgcolor = COLOR_WHITE;
                                 int hist_ptr = 0;
                                 int replay_iter = 0;
@@ -519,10 +565,9 @@ static void run(void) {
                                     memset(oldmusicfile, 0, sizeof(oldmusicfile));
                                 }
 
-                                if (loadsave == 0) {
-                                    backup_spritearray();
-                                    reset_cursprites();
-                                }
+                                /* Remember what is on screen, to redraw only the difference */
+                                backup_spritearray();
+                                reset_cursprites();
 
                                 while (hist_ptr < savehistory_idx &&
                                        lineNumber != save_linenb) {
@@ -537,17 +582,26 @@ static void run(void) {
                                         memset(picture, 0, sizeof(picture));
                                         snprintf(picture, sizeof(picture), "data\\%.*s", filelen, line + 1);
                                         reset_cursprites();
-                                        spritecount = 0;
+                                        panx = pany = 0;
                                     }
 
                                     if (*line == 'R') {
                                         reset_cursprites();
-                                        spritecount = 0;
+                                        panx = pany = 0;
+                                    }
+
+                                    /* 'O' only moves the view, it is shown once at the end */
+                                    if (*line == 'O' && strlen(line) >= 13) {
+                                        char coord[5] = {0};
+                                        memcpy(coord, line + 1, 4);
+                                        panx = atoi(coord);
+                                        memcpy(coord, line + 5, 4);
+                                        pany = atoi(coord);
                                     }
 
                                     if (*line == 'X') {
                                         reset_cursprites();
-                                        spritecount = 0;
+                                        panx = pany = 0;
                                         if (strlen(line) >= 3) {
                                             char effect[3] = {0};
                                             memcpy(effect, line + 1, 2);
@@ -594,9 +648,10 @@ static void run(void) {
                                             if(effectnum == 38) bgcolor = COLOR_WHITE;
                                             if(effectnum == 39) bgcolor = COLOR_WHITE;
                                             if(effectnum == 40) bgcolor = COLOR_BLACK;
+                                            if(effectnum == 97) bgcolor = line[3] == 'W' ? COLOR_WHITE : COLOR_BLACK;
                                             if(effectnum == 98) bgcolor = COLOR_BLACK;
-                                            /* X99 loads a new background image, track it like 'I' */
-                                            if(effectnum == 99 && strlen(line) >= 4) {
+                                            /* X96 and X99 load a new background image, track it like 'I' */
+                                            if((effectnum == 96 || effectnum == 99) && strlen(line) >= 4) {
                                                 int filelen = (int)strlen(line) - 3;
                                                 if (filelen > 250) filelen = 250;
                                                 snprintf(picture, sizeof(picture), "data\\%.*s", filelen, line + 3);
@@ -605,29 +660,46 @@ static void run(void) {
                                     }
 
                                     if (*line == 'A') {
-                                        if (strlen(line) >= 8 && spritecount < 256) {
+                                        if (strlen(line) >= 8 && currentsprites.count < 256) {
                                             int filelen = (int)strlen(line) - 7;
                                             if (filelen > 250) filelen = 250;
-                                            memset(currentsprites[spritecount].file, 0, sizeof(currentsprites[spritecount].file));
-                                            memcpy(currentsprites[spritecount].file, line + 7, filelen);
+                                            snprintf(spritefile, sizeof(spritefile), "data\\%.*s", filelen, line + 7);
                                             memset(linex, 0, 4);
                                             memset(liney, 0, 4);
                                             memcpy(linex, line + 1, 3);
                                             memcpy(liney, line + 4, 3);
-                                            currentsprites[spritecount].x = atoi(linex);
-                                            currentsprites[spritecount].y = atoi(liney);
-                                            spritecount++;
+                                            push_sprite(spritefile, atoi(linex), atoi(liney), 0);
+                                        }
+                                    }
+
+                                    /* 'Y' starts an animation, replayed from its first frame.
+                                     * 'YS' stops them, nothing is drawn yet so no redraw. */
+                                    if (*line == 'Y') {
+                                        if (line[1] == 'S') {
+                                            if (strlen(line) > 2) {
+                                                snprintf(spritefile, sizeof(spritefile), "data\\%.*s", 250, line + 2);
+                                                StopAnimations(spritefile, 0);
+                                            } else {
+                                                StopAnimations(NULL, 0);
+                                            }
+                                        } else if (strlen(line) >= 8 && currentsprites.count < 256) {
+                                            int filelen = (int)strlen(line) - 7;
+                                            if (filelen > 250) filelen = 250;
+                                            snprintf(spritefile, sizeof(spritefile), "data\\%.*s", filelen, line + 7);
+                                            memset(linex, 0, 4);
+                                            memset(liney, 0, 4);
+                                            memcpy(linex, line + 1, 3);
+                                            memcpy(liney, line + 4, 3);
+                                            push_sprite(spritefile, atoi(linex), atoi(liney), 1);
                                         }
                                     }
 
                                     if (*line == 'M') {
                                         reset_cursprites();
-                                        spritecount = 0;
                                     }
 
                                     if (*line == 'G') {
                                         reset_cursprites();
-                                        spritecount = 0;
                                         if (strlen(line) >= 10 && line[1] == '0') {
                                             memset(musicfile, 0, sizeof(musicfile));
                                             willplaying = 0;
@@ -738,52 +810,41 @@ static void run(void) {
                                 /* Load background */
                                 int restored = 0;
                                 if (picture[0] == '\0') {
-                                    for (int _i = 0; _i < IMAGE_AREA_PIXELS; _i++) g_background[_i] = bgcolor;
+                                    draw_fill(g_background, bgcolor, IMAGE_AREA_PIXELS);
                                     memset(oldpicture, 0, sizeof(oldpicture));
                                     RestoreScreen();
                                     restored = 1;
-                                } else if (loadsave == 0) {
-                                    if (strcmp(picture, oldpicture) != 0) {
-                                        LoadBackgroundImage(picture, bgpalette, g_background);
-                                        memcpy(oldpicture, picture, sizeof(oldpicture));
-                                        RestoreScreen();
-                                        restored = 1;
-                                    } else {
-                                        if (compare_sprites() != 0) {
-                                            LoadBackgroundImage(picture, bgpalette, g_background);
-                                            memcpy(oldpicture, picture, sizeof(oldpicture));
-                                            RestoreScreen();
-                                            restored = 1;
-                                        } else if (spritecount == 0) {
-                                            RestoreScreen();
-                                        }
-                                        /* same picture, same sprites, spritecount > 0:
-                                         * g_videoram already shows the correct state */
-                                    }
-                                } else {
+                                } else if (strcmp(picture, oldpicture) != 0 || strcmp(shownpicture, oldpicture) != 0 ||
+                                           !ScrollAt(picture, panx, pany)) {
                                     LoadBackgroundImage(picture, bgpalette, g_background);
+                                    ScrollLoaded(picture);
+                                    if (panx || pany) ScrollJump(picture, panx, pany);
                                     memcpy(oldpicture, picture, sizeof(oldpicture));
                                     RestoreScreen();
                                     restored = 1;
+                                } else if (backfromvideo == 1) {
+                                    RestoreScreen();
+                                    restored = 1;
                                 }
 
                                 charlines = 0;
 
-                                /* Display sprites */
-                                if (compare_sprites() != 0 || restored || backfromvideo == 1) {
-                                    for (int sc = 0; sc < spritecount; sc++) {
-                                        memset(spritefile, 0, sizeof(spritefile));
-                                        snprintf(spritefile, sizeof(spritefile), "data\\%s", currentsprites[sc].file);
-                                        DisplaySprite(spritefile, currentsprites[sc].x, currentsprites[sc].y);
+                                /* Display sprites: all of them on a fresh background, otherwise
+                                 * only what changed since the screen we rolled back from */
+                                if (restored) {
+                                    for (int sc = 0; sc < currentsprites.count; sc++) {
+                                        DrawSprite(&currentsprites.items[sc]);
                                     }
+                                } else {
+                                    RedrawSpriteDiff();
                                 }
 
                                 /* Clear text area and display sayer name from replay
                                    This mostly superfluous, but can help in case of corrupted saves */
-                                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
+                                ClearTextArea();
                                 RedrawBorder();
                                 if (sayername[0]) {
-                                    locate(0, 322);
+                                    locate(0, TEXT_SAYER_Y);
                                     print_string(sayername);
                                 }
 
@@ -812,12 +873,15 @@ static void run(void) {
                                 break;
                             }
                         }
-                        RestoreScreen();
                         update_display();
                     }
 
                     g_mouseclick = 0;  /* Clear any clicks from dialogs */
                     next = read_keyboard_status();
+                    PrefetchIdle();
+                    CaptureIdle();
+                    MixerIdle();
+                    AnimTick();
                     Sleep(5);
                 }
             }
@@ -832,10 +896,10 @@ static void run(void) {
 
                     if (LoadBackgroundImage(picture, bgpalette, g_background) == 0) {
                         memcpy(oldpicture, picture, sizeof(oldpicture));
+                        ScrollLoaded(picture);
                         RestoreScreen();
                     }
                     reset_cursprites();
-                    spritecount = 0;
                     charlines = 0;
                 }
             }
@@ -843,18 +907,39 @@ static void run(void) {
             /* 'R': Restore background */
             if (*line == 'R') {
                 LoadBackgroundImage(picture, bgpalette, g_background);
+                ScrollLoaded(picture);
                 RestoreScreen();
                 reset_cursprites();
-                spritecount = 0;
+            }
+
+            /* 'O': Pan the view of a W3M background, O[XXXX][YYYY][MMMM] */
+            if (*line == 'O') {
+                if (strlen(line) >= 13) {
+                    char coord[5] = {0};
+                    memcpy(coord, line + 1, 4);
+                    int x = atoi(coord);
+                    memcpy(coord, line + 5, 4);
+                    int y = atoi(coord);
+                    memcpy(coord, line + 9, 4);
+                    g_effectrunning = 1;
+                    g_effectskip = 0;
+                    ScrollPan(picture, x, y, (DWORD)atoi(coord));
+                    FlushMessages();
+                    g_effectrunning = 0;
+                    g_effectskip = 0;
+                    g_lastkey = 0;
+                    g_ignoreclick = 0;
+                    g_ignorerclick = 0;
+                }
             }
 
             /* 'S': Speaker change */
             if (*line == 'S') {
                 charlines = 0;
-                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
+                ClearTextArea();
                 RedrawBorder();
 
-                locate(0, 322);
+                locate(0, TEXT_SAYER_Y);
                 print_string(line + 1);
                 update_display();
 
@@ -874,14 +959,14 @@ static void run(void) {
             /* 'E': Clear text area */
             if (*line == 'E') {
                 charlines = 0;
-                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
+                ClearTextArea();
                 RedrawBorder();
             }
 
             /* 'T': Text line */
             if (*line == 'T') {
                 if (g_textskip == 0) g_textskip = 1;
-                locate(0, 337 + charlines * 15);
+                locate(0, TEXT_LINE_Y + charlines * 15);
                 print_string(" ");
                 print_string(line + 1);
                 charlines++;
@@ -891,7 +976,7 @@ static void run(void) {
             if (*line == 'N') {
                 int prev_textskip = g_textskip;
                 g_textskip = 0;
-                locate(0, 337 + charlines * 15);
+                locate(0, TEXT_LINE_Y + charlines * 15);
                 print_string(" ");
                 print_string(line + 1);
                 g_textskip = prev_textskip;
@@ -917,10 +1002,7 @@ static void run(void) {
                         if (strncmp(musicfile, oldmusicfile, sizeof(musicfile)) != 0) {
                             memcpy(oldmusicfile, musicfile, sizeof(oldmusicfile));
                             g_effectrunning = 1;
-                            if (isplaying) {
-                                StopMusic();
-                                isplaying = 0;
-                            }
+                            /* PlayMusic() replaces the track itself, crossfading if asked */
                             PlayMusic(musicfile);
                             isplaying = 1;
                             FlushMessages();
@@ -953,10 +1035,8 @@ static void run(void) {
 
                 /* Reset sprites, redraw background, so we exit with a clean state */
                 reset_cursprites();
-                spritecount = 0;
                 LoadBackgroundImage(picture, bgpalette, g_background);
                 RestoreScreen();
-                SaveScreen();
                 if (strlen(line) >= 10) {
                     char game_s[2]     = {0};
                     char register_s[2] = {0};
@@ -1023,25 +1103,25 @@ static void run(void) {
 
                             if(score >=0) {
                                 charlines = 0;
-                                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
+                                ClearTextArea();
                                 RedrawBorder();
                                 char final_score[260] = {0};
                                 snprintf(final_score, 259, " Score: %d", score);
                                 int prev_textskip = g_textskip;
                                 g_textskip = 0;
-                                locate(0, 337);
+                                locate(0, TEXT_LINE_Y);
                                 print_string(final_score);
                                 if(g_fullcombo) {
-                                    locate(0, 337 + 15);
+                                    locate(0, TEXT_LINE_Y + 15);
                                     print_string(" Full Combo!");
                                 }
-                                locate(0, 337 + 30);
+                                locate(0, TEXT_LINE_Y + 30);
                                 print_string(" Press Space");
                                 g_textskip = prev_textskip;
                                 update_display();
                                 while (read_keyboard_status() != 1 && g_running)
                                     Sleep(5);
-                                memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
+                                ClearTextArea();
                                 RedrawBorder();
                             }
                         }
@@ -1068,8 +1148,8 @@ static void run(void) {
                         skipnexthistory = 1;
                         backfromvideo = 1;
 
-                        memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
-                        locate(0, 337);
+                        ClearTextArea();
+                        locate(0, TEXT_LINE_Y);
                         RedrawBorder();
                         print_string(" Rolling back...");
                         update_display();
@@ -1106,22 +1186,23 @@ static void run(void) {
                     char videofile[260];
                     int stopvideo = 0;
                     int rollbackvideo = 0;
+                    int native;
                     MSG vmsg;
                     if (filelen > 250) filelen = 250;
                     snprintf(videofile, sizeof(videofile), "data\\%.*s", filelen, line + 1);
+                    native = AssetIndexFormat(videofile) == ASSET_FMT_W3V;
 
                     /* Reset sprites, redraw background, so we exit with a clean state */
                     reset_cursprites();
-                    spritecount = 0;
                     LoadBackgroundImage(picture, bgpalette, g_background);
                     RestoreScreen();
                     RedrawBorder();
-                    SaveScreen();
                     update_display();
                     g_effectrunning = 1;
 
-                    /* Stop music playing and invalidate oldmusicfile in case of rollback */
-                    if (isplaying) {
+                    /* Stop music playing and invalidate oldmusicfile in case of rollback.
+                       W3V animations have no sound, music goes on */
+                    if (isplaying && !native) {
                         StopMusic();
                         isplaying = 0;
                         memset(oldmusicfile, 0, sizeof(oldmusicfile));
@@ -1132,11 +1213,14 @@ static void run(void) {
 
                     /* Wine fix: reposition window before video playback if partially off-screen to avoid hanging
                        0180:err:quartz:image_presenter_PresentImage Failed to blit */
-                    if (IsWine()) RepositionWindow();
-
-                    PlayVideo(videofile);
+                    if (native) {
+                        MovieOpen(videofile);
+                    } else {
+                        if (IsWine()) RepositionWindow();
+                        PlayVideo(videofile);
+                    }
                     /* Wait for video to finish or space to skip */
-                    while (IsVideoPlaying() && g_running && !stopvideo) {
+                    while ((native ? MovieTick() : IsVideoPlaying()) && g_running && !stopvideo) {
                         /* Process all messages, check for space key */
                         if (PeekMessage(&vmsg, NULL, 0, 0, PM_REMOVE)) {
                             if (vmsg.message == WM_QUIT) {
@@ -1154,15 +1238,14 @@ static void run(void) {
                             } else if (vmsg.message == WM_KEYDOWN && !g_configDialog && vmsg.wParam == 'Q') {
                                 char vcmd[128];
                                 RECT wrect, vwrect;
-                                mciSendString("pause video", NULL, 0, NULL);
+                                if (native) MoviePause(1);
+                                else mciSendString("pause video", NULL, 0, NULL);
                                 /* Hide video child window */
                                 if (g_videoWindow) ShowWindow(g_videoWindow, SW_HIDE);
                                 g_effectrunning = 0;
-                                uint32_t *qsave = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
-                                if (qsave) memcpy(qsave, g_videoram, IMAGE_AREA_PIXELS * sizeof(uint32_t));
                                 DispQuit();
                                 QuitMacro();
-                                if (qsave) { memcpy(g_videoram, qsave, IMAGE_AREA_PIXELS * sizeof(uint32_t)); free(qsave); }
+                                OverlayClose();
                                 update_display();
                                 g_effectrunning = 1;
                                 /* Restore video child window position/size and show it */
@@ -1174,7 +1257,8 @@ static void run(void) {
                                     mciSendString(vcmd, NULL, 0, NULL);
                                     ShowWindow(g_videoWindow, SW_SHOW);
                                 }
-                                mciSendString("resume video", NULL, 0, NULL);
+                                if (native) MoviePause(0);
+                                else mciSendString("resume video", NULL, 0, NULL);
                             } else if (!ConfigDialogMessage(&vmsg)) {
                                 TranslateMessage(&vmsg);
                                 DispatchMessage(&vmsg);
@@ -1185,7 +1269,8 @@ static void run(void) {
                         }
                     }
 
-                    StopVideo();
+                    if (native) MovieClose();
+                    else StopVideo();
                     RestoreScreen();
                     g_effectrunning = 0;
                     g_lastkey = 0;
@@ -1200,8 +1285,8 @@ static void run(void) {
                         skipnexthistory = 1;
                         backfromvideo = 1;  /* Force sprite redraw in seektoline */
 
-                        memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
-                        locate(0, 337);
+                        ClearTextArea();
+                        locate(0, TEXT_LINE_Y);
                         RedrawBorder();
                         print_string(" Rolling back...");
                         update_display();
@@ -1270,50 +1355,46 @@ static void run(void) {
                     if (maxchoice < 2) maxchoice = 2;
 
                     update_display();
+                    PrefetchSchedule(lineNumber);
                     next = read_keyboard_status();
                     while (!(next >= 10 && next <= (9 + maxchoice)) && g_running) {
                         next = read_keyboard_status();
                         if (next == 2) {
-                            SaveScreen();
                             DispQuit();
                             QuitMacro();
                             next = 0;
-                            RestoreScreen();
+                            OverlayClose();
                             update_display();
                         }
 
                         if (next == 7) RestoreWindowSize();
 
                         if (next == 3) {
-                            SaveScreen();
                             DispLoadSave(1);
                             SaveMacro();
                             next = 0;
-                            RestoreScreen();
+                            OverlayClose();
                             update_display();
                         }
 
                         if (next == 8) {
-                            SaveScreen();
                             DispLoadSave(2);
                             DeleteMacro();
                             next = 0;
-                            RestoreScreen();
+                            OverlayClose();
                             update_display();
                         }
 
                         if (next == 9) {
-                            SaveScreen();
                             DispEsc();
                             EscMacro();
                             if (lineNumber == 0) break;
                             next = 0;
-                            RestoreScreen();
+                            OverlayClose();
                             update_display();
                         }
 
                         if (next == 4) {
-                            SaveScreen();
                             DispLoadSave(0);
 
                             int ldnext = 0;
@@ -1326,14 +1407,14 @@ static void run(void) {
                             if (ldnext != 2 && ldnext != 9) {
                                 HandleSaveFilename(ldnext);
 
-                                RestoreScreen();
+                                OverlayClose();
                                 update_display();
                                 if (file_exists(savefile) == 0) {
                                     next = ldnext;
                                     goto lblloadsave;
                                 }
                             } else {
-                                RestoreScreen();
+                                OverlayClose();
                                 update_display();
                             }
                             next = 0;
@@ -1345,8 +1426,8 @@ static void run(void) {
                             savehistory_idx--;
                             skipnexthistory = 1;
 
-                            memcpy(g_videoram + IMAGE_AREA_PIXELS, g_textarea, TEXT_AREA_PIXELS * sizeof(uint32_t));
-                            locate(0, 337);
+                            ClearTextArea();
+                            locate(0, TEXT_LINE_Y);
                             print_string(" Rolling back...");
                             RedrawBorder();
                             update_display();
@@ -1354,7 +1435,6 @@ static void run(void) {
                         }
 
                         if (next == 6) {
-                            SaveScreen();
                             DispHelp();
                             while (next != 2 && next != 9 && g_running) {
                                 if (next == 7) RestoreWindowSize();
@@ -1362,10 +1442,14 @@ static void run(void) {
                                 Sleep(5);
                             }
                             next = 0;
-                            RestoreScreen();
+                            OverlayClose();
                             update_display();
                         }
 
+                        PrefetchIdle();
+                        CaptureIdle();
+                        MixerIdle();
+                        AnimTick();
                         Sleep(5);
                     }
                     if (lineNumber > 0)
@@ -1384,6 +1468,7 @@ static void run(void) {
                             TranslateMessage(&msg);
                             DispatchMessage(&msg);
                         }
+                        AnimTick();
                     }
                 }
             }
@@ -1395,67 +1480,48 @@ static void run(void) {
                     memcpy(effect, line + 1, 2);
                     int effectnum = atoi(effect);
                     g_effectrunning = 1;
+                    g_effectskip = 0;
+
+                    // Effects 1-40, 97 and 98 invalidate the current picture
+                    if(effectnum != 96 && effectnum != 99) memset(picture, 0, sizeof(picture));
 
-                    // Effects 1-40 and 98 invalidate the current picture
-                    if(effectnum != 99) memset(picture, 0, sizeof(picture));
-
-                    if (effectnum == 1) FxVWipeDown(COLOR_BLACK);
-                    if (effectnum == 2) FxVWipeDown(COLOR_WHITE);
-                    if (effectnum == 3) { FxVWipeDown(COLOR_BLACK); FxVWipeDown(COLOR_WHITE); }
-                    if (effectnum == 4) { FxVWipeDown(COLOR_WHITE); FxVWipeDown(COLOR_BLACK); }
-                    if (effectnum == 5) FxVWipeUp(COLOR_BLACK);
-                    if (effectnum == 6) FxVWipeUp(COLOR_WHITE);
-                    if (effectnum == 7) { FxVWipeUp(COLOR_BLACK); FxVWipeUp(COLOR_WHITE); }
-                    if (effectnum == 8) { FxVWipeUp(COLOR_WHITE); FxVWipeUp(COLOR_BLACK); }
-                    if (effectnum == 9) FxVWipeMidIn(COLOR_BLACK);
-                    if (effectnum == 10) FxVWipeMidIn(COLOR_WHITE);
-                    if (effectnum == 11) { FxVWipeMidIn(COLOR_BLACK); FxVWipeMidIn(COLOR_WHITE); }
-                    if (effectnum == 12) { FxVWipeMidIn(COLOR_WHITE); FxVWipeMidIn(COLOR_BLACK); }
-                    if (effectnum == 13) FxVWipeMidOut(COLOR_BLACK);
-                    if (effectnum == 14) FxVWipeMidOut(COLOR_WHITE);
-                    if (effectnum == 15) { FxVWipeMidOut(COLOR_BLACK); FxVWipeMidOut(COLOR_WHITE); }
-                    if (effectnum == 16) { FxVWipeMidOut(COLOR_WHITE); FxVWipeMidOut(COLOR_BLACK); }
-                    if (effectnum == 17) FxHWipeRight(COLOR_BLACK);
-                    if (effectnum == 18) FxHWipeRight(COLOR_WHITE);
-                    if (effectnum == 19) { FxHWipeRight(COLOR_BLACK); FxHWipeRight(COLOR_WHITE); }
-                    if (effectnum == 20) { FxHWipeRight(COLOR_WHITE); FxHWipeRight(COLOR_BLACK); }
-                    if (effectnum == 21) FxHWipeLeft(COLOR_BLACK);
-                    if (effectnum == 22) FxHWipeLeft(COLOR_WHITE);
-                    if (effectnum == 23) { FxHWipeLeft(COLOR_BLACK); FxHWipeLeft(COLOR_WHITE); }
-                    if (effectnum == 24) { FxHWipeLeft(COLOR_WHITE); FxHWipeLeft(COLOR_BLACK); }
-                    if (effectnum == 25) FxHWipeMidIn(COLOR_BLACK);
-                    if (effectnum == 26) FxHWipeMidIn(COLOR_WHITE);
-                    if (effectnum == 27) { FxHWipeMidIn(COLOR_BLACK); FxHWipeMidIn(COLOR_WHITE); }
-                    if (effectnum == 28) { FxHWipeMidIn(COLOR_WHITE); FxHWipeMidIn(COLOR_BLACK); }
-                    if (effectnum == 29) FxHWipeMidOut(COLOR_BLACK);
-                    if (effectnum == 30) FxHWipeMidOut(COLOR_WHITE);
-                    if (effectnum == 31) { FxHWipeMidOut(COLOR_BLACK); FxHWipeMidOut(COLOR_WHITE); }
-                    if (effectnum == 32) { FxHWipeMidOut(COLOR_WHITE); FxHWipeMidOut(COLOR_BLACK); }
-                    if (effectnum == 33) FxCircleOut(COLOR_BLACK);
-                    if (effectnum == 34) FxCircleOut(COLOR_WHITE);
-                    if (effectnum == 35) { FxCircleOut(COLOR_BLACK); FxCircleOut(COLOR_WHITE); }
-                    if (effectnum == 36) { FxCircleOut(COLOR_WHITE); FxCircleOut(COLOR_BLACK); }
-                    if (effectnum == 37) FxCircleIn(COLOR_BLACK);
-                    if (effectnum == 38) FxCircleIn(COLOR_WHITE);
-                    if (effectnum == 39) { FxCircleIn(COLOR_BLACK); FxCircleIn(COLOR_WHITE); }
-                    if (effectnum == 40) { FxCircleIn(COLOR_WHITE); FxCircleIn(COLOR_BLACK); }
+                    /* 01-40: ten wipes in black, white, black then white, white then black */
+                    if (effectnum >= 1 && effectnum <= 40) {
+                        int kind = (effectnum - 1) / 4;
+                        int variant = (effectnum - 1) % 4;
+                        FxWipe(kind, (variant == 1 || variant == 3) ? COLOR_WHITE : COLOR_BLACK);
+                        if (variant >= 2) FxWipe(kind, variant == 2 ? COLOR_WHITE : COLOR_BLACK);
+                    }
+                    if (effectnum == 97) {
+                        if (strlen(line) >= 9) {
+                            char duration[5] = {0};
+                            char rulefile[260];
+                            memcpy(duration, line + 4, 4);
+                            int filelen = (int)strlen(line) - 8;
+                            if (filelen > 250) filelen = 250;
+                            snprintf(rulefile, sizeof(rulefile), "data\\%.*s", filelen, line + 8);
+                            FxRuleWipe(rulefile, line[3] == 'W' ? COLOR_WHITE : COLOR_BLACK, (DWORD)atoi(duration));
+                        }
+                    }
                     if (effectnum == 98) FxFadeOut();
-                    if (effectnum == 99) {
+                    if (effectnum == 96 || effectnum == 99) {
                         if (strlen(line) >= 4) {
                             int filelen = (int)strlen(line) - 3;
                             if (filelen > 250) filelen = 250;
                             memset(picture, 0, sizeof(picture));
                             snprintf(picture, sizeof(picture), "data\\%.*s", filelen, line + 3);
                             memcpy(oldpicture, picture, sizeof(oldpicture));
-                            FxFadeIn(picture);
+                            if (effectnum == 96) FxDissolve(picture);
+                            else FxFadeIn(picture);
                             SaveScreen();
+                            ScrollLoaded(picture);
                         }
                     }
 
                     FlushMessages();
                     reset_cursprites();
-                    spritecount = 0;
                     g_effectrunning = 0;
+                    g_effectskip = 0;
                     g_lastkey = 0;  /* Clear any key pressed during effect */
                     g_ignoreclick = 0;
                     g_ignorerclick = 0;
@@ -1464,7 +1530,7 @@ static void run(void) {
 
             /* 'A': Display sprite */
             if (*line == 'A') {
-                if (strlen(line) >= 8 && spritecount < 256) {
+                if (strlen(line) >= 8 && currentsprites.count < 256) {
                     int filelen = (int)strlen(line) - 7;
                     if (filelen > 250) filelen = 250;
                     memset(spritefile, 0, sizeof(spritefile));
@@ -1475,16 +1541,42 @@ static void run(void) {
                     memcpy(liney, line + 4, 3);
                     posx = atoi(linex);
                     posy = atoi(liney);
-                    currentsprites[spritecount].x = posx;
-                    currentsprites[spritecount].y = posy;
-                    memcpy(currentsprites[spritecount].file, line + 7, filelen);
-                    spritecount++;
-                    DisplaySprite(spritefile, posx, posy);
+                    if (push_sprite(spritefile, posx, posy, 0) == 0) {
+                        DrawSprite(&currentsprites.items[currentsprites.count - 1]);
+                    }
+                }
+            }
+
+            /* 'Y': Animated sprite, 'YS' stops all animations, 'YSfile' only that one */
+            if (*line == 'Y') {
+                if (line[1] == 'S') {
+                    if (strlen(line) > 2) {
+                        memset(spritefile, 0, sizeof(spritefile));
+                        snprintf(spritefile, sizeof(spritefile), "data\\%.*s", 250, line + 2);
+                        StopAnimations(spritefile, 1);
+                    } else {
+                        StopAnimations(NULL, 1);
+                    }
+                } else if (strlen(line) >= 8 && currentsprites.count < 256) {
+                    int filelen = (int)strlen(line) - 7;
+                    if (filelen > 250) filelen = 250;
+                    memset(spritefile, 0, sizeof(spritefile));
+                    snprintf(spritefile, sizeof(spritefile), "data\\%.*s", filelen, line + 7);
+                    memset(linex, 0, 4);
+                    memset(liney, 0, 4);
+                    memcpy(linex, line + 1, 3);
+                    memcpy(liney, line + 4, 3);
+                    posx = atoi(linex);
+                    posy = atoi(liney);
+                    if (push_sprite(spritefile, posx, posy, 1) == 0) {
+                        DrawSprite(&currentsprites.items[currentsprites.count - 1]);
+                    }
                 }
             }
         }
 
         RedrawBorder();
+        TextRevealDraw(0);
         update_display();
         Sleep(16); /* ~60 FPS */
     }
@@ -1494,8 +1586,15 @@ endprog:
     CloseWavSfx();
     StopMusic();
     StopVideo();
+    PrefetchShutdown();
+    CaptureShutdown();
+    MixerShutdown();
     fclose(script);
     free(choicedata);
+    free_sprites();
+    GlyphCacheFree();
+    PresentFree();
+    ScrollClose();
 
     /* Save volume, in case it was changed externally */
     char volstr[4];
@@ -1504,6 +1603,23 @@ endprog:
     if(restorevolume) SetMasterVolume(g_origvolume);
 }
 
+/* Screen size from the 'G' line of stvn.ini (like G1280x800), read before
+ * the window and framebuffers are made. Sizes below 640x400 are ignored */
+static void ScreenSizeFromIni(void) {
+    FILE *config = fopen("stvn.ini", "r");
+    char *line;
+    if (!config) return;
+    while ((line = get_line(config)) != NULL) {
+        int w, h;
+        if (*line == 'G' && sscanf(line + 1, "%dx%d", &w, &h) == 2 &&
+            w >= BASE_WIDTH && w <= MAX_WIDTH && h >= BASE_HEIGHT && h <= MAX_HEIGHT) {
+            g_screenWidth = w;
+            g_screenHeight = h;
+        }
+    }
+    fclose(config);
+}
+
 /* WinMain entry point */
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     /* Register window class */
@@ -1533,8 +1649,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     vwc.lpszClassName = "STVNVideoClass";
     RegisterClassEx(&vwc);
 
-    /* Calculate window size for 640x400 client area */
-    RECT rect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    /* Calculate window size for the screen client area */
+    RECT rect;
+    ScreenSizeFromIni();
+    SetRect(&rect, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
     AdjustWindowRect(&rect, WS_OVERLAPPEDWINDOW, FALSE);
 
     /* Create window */
@@ -1556,22 +1674,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     g_videoram = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
     g_background = (uint32_t *)malloc(IMAGE_AREA_PIXELS * sizeof(uint32_t));
     g_textarea = (uint32_t *)malloc(TEXT_AREA_PIXELS * sizeof(uint32_t));
+    g_overlay = (uint32_t *)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
 
-    if (!g_videoram || !g_background || !g_textarea) {
+    if (!g_videoram || !g_background || !g_textarea || !g_overlay) {
         MessageBox(NULL, "Memory Allocation Failed!", "Error", MB_ICONEXCLAMATION | MB_OK);
         return 0;
     }
 
     /* Initialize to white */
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        g_videoram[i] = COLOR_WHITE;
-    }
-    for (int i = 0; i < IMAGE_AREA_PIXELS; i++) {
-        g_background[i] = COLOR_WHITE;
-    }
-    for (int i = 0; i < TEXT_AREA_PIXELS; i++) {
-        g_textarea[i] = COLOR_WHITE;
-    }
+    draw_fill(g_videoram, COLOR_WHITE, SCREEN_WIDTH * SCREEN_HEIGHT);
+    draw_fill(g_background, COLOR_WHITE, IMAGE_AREA_PIXELS);
+    draw_fill(g_textarea, COLOR_WHITE, TEXT_AREA_PIXELS);
+    GlyphCacheInit();
 
     ShowWindow(g_hwnd, nCmdShow);
     UpdateWindow(g_hwnd);
@@ -1584,9 +1698,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
     timeBeginPeriod(timerPeriod);
 
+    AssetCacheInit();
+
     /* Run the engine */
     run();
 
+    AssetCacheShutdown();
+    AssetIndexFree();
+    ArchiveClose();
+
     /* Cleanup - destroy window first to prevent WM_PAINT accessing freed memory */
     if (g_hwnd && IsWindow(g_hwnd)) {
         DestroyWindow(g_hwnd);
@@ -1599,6 +1719,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     g_background = NULL;
     free(g_textarea);
     g_textarea = NULL;
+    free(g_overlay);
+    g_overlay = NULL;
 
     timeEndPeriod(timerPeriod);
 
@@ -0,0 +1,293 @@
+/*
+ *      STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      RIFF WAVE reading for the sound mixer: finds the format, the sample
+ *      data and the loop of a smpl chunk, and turns PCM of 8, 16, 24 or 32
+ *      bits, or 4-bit IMA and MS ADPCM, mono or stereo, into 16-bit stereo.
+ *      ADPCM blocks each start from a header of their own, so any block
+ *      can be decoded on its own. IMA goes through tables of the step and
+ *      index for each state and nibble, built once by wav_init(). All
+ *      integers are little-endian.
+ */
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* fmt tags */
+#define WAV_PCM        1
+#define WAV_MS_ADPCM   2
+#define WAV_IMA_ADPCM  0x11
+
+#define WAV_MS_COEFS   32       /* predictor pairs an MS ADPCM file may have */
+#define WAV_FMT_MAX    (22 + WAV_MS_COEFS * 4) /* largest fmt chunk used */
+
+typedef struct {
+    int format, channels, rate, bits;
+    int align;                  /* bytes per frame, or per ADPCM block */
+    int blockframes;            /* frames per block, 1 for PCM */
+    int ncoefs;                 /* MS ADPCM predictors */
+    int coefs[WAV_MS_COEFS][2];
+    const uint8_t *data;        /* inside the file */
+    uint32_t size;              /* bytes of data */
+    uint32_t frames;
+} WavInfo;
+
+static const int16_t wav_ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t wav_ima_moves[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int wav_ms_adapt[16] = {
+    230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230
+};
+
+/* Predictors of files that don't list their own */
+static const int wav_ms_coefs[7][2] = {
+    {256, 0}, {512, -256}, {0, 0}, {192, 64}, {240, 0}, {460, -208}, {392, -232}
+};
+
+/* Change of the sample and next step index for step index * 16 + nibble */
+static int32_t wav_ima_diff[89 * 16];
+static uint8_t wav_ima_next[89 * 16];
+
+/* Build the IMA tables, before anything is decoded */
+static inline void wav_init(void) {
+    for (int i = 0; i < 89; i++) {
+        for (int n = 0; n < 16; n++) {
+            int step = wav_ima_steps[i], diff = step >> 3, next = i + wav_ima_moves[n & 7];
+            if (n & 4) diff += step;
+            if (n & 2) diff += step >> 1;
+            if (n & 1) diff += step >> 2;
+            wav_ima_diff[i * 16 + n] = n & 8 ? -diff : diff;
+            wav_ima_next[i * 16 + n] = (uint8_t)(next < 0 ? 0 : next > 88 ? 88 : next);
+        }
+    }
+}
+
+static inline uint32_t wav_get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int wav_get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+/* Fields of a fmt chunk of 'len' bytes, returns 0 when usable */
+static inline int wav_fmt(const uint8_t *c, uint32_t len, WavInfo *info) {
+    if (len < 16) return -1;
+    info->format = wav_get16(c);
+    info->channels = wav_get16(c + 2);
+    info->rate = (int)wav_get32(c + 4);
+    info->align = wav_get16(c + 12);
+    info->bits = wav_get16(c + 14);
+    info->blockframes = 1;
+    info->ncoefs = 0;
+
+    /* Frames per ADPCM block, 0 when the block can't hold its headers */
+    int ch = info->channels;
+    if (info->format == WAV_IMA_ADPCM && ch >= 1) {
+        info->blockframes = info->align >= 8 * ch ? 1 + (info->align - 4 * ch) / (4 * ch) * 8 : 0;
+    } else if (info->format == WAV_MS_ADPCM && ch >= 1) {
+        info->blockframes = info->align >= 7 * ch ? 2 + (info->align - 7 * ch) * 2 / ch : 0;
+        if (len >= 22) info->ncoefs = wav_get16(c + 20);
+        if (info->ncoefs >= 1 && info->ncoefs <= WAV_MS_COEFS && len >= 22u + info->ncoefs * 4) {
+            for (int i = 0; i < info->ncoefs; i++) {
+                info->coefs[i][0] = (int16_t)wav_get16(c + 22 + i * 4);
+                info->coefs[i][1] = (int16_t)wav_get16(c + 24 + i * 4);
+            }
+        } else {
+            info->ncoefs = 7;
+            memcpy(info->coefs, wav_ms_coefs, sizeof(wav_ms_coefs));
+        }
+    }
+    return info->channels >= 1 && info->rate >= 1000 && info->rate <= 96000 && info->align >= 1 ? 0 : -1;
+}
+
+/* First loop of a smpl chunk as frames start to end - 1, returns 0 if any */
+static inline int wav_smpl(const uint8_t *c, uint32_t len, uint32_t *start, uint32_t *end) {
+    if (len < 36 + 24 || wav_get32(c + 28) == 0) return -1;
+    *start = wav_get32(c + 36 + 8);
+    *end = wav_get32(c + 36 + 12) + 1; /* the last frame is part of the loop */
+    return *end > *start ? 0 : -1;
+}
+
+/* Frames held by 'len' bytes of a single block, a short last block
+ * counts for the whole groups it has */
+static inline uint32_t wav_block_frames(const WavInfo *info, uint32_t len) {
+    uint32_t ch = (uint32_t)info->channels, n;
+    if (info->format == WAV_IMA_ADPCM) {
+        n = len >= 4 * ch ? 1 + (len - 4 * ch) / (4 * ch) * 8 : 0;
+    } else if (info->format == WAV_MS_ADPCM) {
+        n = len >= 7 * ch ? 2 + (len - 7 * ch) * 2 / ch : 0;
+    } else {
+        n = len / info->align;
+    }
+    return n < (uint32_t)info->blockframes ? n : (uint32_t)info->blockframes;
+}
+
+/* Frames in info->size bytes, at most 'fact' for ADPCM when the file
+ * says (the last block is padded) */
+static inline void wav_frames(WavInfo *info, uint32_t fact) {
+    info->frames = info->size / info->align * info->blockframes +
+                   wav_block_frames(info, info->size % info->align);
+    if (info->format != WAV_PCM && fact && fact < info->frames) info->frames = fact;
+}
+
+/* Find the fmt and data chunks, returns 0 when both are there. A data
+ * chunk running past the end of the file is cut short */
+static inline int wav_info(const uint8_t *p, uint32_t size, WavInfo *info) {
+    uint32_t pos = 12, fact = 0;
+    int fmt = 0;
+    memset(info, 0, sizeof(*info));
+    if (size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) return -1;
+
+    while (pos + 8 <= size) {
+        uint32_t len = wav_get32(p + pos + 4);
+        const uint8_t *c = p + pos + 8;
+        if (len > size - pos - 8) len = size - pos - 8;
+        if (memcmp(p + pos, "fmt ", 4) == 0) {
+            fmt = wav_fmt(c, len, info) == 0;
+        } else if (memcmp(p + pos, "fact", 4) == 0 && len >= 4) {
+            fact = wav_get32(c);
+        } else if (memcmp(p + pos, "data", 4) == 0 && fmt && !info->data) {
+            info->data = c;
+            info->size = len;
+        }
+        pos += 8 + len + (len & 1); /* chunks are word-aligned */
+    }
+    if (!info->data || info->blockframes < 1) return -1;
+    wav_frames(info, fact);
+    return 0;
+}
+
+/* Whether wav_decode() can convert the samples */
+static inline int wav_decodable(const WavInfo *info) {
+    if (info->channels > 2) return 0;
+    if (info->format == WAV_IMA_ADPCM || info->format == WAV_MS_ADPCM) return info->bits == 4;
+    return info->format == WAV_PCM &&
+           (info->bits == 8 || info->bits == 16 || info->bits == 24 || info->bits == 32) &&
+           info->align == info->channels * info->bits / 8;
+}
+
+/* 'frames' PCM frames from 'src' to 16-bit stereo in 'dst' */
+static inline void wav_pcm16(const WavInfo *info, const uint8_t *src, uint32_t frames, int16_t *dst) {
+    int bytes = info->bits / 8, step = info->channels == 2 ? bytes : 0;
+    for (uint32_t i = 0; i < frames; i++, src += info->align) {
+        for (int ch = 0; ch < 2; ch++) {
+            const uint8_t *s = src + ch * step;
+            int v;
+            if (bytes == 1) v = (s[0] - 128) * 256;
+            else v = (int16_t)(s[bytes - 2] | (s[bytes - 1] << 8)); /* top 16 bits */
+            *dst++ = (int16_t)v;
+        }
+    }
+}
+
+/* IMA block: per channel a header of the first sample and step index,
+ * then groups of 4 bytes, 8 samples low nibble first, channels taking
+ * turns. Each channel is decoded on its own into its side of 'dst', mono
+ * into both */
+static inline void wav_ima_block(const WavInfo *info, const uint8_t *src, uint32_t frames, int16_t *dst) {
+    int chans = info->channels;
+    for (int ch = 0; ch < chans; ch++) {
+        const uint8_t *h = src + ch * 4, *p = src + chans * 4 + ch * 4;
+        int pred = (int16_t)wav_get16(h), index = h[2] > 88 ? 88 : h[2];
+        int16_t *out = dst + ch, *mono = chans == 1 ? dst + 1 : out;
+        out[0] = mono[0] = (int16_t)pred;
+        for (uint32_t i = 1; i < frames; p += chans * 4) {
+            for (int b = 0; b < 8 && i < frames; b++, i++) {
+                int n = (p[b >> 1] >> ((b & 1) * 4)) & 15, t = index * 16 + n;
+                pred += wav_ima_diff[t];
+                pred = pred > 32767 ? 32767 : pred < -32768 ? -32768 : pred;
+                index = wav_ima_next[t];
+                out[i * 2] = mono[i * 2] = (int16_t)pred;
+            }
+        }
+    }
+}
+
+/* MS ADPCM state of a channel */
+typedef struct {
+    int c1, c2, delta, s1, s2;
+} WavMs;
+
+static inline int16_t wav_ms_nibble(WavMs *s, int n) {
+    int v = ((s->s1 * s->c1 + s->s2 * s->c2) >> 8) + (n >= 8 ? n - 16 : n) * s->delta;
+    v = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+    s->delta = (wav_ms_adapt[n] * s->delta) >> 8;
+    if (s->delta < 16) s->delta = 16;
+    s->s2 = s->s1;
+    s->s1 = v;
+    return (int16_t)v;
+}
+
+/* MS block: predictor indices, deltas, then the second and first
+ * samples for each channel, then nibbles high first, channels taking
+ * turns. Mono goes to both sides of 'dst' */
+static inline void wav_ms_block(const WavInfo *info, const uint8_t *src, uint32_t frames, int16_t *dst) {
+    int chans = info->channels;
+    WavMs ms[2];
+    for (int ch = 0; ch < chans; ch++) {
+        int pred = src[ch] < info->ncoefs ? src[ch] : info->ncoefs - 1;
+        ms[ch].c1 = info->coefs[pred][0];
+        ms[ch].c2 = info->coefs[pred][1];
+        ms[ch].delta = (int16_t)wav_get16(src + chans + ch * 2);
+        ms[ch].s1 = (int16_t)wav_get16(src + chans * 3 + ch * 2);
+        ms[ch].s2 = (int16_t)wav_get16(src + chans * 5 + ch * 2);
+        dst[ch] = dst[ch + 2 - chans] = (int16_t)ms[ch].s2;
+        if (frames > 1) dst[2 + ch] = dst[4 - chans + ch] = (int16_t)ms[ch].s1;
+    }
+    const uint8_t *p = src + 7 * chans;
+    int16_t *out = dst + 4;
+    if (chans == 2) {
+        for (uint32_t i = 2; i < frames; i++, p++, out += 2) {
+            out[0] = wav_ms_nibble(&ms[0], *p >> 4);
+            out[1] = wav_ms_nibble(&ms[1], *p & 15);
+        }
+    } else {
+        for (uint32_t i = 2; i < frames; i += 2, p++, out += 4) {
+            out[0] = out[1] = wav_ms_nibble(&ms[0], *p >> 4);
+            if (i + 1 < frames) out[2] = out[3] = wav_ms_nibble(&ms[0], *p & 15);
+        }
+    }
+}
+
+/* Up to 'max' frames of the block of 'len' bytes at 'src' to 16-bit stereo
+ * in 'dst', returns how many */
+static inline uint32_t wav_decode_block(const WavInfo *info, const uint8_t *src, uint32_t len,
+                                 uint32_t max, int16_t *dst) {
+    uint32_t frames = wav_block_frames(info, len);
+    if (frames > max) frames = max;
+    if (info->format == WAV_IMA_ADPCM) wav_ima_block(info, src, frames, dst);
+    else if (info->format == WAV_MS_ADPCM) wav_ms_block(info, src, frames, dst);
+    else wav_pcm16(info, src, frames, dst);
+    return frames;
+}
+
+/* All info->frames frames of the data to 16-bit stereo in 'dst' */
+static inline void wav_decode(const WavInfo *info, int16_t *dst) {
+    if (info->format == WAV_PCM) {
+        wav_pcm16(info, info->data, info->frames, dst);
+        return;
+    }
+    uint32_t done = 0;
+    for (uint32_t at = 0; at < info->size && done < info->frames; at += info->align) {
+        uint32_t len = info->size - at < (uint32_t)info->align ? info->size - at : (uint32_t)info->align;
+        uint32_t n = wav_decode_block(info, info->data + at, len, info->frames - done, dst + done * 2);
+        if (n == 0) break;
+        done += n;
+    }
+}
+
+#endif /* WAV_H */
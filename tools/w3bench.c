@@ -0,0 +1,551 @@
+/*
+ *      w3bench - 2D primitive micro-benchmarks for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3bench [-n N]          time each primitive of src/draw.h against
+ *                              the pixel-at-a-time loop it replaced, N
+ *                              passes each (200 by default)
+ *
+ *      Both versions draw into their own 640x400 plane, which are compared
+ *      afterwards, so a primitive that is fast but wrong shows up.
+ *
+ *      Then the 8-bpp present path of src/pal8.h: indexing time per frame
+ *      and the bytes handed to GDI, for a 1-bit screen, a 16 color screen
+ *      and a photo, which has to fall back to 32 bits. Indexed frames are
+ *      expanded back and compared with the original.
+ *
+ *      Then the 16-bpp present path of src/rgb16.h, RGB565 and RGB555 with
+ *      and without dithering, against a pixel-at-a-time conversion.
+ *
+ *      Last the ADPCM decoders of src/wav.h: a second of synthetic music
+ *      is encoded to IMA and MS ADPCM WAVs, mono and stereo, with a short
+ *      last block, and decoded by the engine's tables and by a
+ *      sample-at-a-time decoder written from the format description. Both
+ *      must match, and the signal to noise ratio against the original
+ *      PCM shows the encoding came through.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#include "../src/draw.h"
+#include "../src/pal8.h"
+#include "../src/rgb16.h"
+#include "../src/wav.h"
+
+#define PLANE_W  640
+#define PLANE_H  400
+#define IMAGE_H  320
+
+static uint32_t g_ref[PLANE_W * PLANE_H];
+static uint32_t g_fast[PLANE_W * PLANE_H];
+static uint32_t g_src[PLANE_W * PLANE_H];
+
+/* ── Reference versions, as the engine had them ─────────────────────────── */
+
+static void ref_fill(uint32_t *dst, uint32_t color, int count) {
+    for (int i = 0; i < count; i++) dst[i] = color;
+}
+
+static void ref_rect(int x, int y, int w, int h, uint32_t c) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (w <= 0 || h <= 0) return;
+    if (x + w > PLANE_W) w = PLANE_W - x;
+    if (y + h > IMAGE_H) h = IMAGE_H - y;
+    if (w <= 0 || h <= 0) return;
+    for (int py = y; py < y + h; py++)
+        for (int px = x; px < x + w; px++)
+            g_ref[py * PLANE_W + px] = c;
+}
+
+static int ref_isqrt(int n) {
+    if (n <= 0) return 0;
+    int x = n, y = 1;
+    while (x > y) { x = (x + y) / 2; y = n / x; }
+    return x;
+}
+
+static void ref_circle(int cx, int cy, int r, uint32_t c) {
+    for (int dy = -r; dy <= r; dy++) {
+        int w = ref_isqrt(r * r - dy * dy);
+        int y = cy + dy;
+        if (y < 0 || y >= IMAGE_H) continue;
+        int x1 = cx - w < 0 ? 0 : cx - w;
+        int x2 = cx + w >= PLANE_W ? PLANE_W - 1 : cx + w;
+        for (int x = x1; x <= x2; x++)
+            g_ref[y * PLANE_W + x] = c;
+    }
+}
+
+/* ── Workloads, the same pixels for both versions ───────────────────────── */
+
+/* Whole screen, as clear_screen() */
+static void run_fill(int fast, int pass) {
+    uint32_t c = 0xff000000u | (uint32_t)pass;
+    if (fast) draw_fill(g_fast, c, PLANE_W * PLANE_H);
+    else ref_fill(g_ref, c, PLANE_W * PLANE_H);
+}
+
+/* Short spans at odd offsets, as W3S sprite runs and transition runs */
+static void run_spans(int fast, int pass) {
+    for (int y = 0; y < IMAGE_H; y++) {
+        for (int x = (y + pass) % 7; x + 13 < PLANE_W; x += 29) {
+            uint32_t *row = (fast ? g_fast : g_ref) + y * PLANE_W;
+            if (fast) draw_fill(row + x, (uint32_t)x, 13);
+            else ref_fill(row + x, (uint32_t)x, 13);
+        }
+    }
+}
+
+/* Rhythm game frame: track lines, bar, big digits, partly off screen */
+static void run_rect(int fast, int pass) {
+    for (int i = 0; i < 64; i++) {
+        int x = (i * 37 + pass) % (PLANE_W + 40) - 20;
+        int y = (i * 53 + pass) % (IMAGE_H + 40) - 20;
+        int w = 2 + i % 48, h = 2 + (i * 7) % 40;
+        if (fast) draw_rect(g_fast, PLANE_W, x, y, w, h, PLANE_W, IMAGE_H, (uint32_t)i);
+        else ref_rect(x, y, w, h, (uint32_t)i);
+    }
+}
+
+/* Rhythm game notes, radius 16 and 18 */
+static void run_circle(int fast, int pass) {
+    for (int i = 0; i < 64; i++) {
+        int cx = (i * 41 + pass) % PLANE_W;
+        int cy = (i * 29 + pass) % IMAGE_H;
+        int r = i & 1 ? 18 : 16;
+        if (fast) draw_circle(g_fast, PLANE_W, cx, cy, r, PLANE_W, IMAGE_H, (uint32_t)i);
+        else ref_circle(cx, cy, r, (uint32_t)i);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(int fast, int pass);
+} Bench;
+
+static const Bench g_benches[] = {
+    {"fill 640x400", run_fill},
+    {"fill 13px spans", run_spans},
+    {"rect clipped", run_rect},
+    {"circle r16/r18", run_circle},
+};
+
+static double msecs(clock_t ticks) {
+    return (double)ticks * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/* ── 8-bpp frames ──────────────────────────────────────────────────────── */
+
+/* Dithered black and white, as a 1-bit PI3 background with text */
+static uint32_t frame_mono(int x, int y) {
+    return ((x ^ y) & 1) || (x / 8 + y / 15) % 5 == 0 ? 0xff000000u : 0xffffffffu;
+}
+
+/* 16 color bands, as a low color PNG */
+static uint32_t frame_16(int x, int y) {
+    return 0xff000000u | ((uint32_t)((x / 40 + y / 25) & 15) * 0x111111u);
+}
+
+/* Every pixel its own shade */
+static uint32_t frame_photo(int x, int y) {
+    return 0xff000000u | (((uint32_t)x * 2654435761u + (uint32_t)y * 40503u) >> 8);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t (*pixel)(int x, int y);
+} Frame;
+
+static const Frame g_frames[] = {
+    {"index 1-bit", frame_mono},
+    {"index 16 colors", frame_16},
+    {"index photo", frame_photo},
+};
+
+static int bench_index(int passes) {
+    static uint8_t indexed[PLANE_W * PLANE_H];
+    static Pal8 pal;
+    int errors = 0;
+
+    printf("\n%-18s %10s %7s %10s  %s\n", "frame", "ms/frame", "colors", "GDI bytes", "check");
+    for (size_t f = 0; f < sizeof(g_frames) / sizeof(g_frames[0]); f++) {
+        for (int y = 0; y < PLANE_H; y++)
+            for (int x = 0; x < PLANE_W; x++)
+                g_src[y * PLANE_W + x] = g_frames[f].pixel(x, y);
+
+        int fits = 1;
+        clock_t start = clock();
+        for (int p = 0; p < passes; p++) {
+            pal8_reset(&pal);
+            fits = 1;
+            for (int y = 0; y < PLANE_H && fits; y++)
+                fits = pal8_index_row(&pal, g_src + y * PLANE_W, indexed + y * PLANE_W, PLANE_W) == 0;
+        }
+        clock_t ticks = clock() - start;
+
+        int same = 1;
+        if (fits) {
+            for (int y = 0; y < PLANE_H; y++) pal8_expand_row(&pal, indexed + y * PLANE_W, g_fast + y * PLANE_W, PLANE_W);
+            same = memcmp(g_src, g_fast, sizeof(g_src)) == 0;
+        }
+        errors += !same;
+        printf("%-18s %10.3f %7s %10lu  %s\n", g_frames[f].name, msecs(ticks) / passes,
+               fits ? "<=256" : ">256",
+               (unsigned long)(fits ? PLANE_W * PLANE_H + pal.count * 4 : PLANE_W * PLANE_H * 4),
+               same ? (fits ? "OK" : "OK, 32-bit") : "MISMATCH");
+    }
+    return errors;
+}
+
+/* ── 16-bpp frames ─────────────────────────────────────────────────────── */
+
+static uint16_t ref_rgb16(uint32_t c, int x, int y, int format, int dither) {
+    int r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+    int gbits = format == RGB16_565 ? 6 : 5;
+    if (dither) {
+        int t = rgb16_bayer[y & 3][x & 3];
+        r += t * 8 / 16;
+        g += t * (1 << (8 - gbits)) / 16;
+        b += t * 8 / 16;
+        if (r > 255) r = 255;
+        if (g > 255) g = 255;
+        if (b > 255) b = 255;
+    }
+    return (uint16_t)((r >> 3) << (gbits + 5) | (g >> (8 - gbits)) << 5 | b >> 3);
+}
+
+static int bench_rgb16(int passes) {
+    static uint16_t ref[PLANE_W * PLANE_H], fast[PLANE_W * PLANE_H];
+    static const char *names[4] = {"rgb565", "rgb565 dithered", "rgb555", "rgb555 dithered"};
+    int errors = 0;
+
+    for (int y = 0; y < PLANE_H; y++)
+        for (int x = 0; x < PLANE_W; x++)
+            g_src[y * PLANE_W + x] = frame_photo(x, y);
+
+    printf("\n%-18s %10s %10s %7s  %s\n", "conversion", "loop ms", "row ms", "speedup", "check");
+    for (int m = 0; m < 4; m++) {
+        int format = m < 2 ? RGB16_565 : RGB16_555, dither = m & 1;
+
+        clock_t start = clock();
+        for (int p = 0; p < passes; p++)
+            for (int y = 0; y < PLANE_H; y++)
+                for (int x = 0; x < PLANE_W; x++)
+                    ref[y * PLANE_W + x] = ref_rgb16(g_src[y * PLANE_W + x], x, y, format, dither);
+        clock_t ref_ticks = clock() - start;
+
+        /* Odd spans too, as the engine converts changed parts of rows */
+        start = clock();
+        for (int p = 0; p < passes; p++)
+            for (int y = 0; y < PLANE_H; y++) {
+                int split = (y * 7) % PLANE_W;
+                rgb16_row(g_src + y * PLANE_W, fast + y * PLANE_W, 0, split, y, format, dither);
+                rgb16_row(g_src + y * PLANE_W, fast + y * PLANE_W, split, PLANE_W, y, format, dither);
+            }
+        clock_t fast_ticks = clock() - start;
+
+        int same = memcmp(ref, fast, sizeof(ref)) == 0;
+        errors += !same;
+        printf("%-18s %10.1f %10.1f %6.1fx  %s\n", names[m], msecs(ref_ticks), msecs(fast_ticks),
+               fast_ticks ? (double)ref_ticks / fast_ticks : 0.0, same ? "OK" : "MISMATCH");
+    }
+    return errors;
+}
+
+/* ── ADPCM ─────────────────────────────────────────────────────────────── */
+
+#define ADPCM_RATE    44100
+#define ADPCM_FRAMES  ADPCM_RATE    /* not a multiple of any block */
+#define ADPCM_ALIGN   1024          /* per channel */
+#define ADPCM_PI      3.14159265358979
+
+static int clamp16(int v) {
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+/* IMA state after one nibble, step by step as the format describes it */
+static int ref_ima(int *pred, int *index, int n) {
+    int step = wav_ima_steps[*index], diff = step >> 3;
+    if (n & 4) diff += step;
+    if (n & 2) diff += step >> 1;
+    if (n & 1) diff += step >> 2;
+    *pred = clamp16(n & 8 ? *pred - diff : *pred + diff);
+    *index += wav_ima_moves[n & 7];
+    if (*index < 0) *index = 0;
+    if (*index > 88) *index = 88;
+    return *pred;
+}
+
+/* MS state after one nibble */
+static int ref_ms(int *s1, int *s2, int *delta, const int coef[2], int n) {
+    int v = clamp16(((*s1 * coef[0] + *s2 * coef[1]) >> 8) + (n >= 8 ? n - 16 : n) * *delta);
+    *delta = (wav_ms_adapt[n] * *delta) >> 8;
+    if (*delta < 16) *delta = 16;
+    *s2 = *s1;
+    *s1 = v;
+    return v;
+}
+
+/* Every frame of the data, one nibble at a time through the byte stream */
+static void ref_decode(const WavInfo *info, int16_t *dst) {
+    int chans = info->channels;
+    uint32_t done = 0;
+    for (uint32_t at = 0; at < info->size && done < info->frames; at += info->align) {
+        const uint8_t *b = info->data + at;
+        uint32_t len = info->size - at < (uint32_t)info->align ? info->size - at : (uint32_t)info->align;
+        uint32_t first = done;
+        int pred[2], index[2], s1[2], s2[2], delta[2], coef[2][2];
+        if (info->format == WAV_IMA_ADPCM) {
+            for (int ch = 0; ch < chans; ch++) {
+                pred[ch] = (int16_t)(b[ch * 4] | b[ch * 4 + 1] << 8);
+                index[ch] = b[ch * 4 + 2] > 88 ? 88 : b[ch * 4 + 2];
+                dst[done * 2 + ch] = (int16_t)pred[ch];
+            }
+            done++;
+            /* Groups of 8 samples per channel */
+            for (uint32_t g = 4 * chans; g + 4 * chans <= len; g += 4 * chans) {
+                for (int ch = 0; ch < chans; ch++) {
+                    for (int k = 0; k < 8 && done + k < info->frames && done + k - first < (uint32_t)info->blockframes; k++) {
+                        int n = b[g + ch * 4 + k / 2] >> (k % 2 ? 4 : 0) & 15;
+                        dst[(done + k) * 2 + ch] = (int16_t)ref_ima(&pred[ch], &index[ch], n);
+                    }
+                }
+                done += 8;
+                if (done > info->frames) done = info->frames;
+                if (done - first > (uint32_t)info->blockframes) done = first + info->blockframes;
+            }
+        } else {
+            for (int ch = 0; ch < chans; ch++) {
+                int p = b[ch] < info->ncoefs ? b[ch] : info->ncoefs - 1;
+                coef[ch][0] = info->coefs[p][0];
+                coef[ch][1] = info->coefs[p][1];
+                delta[ch] = (int16_t)(b[chans + ch * 2] | b[chans + ch * 2 + 1] << 8);
+                s1[ch] = (int16_t)(b[chans * 3 + ch * 2] | b[chans * 3 + ch * 2 + 1] << 8);
+                s2[ch] = (int16_t)(b[chans * 5 + ch * 2] | b[chans * 5 + ch * 2 + 1] << 8);
+                dst[done * 2 + ch] = (int16_t)s2[ch];
+                dst[done * 2 + 2 + ch] = (int16_t)s1[ch];
+            }
+            done += 2;
+            for (uint32_t i = 7 * chans; i < len && done < info->frames; i++) {
+                int hi = b[i] >> 4, lo = b[i] & 15;
+                if (chans == 2) {
+                    dst[done * 2] = (int16_t)ref_ms(&s1[0], &s2[0], &delta[0], coef[0], hi);
+                    dst[done * 2 + 1] = (int16_t)ref_ms(&s1[1], &s2[1], &delta[1], coef[1], lo);
+                    done++;
+                } else {
+                    dst[done++ * 2] = (int16_t)ref_ms(&s1[0], &s2[0], &delta[0], coef[0], hi);
+                    if (done < info->frames) dst[done++ * 2] = (int16_t)ref_ms(&s1[0], &s2[0], &delta[0], coef[0], lo);
+                }
+            }
+        }
+        if (chans == 1) {
+            for (uint32_t i = first; i < done; i++) dst[i * 2 + 1] = dst[i * 2];
+        }
+    }
+}
+
+/* A chord with vibrato, a little noise and a different phase per channel */
+static int adpcm_sample(uint32_t i, int ch) {
+    double t = (double)i / ADPCM_RATE;
+    double v = sin(2 * ADPCM_PI * 220 * t + ch) * 0.35 + sin(2 * ADPCM_PI * 277.2 * t + 3 * sin(2 * ADPCM_PI * 5 * t)) * 0.25 +
+               sin(2 * ADPCM_PI * 1318.5 * t) * 0.1 * (1 + sin(2 * ADPCM_PI * 0.5 * t));
+    return (int)(v * 32000) + (int)((i * 2654435761u >> 24) & 255) - 128;
+}
+
+/* Nibble for 'x' from IMA state, which is moved on as the decoder would */
+static int enc_ima(int *pred, int *index, int x) {
+    int step = wav_ima_steps[*index], diff = x - *pred, n = 0;
+    if (diff < 0) {
+        n = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { n |= 4; diff -= step; }
+    if (diff >= step >> 1) { n |= 2; diff -= step >> 1; }
+    if (diff >= step >> 2) n |= 1;
+    ref_ima(pred, index, n);
+    return n;
+}
+
+/* One MS block of 'count' frames with predictor 'p'. The header of each
+ * channel starts from the first two samples */
+static void enc_ms_block(const int16_t *pcm, uint32_t count, int chans, int p, uint8_t *out) {
+    int s1[2], s2[2], delta[2];
+    const int *coef = wav_ms_coefs[p];
+    for (int ch = 0; ch < chans; ch++) {
+        s2[ch] = pcm[ch];
+        s1[ch] = count > 1 ? pcm[chans + ch] : 0;
+        delta[ch] = abs(s1[ch] - s2[ch]) / 4;
+        if (delta[ch] < 16) delta[ch] = 16;
+        out[ch] = (uint8_t)p;
+        out[chans + ch * 2] = (uint8_t)delta[ch];
+        out[chans + ch * 2 + 1] = (uint8_t)(delta[ch] >> 8);
+        out[chans * 3 + ch * 2] = (uint8_t)s1[ch];
+        out[chans * 3 + ch * 2 + 1] = (uint8_t)(s1[ch] >> 8);
+        out[chans * 5 + ch * 2] = (uint8_t)s2[ch];
+        out[chans * 5 + ch * 2 + 1] = (uint8_t)(s2[ch] >> 8);
+    }
+    uint8_t *b = out + 7 * chans;
+    uint32_t nibbles = count > 2 ? (count - 2) * chans : 0;
+    for (uint32_t i = 0; i < nibbles || (i & 1); i++) {
+        int ch = chans == 2 ? (int)(i & 1) : 0;
+        int x = i < nibbles ? pcm[(i / chans + 2) * chans + ch] : 0;
+        int pred = (s1[ch] * coef[0] + s2[ch] * coef[1]) >> 8, d = x - pred;
+        int n = (d + (d < 0 ? -delta[ch] / 2 : delta[ch] / 2)) / delta[ch];
+        n = n > 7 ? 7 : n < -8 ? -8 : n;
+        ref_ms(&s1[ch], &s2[ch], &delta[ch], coef, n & 15);
+        if (i & 1) b[i / 2] |= (uint8_t)(n & 15);
+        else b[i / 2] = (uint8_t)((n & 15) << 4);
+    }
+}
+
+static void put_le(uint8_t *p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (uint8_t)(v >> (i * 8));
+}
+
+/* RIFF WAVE of ADPCM_FRAMES frames of 'pcm' in 'format', returns its size */
+static uint32_t adpcm_encode(const int16_t *pcm, int format, int chans, uint8_t *out) {
+    int align = ADPCM_ALIGN * chans, ext = format == WAV_MS_ADPCM ? 4 + 7 * 4 : 2;
+    int spb = format == WAV_MS_ADPCM ? 2 + (align - 7 * chans) * 2 / chans : 1 + (align - 4 * chans) / (4 * chans) * 8;
+    uint8_t *fmt = out + 20, *data = fmt + 18 + ext + 12 + 8;
+    uint32_t size = 0, index[2] = {0, 0};
+
+    for (uint32_t f = 0; f < ADPCM_FRAMES; f += spb) {
+        uint32_t count = ADPCM_FRAMES - f < (uint32_t)spb ? ADPCM_FRAMES - f : (uint32_t)spb;
+        const int16_t *s = pcm + f * chans;
+        uint8_t *b = data + size;
+        if (format == WAV_IMA_ADPCM) {
+            uint32_t groups = (count + 6) / 8;
+            for (int ch = 0; ch < chans; ch++) {
+                int pred = s[ch], idx = (int)index[ch];
+                put_le(b + ch * 4, (uint16_t)pred, 2);
+                b[ch * 4 + 2] = (uint8_t)idx;
+                b[ch * 4 + 3] = 0;
+                for (uint32_t g = 0; g < groups; g++) {
+                    uint8_t *o = b + 4 * chans + g * 4 * chans + ch * 4;
+                    for (int k = 0; k < 8; k++) {
+                        uint32_t i = 1 + g * 8 + k;
+                        int n = enc_ima(&pred, &idx, i < count ? s[i * chans + ch] : pred);
+                        if (k & 1) o[k / 2] |= (uint8_t)(n << 4);
+                        else o[k / 2] = (uint8_t)n;
+                    }
+                }
+                index[ch] = (uint32_t)idx;
+            }
+            size += 4 * chans + groups * 4 * chans;
+        } else {
+            /* Each predictor in turn, so they are all checked */
+            enc_ms_block(s, count, chans, (int)(f / spb) % 7, b);
+            size += 7 * chans + (count > 2 ? ((count - 2) * chans + 1) / 2 : 0);
+        }
+    }
+
+    memcpy(out, "RIFF", 4);
+    memcpy(out + 8, "WAVEfmt ", 8);
+    put_le(out + 16, 18 + ext, 4);
+    put_le(fmt, format, 2);
+    put_le(fmt + 2, chans, 2);
+    put_le(fmt + 4, ADPCM_RATE, 4);
+    put_le(fmt + 8, ADPCM_RATE / spb * align, 4);
+    put_le(fmt + 12, align, 2);
+    put_le(fmt + 14, 4, 2);
+    put_le(fmt + 16, ext, 2);
+    put_le(fmt + 18, spb, 2);
+    if (format == WAV_MS_ADPCM) {
+        put_le(fmt + 20, 7, 2);
+        for (int i = 0; i < 7; i++) {
+            put_le(fmt + 22 + i * 4, (uint16_t)wav_ms_coefs[i][0], 2);
+            put_le(fmt + 24 + i * 4, (uint16_t)wav_ms_coefs[i][1], 2);
+        }
+    }
+    memcpy(data - 20, "fact", 4);
+    put_le(data - 16, 4, 4);
+    put_le(data - 12, ADPCM_FRAMES, 4);
+    memcpy(data - 8, "data", 4);
+    put_le(data - 4, size, 4);
+    put_le(out + 4, (uint32_t)(data - out) - 8 + size, 4);
+    return (uint32_t)(data - out) + size;
+}
+
+static int bench_adpcm(int passes) {
+    static int16_t pcm[ADPCM_FRAMES * 2], ref[ADPCM_FRAMES * 2], fast[ADPCM_FRAMES * 2];
+    static uint8_t file[ADPCM_FRAMES * 2 + 65536];
+    static const char *names[4] = {"ima mono", "ima stereo", "ms mono", "ms stereo"};
+    int errors = 0;
+
+    wav_init();
+    printf("\n%-18s %10s %10s %7s %8s  %s\n", "adpcm", "loop ms", "table ms", "speedup", "SNR dB", "check");
+    for (int m = 0; m < 4; m++) {
+        int format = m < 2 ? WAV_IMA_ADPCM : WAV_MS_ADPCM, chans = 1 + (m & 1);
+        WavInfo info;
+        for (uint32_t i = 0; i < ADPCM_FRAMES; i++)
+            for (int ch = 0; ch < chans; ch++) pcm[i * chans + ch] = (int16_t)clamp16(adpcm_sample(i, ch));
+        uint32_t size = adpcm_encode(pcm, format, chans, file);
+        int usable = wav_info(file, size, &info) == 0 && wav_decodable(&info) && info.frames == ADPCM_FRAMES;
+        memset(ref, 0, sizeof(ref));
+        memset(fast, 0, sizeof(fast));
+
+        clock_t start = clock();
+        for (int p = 0; p < passes && usable; p++) ref_decode(&info, ref);
+        clock_t ref_ticks = clock() - start;
+
+        start = clock();
+        for (int p = 0; p < passes && usable; p++) wav_decode(&info, fast);
+        clock_t fast_ticks = clock() - start;
+
+        /* Mono comes out on both sides */
+        double signal = 0, noise = 0;
+        for (uint32_t i = 0; i < ADPCM_FRAMES * 2; i++) {
+            int x = pcm[chans == 2 ? i : i / 2];
+            signal += (double)x * x;
+            noise += (double)(fast[i] - x) * (fast[i] - x);
+        }
+        double snr = noise > 0 ? 10 * log10(signal / noise) : 99.0;
+        int same = usable && memcmp(ref, fast, sizeof(ref)) == 0 && snr > 20;
+        errors += !same;
+        printf("%-18s %10.1f %10.1f %6.1fx %8.1f  %s\n", names[m], msecs(ref_ticks), msecs(fast_ticks),
+               fast_ticks ? (double)ref_ticks / fast_ticks : 0.0, snr, same ? "OK" : "MISMATCH");
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int passes = 200;
+    if (argc == 3 && strcmp(argv[1], "-n") == 0) {
+        passes = atoi(argv[2]);
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: w3bench [-n passes]\n");
+        return 1;
+    }
+    if (passes < 1) passes = 1;
+
+    printf("%-18s %10s %10s %7s  %s\n", "primitive", "loop ms", "draw ms", "speedup", "check");
+
+    int errors = 0;
+    for (size_t b = 0; b < sizeof(g_benches) / sizeof(g_benches[0]); b++) {
+        memset(g_ref, 0, sizeof(g_ref));
+        memset(g_fast, 0, sizeof(g_fast));
+
+        clock_t start = clock();
+        for (int p = 0; p < passes; p++) g_benches[b].run(0, p);
+        clock_t ref_ticks = clock() - start;
+
+        start = clock();
+        for (int p = 0; p < passes; p++) g_benches[b].run(1, p);
+        clock_t fast_ticks = clock() - start;
+
+        int same = memcmp(g_ref, g_fast, sizeof(g_ref)) == 0;
+        errors += !same;
+        printf("%-18s %10.1f %10.1f %6.1fx  %s\n", g_benches[b].name, msecs(ref_ticks), msecs(fast_ticks),
+               fast_ticks ? (double)ref_ticks / fast_ticks : 0.0, same ? "OK" : "MISMATCH");
+    }
+    errors += bench_index(passes);
+    errors += bench_rgb16(passes);
+    errors += bench_adpcm(passes);
+    return errors ? 1 : 0;
+}
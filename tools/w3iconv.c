@@ -0,0 +1,474 @@
+/*
+ *      w3iconv - .w3i image converter for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3iconv in.png out.w3i         convert a PNG, PI3 or STVN sprite
+ *      w3iconv -m [-s N] in.png out.w3m
+ *                                     cut a background of any size into
+ *                                     NxN tiles (64 by default) for 'O' pans
+ *      w3iconv -b [-n N] files...     decode benchmark, libpng against w3i
+ *
+ *      PI3 and sprites may be gzipped. PI3 keeps its first 320 lines, as the
+ *      engine does. Colors of fully transparent pixels aren't kept, they are
+ *      never drawn. See src/w3i.h and src/w3m.h for the layouts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <zlib.h>
+#include <png.h>
+
+#include "../src/w3i.h"
+#include "../src/w3m.h"
+
+typedef struct {
+    int width, height, flags;
+    uint32_t *pixels;           /* 0xAARRGGBB */
+} Image;
+
+typedef struct {
+    const uint8_t *data;
+    size_t left;
+} MemReader;
+
+/* Whole file, inflated if gzipped (gzread passes other files through) */
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    gzFile gz = gzopen(path, "rb");
+    uint32_t cap = 65536, len = 0;
+    uint8_t *buf = (uint8_t *)malloc(cap);
+    int got;
+    if (!gz || !buf) {
+        if (gz) gzclose(gz);
+        free(buf);
+        return NULL;
+    }
+    while ((got = gzread(gz, buf + len, cap - len)) > 0) {
+        len += got;
+        if (len == cap) {
+            uint8_t *grown = (uint8_t *)realloc(buf, cap * 2);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    gzclose(gz);
+    *size = len;
+    return buf;
+}
+
+static void png_read_mem(png_structp png, png_bytep out, png_size_t len) {
+    MemReader *rd = (MemReader *)png_get_io_ptr(png);
+    if (len > rd->left) png_error(png, "Truncated PNG");
+    memcpy(out, rd->data, len);
+    rd->data += len;
+    rd->left -= len;
+}
+
+/* PNG to BGRA, with the engine's transforms */
+static int decode_png(const uint8_t *data, uint32_t size, Image *img) {
+    MemReader reader = { data, size };
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    uint32_t *volatile pixels = NULL;
+    png_bytep *volatile rows = NULL;
+
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return -1;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        free(rows);
+        free(pixels);
+        return -1;
+    }
+    png_set_read_fn(png, &reader, png_read_mem);
+    png_read_info(png, info);
+
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    png_byte color_type = png_get_color_type(png, info);
+    png_byte bit_depth = png_get_bit_depth(png, info);
+    if (bit_depth == 16) png_set_strip_16(png);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (png_get_valid(png, info, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png);
+    if (!(color_type & PNG_COLOR_MASK_ALPHA)) png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+    png_set_bgr(png);
+    png_read_update_info(png, info);
+
+    pixels = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    rows = (png_bytep *)malloc(sizeof(png_bytep) * height);
+    if (!pixels || !rows) png_error(png, "Out of memory");
+    for (png_uint_32 y = 0; y < height; y++) rows[y] = (png_bytep)(pixels + (size_t)y * width);
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    free(rows);
+
+    img->width = (int)width;
+    img->height = (int)height;
+    img->flags = 0;
+    img->pixels = pixels;
+    return 0;
+}
+
+/* Monochrome PI3, first 320 of its 400 lines */
+static int decode_pi3(const uint8_t *data, uint32_t size, Image *img) {
+    img->width = 640;
+    img->height = 320;
+    img->flags = 0;
+    img->pixels = (uint32_t *)malloc(640 * 320 * sizeof(uint32_t));
+    if (!img->pixels) return -1;
+    for (int i = 0; i < 640 * 320; i++) {
+        uint32_t pos = 34 + i / 8;
+        int bit = pos < size ? (data[pos] >> (7 - i % 8)) & 1 : 0;
+        img->pixels[i] = bit ? 0xFF000000 : 0xFFFFFFFF;
+    }
+    return 0;
+}
+
+/* STVN text sprite: '0' white, '1' black, ' ' transparent */
+static int decode_spr(const uint8_t *data, uint32_t size, Image *img) {
+    int width = 0, height = 1, x = 0, y = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (data[i] == 10) {
+            height++;
+            x = 0;
+        } else if (data[i] == ' ' || data[i] == '0' || data[i] == '1') {
+            if (++x > width) width = x;
+        }
+    }
+    if (width == 0) return -1;
+    img->width = width;
+    img->height = height;
+    img->flags = W3I_LEGACY;
+    img->pixels = (uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+    if (!img->pixels) return -1;
+    x = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (data[i] == 10) {
+            y++;
+            x = 0;
+        } else if (data[i] == ' ') {
+            x++;
+        } else if (data[i] == '0' || data[i] == '1') {
+            img->pixels[y * width + x++] = data[i] == '1' ? 0xFF000000 : 0xFFFFFFFF;
+        }
+    }
+    return 0;
+}
+
+static int is_spr(const uint8_t *data, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        if (!strchr(" 01\r\n", data[i]) || data[i] == 0) return 0;
+    }
+    return size > 0;
+}
+
+static int load_image(const char *path, Image *img) {
+    static const uint8_t png_sig[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    uint32_t size;
+    int ret;
+    uint8_t *data = read_file(path, &size);
+    if (!data) return -1;
+    if (size >= 8 && memcmp(data, png_sig, 8) == 0) ret = decode_png(data, size, img);
+    else if (is_spr(data, size)) ret = decode_spr(data, size, img);
+    else if (size >= 34) ret = decode_pi3(data, size, img);
+    else ret = -1;
+    free(data);
+    return ret;
+}
+
+/* Encode an image, NULL on failure */
+static uint8_t *encode(const Image *img, uint32_t *outsize) {
+    uint32_t count = (uint32_t)img->width * img->height;
+    uint8_t *out = (uint8_t *)malloc(W3I_HEADER_SIZE + (size_t)count * 5 + count / 128 + 16);
+    uint32_t recent[64];
+    uint32_t prev = 0xff000000;
+    uint32_t pos = W3I_HEADER_SIZE;
+    int flags = img->flags, run = 0;
+    if (!out || img->width > 65535 || img->height > 65535) {
+        free(out);
+        return NULL;
+    }
+    memset(recent, 0, sizeof(recent));
+    for (uint32_t i = 0; i < count; i++) {
+        if ((img->pixels[i] >> 24) != 0xff) flags |= W3I_ALPHA;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t px = img->pixels[i] | 0xff000000;
+        /* Invisible pixels continue the previous color */
+        if ((flags & W3I_ALPHA) && (img->pixels[i] >> 24) == 0) px = prev;
+
+        if (px == prev) {
+            if (++run == 62) {
+                out[pos++] = W3I_OP_RUN | (run - 1);
+                run = 0;
+            }
+        } else {
+            if (run > 0) {
+                out[pos++] = W3I_OP_RUN | (run - 1);
+                run = 0;
+            }
+            int idx = W3I_HASH(px);
+            if (recent[idx] == px) {
+                out[pos++] = W3I_OP_INDEX | idx;
+            } else {
+                int dr = (int8_t)((px >> 16) - (prev >> 16));
+                int dg = (int8_t)((px >> 8) - (prev >> 8));
+                int db = (int8_t)(px - prev);
+                int dr_dg = dr - dg, db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out[pos++] = W3I_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    out[pos++] = W3I_OP_LUMA | (dg + 32);
+                    out[pos++] = ((dr_dg + 8) << 4) | (db_dg + 8);
+                } else {
+                    out[pos++] = W3I_OP_RGB;
+                    out[pos++] = (uint8_t)px;
+                    out[pos++] = (uint8_t)(px >> 8);
+                    out[pos++] = (uint8_t)(px >> 16);
+                }
+            }
+        }
+        /* Same table updates as the decoder */
+        recent[W3I_HASH(px)] = px;
+        prev = px;
+    }
+    if (run > 0) out[pos++] = W3I_OP_RUN | (run - 1);
+    uint32_t color_size = pos - W3I_HEADER_SIZE;
+
+    /* Alpha plane: runs of 3+ equal bytes, literals in between */
+    if (flags & W3I_ALPHA) {
+        uint32_t i = 0, lit = 0;
+        while (i < count) {
+            uint8_t a = img->pixels[i] >> 24;
+            uint32_t n = 1;
+            while (i + n < count && n < 130 && (img->pixels[i + n] >> 24) == a) n++;
+            if (n >= 3) {
+                out[pos++] = 0x80 | (n - 3);
+                out[pos++] = a;
+                i += n;
+                continue;
+            }
+            /* Gather literals until the next run of 3 */
+            lit = 0;
+            while (i + lit < count && lit < 128) {
+                uint8_t b = img->pixels[i + lit] >> 24;
+                if (i + lit + 2 < count && (img->pixels[i + lit + 1] >> 24) == b &&
+                    (img->pixels[i + lit + 2] >> 24) == b) break;
+                lit++;
+            }
+            out[pos++] = (uint8_t)(lit - 1);
+            for (uint32_t k = 0; k < lit; k++) out[pos++] = img->pixels[i + k] >> 24;
+            i += lit;
+        }
+    }
+
+    memcpy(out, W3I_MAGIC, 4);
+    out[4] = (uint8_t)img->width;
+    out[5] = (uint8_t)(img->width >> 8);
+    out[6] = (uint8_t)img->height;
+    out[7] = (uint8_t)(img->height >> 8);
+    out[8] = (uint8_t)flags;
+    out[9] = out[10] = out[11] = 0;
+    out[12] = (uint8_t)color_size;
+    out[13] = (uint8_t)(color_size >> 8);
+    out[14] = (uint8_t)(color_size >> 16);
+    out[15] = (uint8_t)(color_size >> 24);
+    *outsize = pos;
+    return out;
+}
+
+/* Encode, then decode again and compare the visible pixels */
+static int verify(const Image *img, const uint8_t *w3i, uint32_t size) {
+    uint32_t count = (uint32_t)img->width * img->height;
+    uint32_t *check = (uint32_t *)malloc(count * sizeof(uint32_t));
+    int ok = check && w3i_decode(w3i, size, check, img->width, img->width, img->height) == 0;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        uint32_t src = img->pixels[i];
+        if ((src >> 24) == 0) ok = (check[i] >> 24) == 0;
+        else ok = check[i] == src;
+    }
+    free(check);
+    return ok;
+}
+
+static int convert(const char *in, const char *out) {
+    Image img;
+    uint32_t size;
+    if (load_image(in, &img) != 0) {
+        fprintf(stderr, "%s: unsupported or unreadable image\n", in);
+        return 1;
+    }
+    uint8_t *w3i = encode(&img, &size);
+    if (!w3i || !verify(&img, w3i, size)) {
+        fprintf(stderr, "%s: encoding failed\n", in);
+        return 1;
+    }
+    FILE *fp = fopen(out, "wb");
+    if (!fp || fwrite(w3i, 1, size, fp) != size || fclose(fp) != 0) {
+        fprintf(stderr, "%s: write error\n", out);
+        return 1;
+    }
+    printf("%s: %dx%d%s, %lu bytes\n", out, img.width, img.height,
+           (w3i[8] & W3I_ALPHA) ? " with alpha" : "", (unsigned long)size);
+    free(w3i);
+    free(img.pixels);
+    return 0;
+}
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+/* Tiled background: every tile a W3I image, opaque like backgrounds */
+static int convert_map(const char *in, const char *out, int size) {
+    Image img;
+    if (load_image(in, &img) != 0) {
+        fprintf(stderr, "%s: unsupported or unreadable image\n", in);
+        return 1;
+    }
+    if (img.width > 65535 || img.height > 65535) {
+        fprintf(stderr, "%s: too large\n", in);
+        return 1;
+    }
+    int cols = (img.width + size - 1) / size, rows = (img.height + size - 1) / size;
+    uint32_t index_size = (uint32_t)cols * rows * W3M_ENTRY_SIZE;
+    uint8_t *head = (uint8_t *)calloc(W3M_HEADER_SIZE + index_size, 1);
+    uint32_t *pixels = (uint32_t *)malloc((size_t)size * size * sizeof(uint32_t));
+    FILE *fp = fopen(out, "wb");
+    if (!head || !pixels || !fp) {
+        fprintf(stderr, "%s: can't write\n", out);
+        return 1;
+    }
+
+    memcpy(head, W3M_MAGIC, 4);
+    put16(head + 4, img.width);
+    put16(head + 6, img.height);
+    put16(head + 8, size);
+    put16(head + 10, cols);
+    put16(head + 12, rows);
+    fwrite(head, 1, W3M_HEADER_SIZE + index_size, fp);
+
+    uint32_t offset = W3M_HEADER_SIZE + index_size;
+    for (int i = 0; i < cols * rows; i++) {
+        Image tile;
+        uint32_t len;
+        tile.width = w3m_span(img.width, size, i % cols);
+        tile.height = w3m_span(img.height, size, i / cols);
+        tile.flags = 0;
+        tile.pixels = pixels;
+        for (int y = 0; y < tile.height; y++) {
+            const uint32_t *src = img.pixels + (size_t)((i / cols) * size + y) * img.width + (i % cols) * size;
+            for (int x = 0; x < tile.width; x++) pixels[y * tile.width + x] = src[x] | 0xff000000;
+        }
+        uint8_t *w3i = encode(&tile, &len);
+        if (!w3i || !verify(&tile, w3i, len)) {
+            fprintf(stderr, "%s: encoding failed\n", in);
+            fclose(fp);
+            return 1;
+        }
+        fwrite(w3i, 1, len, fp);
+        put32(head + W3M_HEADER_SIZE + i * W3M_ENTRY_SIZE, offset);
+        put32(head + W3M_HEADER_SIZE + i * W3M_ENTRY_SIZE + 4, len);
+        offset += len;
+        free(w3i);
+    }
+    fseek(fp, 0, SEEK_SET);
+    fwrite(head, 1, W3M_HEADER_SIZE + index_size, fp);
+    if (ferror(fp) | fclose(fp)) {
+        fprintf(stderr, "%s: write error\n", out);
+        return 1;
+    }
+    printf("%s: %dx%d in %dx%d tiles of %d, %lu bytes\n", out, img.width, img.height,
+           cols, rows, size, (unsigned long)offset);
+    free(head);
+    free(pixels);
+    free(img.pixels);
+    return 0;
+}
+
+static double mpix_per_sec(clock_t ticks, int runs, const Image *img) {
+    double secs = (double)ticks / CLOCKS_PER_SEC;
+    if (secs <= 0) secs = 1.0 / CLOCKS_PER_SEC;
+    return (double)img->width * img->height * runs / secs / 1e6;
+}
+
+/* Decode every PNG 'runs' times with libpng, then its w3i version */
+static int benchmark(char **files, int nfiles, int runs) {
+    printf("%-24s %9s %9s %10s %10s\n", "file", "png", "w3i", "png Mpx/s", "w3i Mpx/s");
+    for (int f = 0; f < nfiles; f++) {
+        uint32_t size, w3isize;
+        Image img;
+        uint8_t *data = read_file(files[f], &size);
+        if (!data || decode_png(data, size, &img) != 0) {
+            fprintf(stderr, "%s: not a PNG\n", files[f]);
+            free(data);
+            continue;
+        }
+        uint8_t *w3i = encode(&img, &w3isize);
+        uint32_t *dst = (uint32_t *)malloc((size_t)img.width * img.height * sizeof(uint32_t));
+        if (!w3i || !dst) return 1;
+
+        clock_t start = clock();
+        for (int r = 0; r < runs; r++) {
+            Image tmp;
+            if (decode_png(data, size, &tmp) == 0) free(tmp.pixels);
+        }
+        clock_t png_ticks = clock() - start;
+
+        start = clock();
+        for (int r = 0; r < runs; r++) {
+            w3i_decode(w3i, w3isize, dst, img.width, img.width, img.height);
+        }
+        clock_t w3i_ticks = clock() - start;
+
+        printf("%-24s %9lu %9lu %10.1f %10.1f\n", files[f], (unsigned long)size,
+               (unsigned long)w3isize, mpix_per_sec(png_ticks, runs, &img),
+               mpix_per_sec(w3i_ticks, runs, &img));
+        free(dst);
+        free(w3i);
+        free(img.pixels);
+        free(data);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "-b") == 0) {
+        int runs = 20, first = 2;
+        if (argc >= 5 && strcmp(argv[2], "-n") == 0) {
+            runs = atoi(argv[3]);
+            first = 4;
+        }
+        if (runs < 1) runs = 1;
+        return benchmark(argv + first, argc - first, runs);
+    }
+    if (argc >= 4 && strcmp(argv[1], "-m") == 0) {
+        int size = W3M_TILE, first = 2;
+        if (argc == 6 && strcmp(argv[2], "-s") == 0) {
+            size = atoi(argv[3]);
+            first = 4;
+        }
+        if (argc == first + 2 && size >= 8 && size <= 1024) return convert_map(argv[first], argv[first + 1], size);
+    }
+    if (argc == 3 && argv[1][0] != '-') return convert(argv[1], argv[2]);
+
+    fprintf(stderr, "usage: w3iconv image out.w3i\n"
+                    "       w3iconv -m [-s tile] image out.w3m\n"
+                    "       w3iconv -b [-n runs] image.png...\n");
+    return 1;
+}
@@ -0,0 +1,290 @@
+/*
+ *      w3pack - .w3p asset archive packer for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3pack data.w3p data     pack every file under 'data' into data.w3p
+ *      w3pack -l data.w3p       list entries
+ *      w3pack -t data.w3p       test every entry (inflate + crc32)
+ *
+ *      Entries are deflated at level 9 and stored as is when that doesn't
+ *      save anything (PNG, gzip, ADPCM...). WAV files are always stored, so
+ *      that music can be streamed from the archive. See src/w3p.h for the
+ *      layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef __WATCOMC__
+#include <direct.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "../src/w3p.h"
+
+typedef struct {
+    char *name;         /* relative to the packed directory, lowercased */
+    char *path;         /* path on disk */
+} PackFile;
+
+static PackFile *g_files = NULL;
+static long g_fileCount = 0;
+static long g_fileCap = 0;
+
+static void add_file(const char *path, const char *name) {
+    if (g_fileCount == g_fileCap) {
+        g_fileCap = g_fileCap ? g_fileCap * 2 : 256;
+        g_files = (PackFile *)realloc(g_files, g_fileCap * sizeof(PackFile));
+        if (!g_files) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    PackFile *f = &g_files[g_fileCount++];
+    f->path = (char *)malloc(strlen(path) + 1);
+    f->name = (char *)malloc(strlen(name) + 1);
+    strcpy(f->path, path);
+    for (int i = 0; ; i++) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c == '/') c = '\\';
+        f->name[i] = c;
+        if (!c) break;
+    }
+}
+
+/* Collect regular files under dir, 'prefix' being their archive name prefix */
+static void scan_dir(const char *dir, const char *prefix) {
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    if (!d) return;
+    while ((de = readdir(d)) != NULL) {
+        char path[520], name[520];
+        struct stat st;
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        snprintf(name, sizeof(name), "%s%s", prefix, de->d_name);
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            strcat(name, "\\");
+            scan_dir(path, name);
+        } else if (S_ISREG(st.st_mode)) {
+            if (strlen(name) > 250) {
+                fprintf(stderr, "skipping %s: name too long\n", path);
+                continue;
+            }
+            add_file(path, name);
+        }
+    }
+    closedir(d);
+}
+
+static int cmp_files(const void *a, const void *b) {
+    return strcmp(((const PackFile *)a)->name, ((const PackFile *)b)->name);
+}
+
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = (uint8_t *)malloc(len > 0 ? len : 1);
+    if (buf && (long)fread(buf, 1, len, fp) != len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+/* Raw deflate at level 9, NULL if it doesn't make the entry smaller */
+static uint8_t *deflate_entry(const uint8_t *src, uint32_t size, uint32_t *packed) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, 9, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) return NULL;
+
+    uLong bound = deflateBound(&zs, size);
+    uint8_t *out = (uint8_t *)malloc(bound);
+    if (!out) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+    zs.next_in = (Bytef *)src;
+    zs.avail_in = size;
+    zs.next_out = out;
+    zs.avail_out = (uInt)bound;
+    int ret = deflate(&zs, Z_FINISH);
+    *packed = (uint32_t)zs.total_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END || *packed >= size) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+static int pack(const char *archive, const char *dir) {
+    scan_dir(dir, "");
+    if (g_fileCount == 0) {
+        fprintf(stderr, "%s: no files\n", dir);
+        return 1;
+    }
+    qsort(g_files, g_fileCount, sizeof(PackFile), cmp_files);
+
+    FILE *out = fopen(archive, "wb");
+    if (!out) {
+        perror(archive);
+        return 1;
+    }
+
+    uint8_t header[W3P_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    fwrite(header, 1, sizeof(header), out);
+
+    size_t dir_cap = g_fileCount * (W3P_RECORD_SIZE + 256);
+    uint8_t *directory = (uint8_t *)malloc(dir_cap);
+    uint32_t dir_size = 0;
+    uint32_t offset = W3P_HEADER_SIZE;
+    uint32_t total_raw = 0;
+    if (!directory) {
+        fclose(out);
+        return 1;
+    }
+
+    for (long i = 0; i < g_fileCount; i++) {
+        uint32_t size, packed = 0;
+        uint8_t *data = read_file(g_files[i].path, &size);
+        if (!data) {
+            fprintf(stderr, "%s: read error\n", g_files[i].path);
+            fclose(out);
+            return 1;
+        }
+        int wave = size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0;
+        uint8_t *zdata = wave ? NULL : deflate_entry(data, size, &packed);
+        uint8_t *rec = directory + dir_size;
+        uint16_t namelen = (uint16_t)strlen(g_files[i].name);
+
+        w3p_put32(rec, offset);
+        w3p_put32(rec + 4, zdata ? packed : size);
+        w3p_put32(rec + 8, size);
+        w3p_put32(rec + 12, (uint32_t)crc32(0L, data, size));
+        rec[16] = zdata ? W3P_DEFLATE : W3P_STORED;
+        rec[17] = (uint8_t)w3p_sniff(data, size);
+        w3p_put16(rec + 18, namelen);
+        memcpy(rec + W3P_RECORD_SIZE, g_files[i].name, namelen);
+        dir_size += W3P_RECORD_SIZE + namelen;
+
+        if (zdata) {
+            fwrite(zdata, 1, packed, out);
+            offset += packed;
+        } else {
+            fwrite(data, 1, size, out);
+            offset += size;
+        }
+        total_raw += size;
+        printf("%-40s %9lu -> %9lu\n", g_files[i].name, (unsigned long)size,
+               (unsigned long)(zdata ? packed : size));
+        free(zdata);
+        free(data);
+    }
+
+    fwrite(directory, 1, dir_size, out);
+    memcpy(header, W3P_MAGIC, 4);
+    w3p_put32(header + 4, (uint32_t)g_fileCount);
+    w3p_put32(header + 8, offset);
+    w3p_put32(header + 12, dir_size);
+    fseek(out, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), out);
+    free(directory);
+
+    if (ferror(out) | fclose(out)) {
+        fprintf(stderr, "%s: write error\n", archive);
+        return 1;
+    }
+    printf("%ld files, %lu bytes packed into %lu\n", g_fileCount,
+           (unsigned long)total_raw, (unsigned long)(offset + dir_size));
+    return 0;
+}
+
+/* List or test an archive */
+static int inspect(const char *archive, int test) {
+    static const char *formats[] = {"raw", "png", "gzip", "w3i", "w3s", "ani", "w3m", "w3v"};
+    uint32_t size;
+    uint8_t *buf = read_file(archive, &size);
+    int errors = 0;
+
+    if (!buf || size < W3P_HEADER_SIZE || memcmp(buf, W3P_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a w3p archive\n", archive);
+        return 1;
+    }
+    uint32_t count = w3p_get32(buf + 4);
+    uint32_t pos = w3p_get32(buf + 8);
+    uint32_t end = pos + w3p_get32(buf + 12);
+    if (end > size || end < pos) {
+        fprintf(stderr, "%s: bad directory\n", archive);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count && pos + W3P_RECORD_SIZE <= end; i++) {
+        const uint8_t *rec = buf + pos;
+        uint32_t offset = w3p_get32(rec);
+        uint32_t packed = w3p_get32(rec + 4);
+        uint32_t rawsize = w3p_get32(rec + 8);
+        uint32_t crc = w3p_get32(rec + 12);
+        uint16_t namelen = w3p_get16(rec + 18);
+        const char *status = "";
+        pos += W3P_RECORD_SIZE + namelen;
+
+        if (test) {
+            uint8_t *raw = (uint8_t *)malloc(rawsize ? rawsize : 1);
+            int ok = raw && offset <= size && packed <= size - offset;
+            if (ok && rec[16] == W3P_STORED) {
+                ok = packed == rawsize;
+                if (ok) memcpy(raw, buf + offset, rawsize);
+            } else if (ok && rec[16] == W3P_DEFLATE) {
+                uLongf len = rawsize;
+                z_stream zs;
+                memset(&zs, 0, sizeof(zs));
+                ok = inflateInit2(&zs, -MAX_WBITS) == Z_OK;
+                if (ok) {
+                    zs.next_in = (Bytef *)(buf + offset);
+                    zs.avail_in = packed;
+                    zs.next_out = raw;
+                    zs.avail_out = rawsize;
+                    ok = inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == len;
+                    inflateEnd(&zs);
+                }
+            } else {
+                ok = 0;
+            }
+            ok = ok && crc32(0L, raw, rawsize) == crc;
+            status = ok ? "  OK" : "  FAILED";
+            errors += !ok;
+            free(raw);
+        }
+        printf("%-40.*s %9lu %9lu %-7s %-4s%s\n", namelen, (const char *)rec + W3P_RECORD_SIZE,
+               (unsigned long)rawsize, (unsigned long)packed,
+               rec[16] == W3P_DEFLATE ? "deflate" : "stored",
+               rec[17] <= W3P_FMT_W3V ? formats[rec[17]] : "?", status);
+    }
+    free(buf);
+    if (test) printf("%d error(s)\n", errors);
+    return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "-l") == 0) return inspect(argv[2], 0);
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) return inspect(argv[2], 1);
+    if (argc == 3 && argv[1][0] != '-') return pack(argv[1], argv[2]);
+
+    fprintf(stderr, "usage: w3pack archive.w3p datadir\n"
+                    "       w3pack -l archive.w3p\n"
+                    "       w3pack -t archive.w3p\n");
+    return 1;
+}
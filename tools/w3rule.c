@@ -0,0 +1,150 @@
+/*
+ *      w3rule - transition rule images for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3rule NN out.png               write the map of effect XNN (01-40)
+ *                                      as a rule image, to start a new one
+ *      w3rule -b [-f ms] [rule.png...] playback benchmark: pixels touched
+ *                                      per frame, at one frame every 'ms'
+ *                                      (15 by default, as the engine)
+ *
+ *      Rule images are 640x320 grayscale (or color, read as luma), dark
+ *      pixels are covered first. See src/w3t.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <png.h>
+
+#include "../src/w3t.h"
+
+#define RULE_WIDTH   640
+#define RULE_HEIGHT  320
+#define RULE_PIXELS  (RULE_WIDTH * RULE_HEIGHT)
+#define RULE_MS      1000       /* duration used for rule images */
+
+static const char *g_stockNames[W3T_STOCK_COUNT] = {
+    "vwipe down", "vwipe up", "vwipe mid in", "vwipe mid out",
+    "hwipe right", "hwipe left", "hwipe mid in", "hwipe mid out",
+    "circle out", "circle in"
+};
+
+static int write_rule(int effect, const char *path) {
+    png_image image;
+    uint8_t *map = (uint8_t *)malloc(RULE_PIXELS);
+    if (!map || w3t_build((effect - 1) / 4, map, RULE_WIDTH, RULE_HEIGHT) != 0) {
+        free(map);
+        return 1;
+    }
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = RULE_WIDTH;
+    image.height = RULE_HEIGHT;
+    image.format = PNG_FORMAT_GRAY;
+    int ok = png_image_write_to_file(&image, path, 0, map, RULE_WIDTH, NULL);
+    free(map);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", path, image.message);
+        return 1;
+    }
+    return 0;
+}
+
+/* Rule image to a map, through the engine's luma */
+static int read_rule(const char *path, uint8_t *map) {
+    png_image image;
+    uint32_t *px = (uint32_t *)malloc(RULE_PIXELS * sizeof(uint32_t));
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!px || !png_image_begin_read_from_file(&image, path)) {
+        free(px);
+        return -1;
+    }
+    if (image.width != RULE_WIDTH || image.height < RULE_HEIGHT) {
+        png_image_free(&image);
+        free(px);
+        return -1;
+    }
+    image.height = RULE_HEIGHT;
+    image.format = PNG_FORMAT_BGRA;
+    int ok = png_image_finish_read(&image, NULL, px, 0, NULL);
+    if (ok) w3t_from_image(px, map, RULE_PIXELS);
+    free(px);
+    return ok ? 0 : -1;
+}
+
+/* Play a map at one frame every 'frame_ms' and report what each frame fills */
+static int bench_map(const char *name, const uint8_t *map, uint32_t duration, int frame_ms) {
+    static uint32_t screen[RULE_PIXELS];
+    W3tPlan plan;
+    uint32_t frames = 0, total = 0, most = 0;
+    const int runs = 50;
+
+    if (w3t_plan(map, RULE_WIDTH, RULE_HEIGHT, &plan) != 0) return -1;
+    for (uint32_t t = 0, done = 0; done < W3T_LEVELS; t += frame_ms) {
+        int level = w3t_level(t, duration);
+        if (level > (int)done) {
+            uint32_t n = w3t_fill(&plan, done, level, screen, frames);
+            frames++;
+            total += n;
+            if (n > most) most = n;
+            done = level;
+        }
+    }
+
+    clock_t start = clock();
+    for (int r = 0; r < runs; r++) {
+        w3t_fill(&plan, 0, W3T_LEVELS, screen, r);
+    }
+    double usecs = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / runs;
+
+    printf("%-20s %5lu %6lu %6lu %10lu %10lu %8.0f\n", name, (unsigned long)duration,
+           (unsigned long)frames, (unsigned long)plan.start[W3T_LEVELS],
+           (unsigned long)(frames ? total / frames : 0), (unsigned long)most, usecs);
+    free(plan.runs);
+    return 0;
+}
+
+static int benchmark(char **files, int nfiles, int frame_ms) {
+    uint8_t *map = (uint8_t *)malloc(RULE_PIXELS);
+    if (!map) return 1;
+    printf("%-20s %5s %6s %6s %10s %10s %8s\n", "transition", "ms", "frames", "runs",
+           "avg px/fr", "max px/fr", "fill us");
+    for (int k = 0; k < W3T_STOCK_COUNT; k++) {
+        w3t_build(k, map, RULE_WIDTH, RULE_HEIGHT);
+        bench_map(g_stockNames[k], map, w3t_stock_ms[k], frame_ms);
+    }
+    for (int f = 0; f < nfiles; f++) {
+        if (read_rule(files[f], map) != 0) {
+            fprintf(stderr, "%s: not a %dx%d PNG\n", files[f], RULE_WIDTH, RULE_HEIGHT);
+            continue;
+        }
+        bench_map(files[f], map, RULE_MS, frame_ms);
+    }
+    printf("a full redraw is %d px per frame\n", RULE_PIXELS);
+    free(map);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+        int frame_ms = 15, first = 2;
+        if (argc >= 4 && strcmp(argv[2], "-f") == 0) {
+            frame_ms = atoi(argv[3]);
+            first = 4;
+        }
+        if (frame_ms < 1) frame_ms = 1;
+        return benchmark(argv + first, argc - first, frame_ms);
+    }
+    if (argc == 3 && argv[1][0] != '-') {
+        int effect = atoi(argv[1]);
+        if (effect >= 1 && effect <= 40) return write_rule(effect, argv[2]);
+    }
+
+    fprintf(stderr, "usage: w3rule NN out.png\n"
+                    "       w3rule -b [-f ms] [rule.png...]\n");
+    return 1;
+}
@@ -0,0 +1,351 @@
+/*
+ *      w3sconv - .w3s run-length sprite converter for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3sconv [-t alpha] in out.w3s
+ *
+ *      'in' is an XPM picture, an STVN text sprite (optionally gzipped) or a
+ *      PNG. PNG pixels are opaque from 'alpha' (default 128) up, XPM "None"
+ *      pixels are transparent, and opaque pixels darker than mid-grey become
+ *      black, the others white. See src/w3s.h for the layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <png.h>
+
+#include "../src/w3s.h"
+
+#define PX_CLEAR  -1
+#define PX_WHITE   0
+#define PX_BLACK   1
+
+typedef struct {
+    int width, height, flags;
+    signed char *px;            /* PX_* per pixel */
+} Mask;
+
+typedef struct {
+    const uint8_t *data;
+    size_t left;
+} MemReader;
+
+/* Whole file, inflated if gzipped */
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    gzFile gz = gzopen(path, "rb");
+    uint32_t cap = 65536, len = 0;
+    uint8_t *buf = (uint8_t *)malloc(cap + 1);
+    int got;
+    if (!gz || !buf) {
+        if (gz) gzclose(gz);
+        free(buf);
+        return NULL;
+    }
+    while ((got = gzread(gz, buf + len, cap - len)) > 0) {
+        len += got;
+        if (len == cap) {
+            uint8_t *grown = (uint8_t *)realloc(buf, cap * 2 + 1);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    gzclose(gz);
+    buf[len] = 0;
+    *size = len;
+    return buf;
+}
+
+static int mask_alloc(Mask *m, int width, int height, int flags) {
+    m->width = width;
+    m->height = height;
+    m->flags = flags;
+    m->px = (signed char *)malloc((size_t)width * height + 1);
+    if (!m->px) return -1;
+    memset(m->px, PX_CLEAR, (size_t)width * height);
+    return 0;
+}
+
+static int shade(int r, int g, int b) {
+    return (r * 299 + g * 587 + b * 114) / 1000 < 128 ? PX_BLACK : PX_WHITE;
+}
+
+/* STVN text sprite: '0' white, '1' black, ' ' transparent */
+static int load_spr(const uint8_t *data, uint32_t size, Mask *m) {
+    int width = 0, height = 1, x = 0, y = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (data[i] == 10) {
+            height++;
+            x = 0;
+        } else if (data[i] == ' ' || data[i] == '0' || data[i] == '1') {
+            if (++x > width) width = x;
+        }
+    }
+    if (width == 0 || mask_alloc(m, width, height, W3S_LEGACY) != 0) return -1;
+    x = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (data[i] == 10) {
+            y++;
+            x = 0;
+        } else if (data[i] == ' ') {
+            x++;
+        } else if (data[i] == '0' || data[i] == '1') {
+            m->px[y * width + x++] = data[i] == '1' ? PX_BLACK : PX_WHITE;
+        }
+    }
+    return 0;
+}
+
+/* Next "quoted" string of an XPM file, NULL at the end */
+static char *xpm_string(char **cursor) {
+    char *start = strchr(*cursor, '"');
+    if (!start) return NULL;
+    char *end = strchr(start + 1, '"');
+    if (!end) return NULL;
+    *end = '\0';
+    *cursor = end + 1;
+    return start + 1;
+}
+
+/* Color of an XPM color definition ("c None", "c #RRGGBB", "c black"...) */
+static int xpm_color(const char *def) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", def);
+    char *tok = strtok(buf, " \t");
+    while (tok && strcmp(tok, "c") != 0) tok = strtok(NULL, " \t");
+    if (tok) tok = strtok(NULL, " \t");
+    if (!tok) return PX_BLACK;
+
+    if (strcmp(tok, "None") == 0 || strcmp(tok, "none") == 0) return PX_CLEAR;
+    if (*tok == '#') {
+        int per = (int)strlen(tok + 1) / 3, rgb[3];
+        if (per < 1) return PX_BLACK;
+        for (int i = 0; i < 3; i++) {
+            /* Most significant byte of each component */
+            char part[3] = { tok[1 + i * per], per > 1 ? tok[2 + i * per] : tok[1 + i * per], 0 };
+            rgb[i] = (int)strtol(part, NULL, 16);
+        }
+        return shade(rgb[0], rgb[1], rgb[2]);
+    }
+    if (strcmp(tok, "white") == 0 || strcmp(tok, "White") == 0) return PX_WHITE;
+    return PX_BLACK;
+}
+
+static int load_xpm(char *text, Mask *m) {
+    char *cursor = text;
+    char *values = xpm_string(&cursor);
+    int width, height, ncolors, cpp;
+    if (!values || sscanf(values, "%d %d %d %d", &width, &height, &ncolors, &cpp) != 4 ||
+        width <= 0 || height <= 0 || ncolors <= 0 || cpp <= 0 || cpp > 4) return -1;
+
+    char (*keys)[5] = malloc(ncolors * sizeof(*keys));
+    int *colors = (int *)malloc(ncolors * sizeof(int));
+    if (!keys || !colors || mask_alloc(m, width, height, 0) != 0) return -1;
+    for (int i = 0; i < ncolors; i++) {
+        char *def = xpm_string(&cursor);
+        if (!def || (int)strlen(def) < cpp) return -1;
+        memcpy(keys[i], def, cpp);
+        colors[i] = xpm_color(def + cpp);
+    }
+    for (int y = 0; y < height; y++) {
+        char *row = xpm_string(&cursor);
+        if (!row || (int)strlen(row) < width * cpp) return -1;
+        for (int x = 0; x < width; x++) {
+            for (int i = 0; i < ncolors; i++) {
+                if (memcmp(keys[i], row + x * cpp, cpp) == 0) {
+                    m->px[y * width + x] = (signed char)colors[i];
+                    break;
+                }
+            }
+        }
+    }
+    free(keys);
+    free(colors);
+    return 0;
+}
+
+static void png_read_mem(png_structp png, png_bytep out, png_size_t len) {
+    MemReader *rd = (MemReader *)png_get_io_ptr(png);
+    if (len > rd->left) png_error(png, "Truncated PNG");
+    memcpy(out, rd->data, len);
+    rd->data += len;
+    rd->left -= len;
+}
+
+static int load_png(const uint8_t *data, uint32_t size, int threshold, Mask *m) {
+    MemReader reader = { data, size };
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    png_bytep volatile pixels = NULL;
+    png_bytep *volatile rows = NULL;
+
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return -1;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        free(rows);
+        free(pixels);
+        return -1;
+    }
+    png_set_read_fn(png, &reader, png_read_mem);
+    png_read_info(png, info);
+
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    png_byte color_type = png_get_color_type(png, info);
+    png_byte bit_depth = png_get_bit_depth(png, info);
+    if (bit_depth == 16) png_set_strip_16(png);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (png_get_valid(png, info, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png);
+    if (!(color_type & PNG_COLOR_MASK_ALPHA)) png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+    png_read_update_info(png, info);
+
+    pixels = (png_bytep)malloc((size_t)width * height * 4);
+    rows = (png_bytep *)malloc(sizeof(png_bytep) * height);
+    if (!pixels || !rows || width > 65535 || height > 65535) png_error(png, "Unsupported image");
+    for (png_uint_32 y = 0; y < height; y++) rows[y] = pixels + (size_t)y * width * 4;
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    free(rows);
+
+    if (mask_alloc(m, (int)width, (int)height, 0) != 0) {
+        free(pixels);
+        return -1;
+    }
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        const uint8_t *rgba = pixels + i * 4;
+        if (rgba[3] >= threshold) m->px[i] = (signed char)shade(rgba[0], rgba[1], rgba[2]);
+    }
+    free(pixels);
+    return 0;
+}
+
+static void put_varint(uint8_t **out, uint32_t v) {
+    while (v >= 0x80) {
+        *(*out)++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *(*out)++ = (uint8_t)v;
+}
+
+/* Encode a mask, returns the allocated file contents */
+static uint8_t *encode(const Mask *m, uint32_t *outsize) {
+    /* Worst case: every other pixel opaque, 1 span + 1 byte of bits each */
+    size_t cap = W3S_HEADER_SIZE + (size_t)m->height * (5 + (size_t)m->width * 6);
+    uint8_t *buf = (uint8_t *)malloc(cap);
+    uint8_t *out = buf + W3S_HEADER_SIZE;
+    if (!buf) return NULL;
+
+    for (int y = 0; y < m->height; y++) {
+        const signed char *row = m->px + (size_t)y * m->width;
+        uint32_t spans = 0;
+        for (int x = 0; x < m->width; x++) {
+            if (row[x] != PX_CLEAR && (x == 0 || row[x - 1] == PX_CLEAR)) spans++;
+        }
+        put_varint(&out, spans);
+
+        int x = 0, last = 0;
+        while (spans > 0) {
+            while (row[x] == PX_CLEAR) x++;
+            int start = x;
+            while (x < m->width && row[x] != PX_CLEAR) x++;
+            put_varint(&out, (uint32_t)(start - last));
+            put_varint(&out, (uint32_t)(x - start));
+            for (int i = 0; i < x - start; i += 8) {
+                uint8_t bits = 0;
+                for (int b = 0; b < 8; b++) {
+                    bits <<= 1;
+                    if (i + b < x - start && row[start + i + b] == PX_BLACK) bits |= 1;
+                }
+                *out++ = bits;
+            }
+            last = x;
+            spans--;
+        }
+    }
+
+    memcpy(buf, W3S_MAGIC, 4);
+    buf[4] = (uint8_t)m->width;
+    buf[5] = (uint8_t)(m->width >> 8);
+    buf[6] = (uint8_t)m->height;
+    buf[7] = (uint8_t)(m->height >> 8);
+    buf[8] = (uint8_t)m->flags;
+    buf[9] = buf[10] = buf[11] = 0;
+    *outsize = (uint32_t)(out - buf);
+    return buf;
+}
+
+/* Decode the result again and compare it with the mask */
+static int verify(const Mask *m, const uint8_t *w3s, uint32_t size) {
+    if (w3s_check(w3s, size) != (long)(size - W3S_HEADER_SIZE)) return 0;
+    const uint8_t *p = w3s + W3S_HEADER_SIZE;
+    const uint8_t *end = w3s + size;
+    for (int y = 0; y < m->height; y++) {
+        const signed char *row = m->px + (size_t)y * m->width;
+        uint32_t spans = w3s_varint(&p, end);
+        int x = 0, covered = 0;
+        while (spans-- > 0) {
+            int skip = (int)w3s_varint(&p, end);
+            int len = (int)w3s_varint(&p, end);
+            for (int i = 0; i < skip; i++) if (row[x++] != PX_CLEAR) return 0;
+            for (int i = 0; i < len; i++) {
+                int bit = (p[i >> 3] >> (7 - (i & 7))) & 1;
+                if (row[x++] != bit) return 0;
+            }
+            p += (len + 7) / 8;
+            covered = x;
+        }
+        for (x = covered; x < m->width; x++) if (row[x] != PX_CLEAR) return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    static const uint8_t png_sig[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    int threshold = 128, arg = 1;
+    Mask m;
+    uint32_t size, outsize;
+
+    if (argc == 5 && strcmp(argv[1], "-t") == 0) {
+        threshold = atoi(argv[2]);
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: w3sconv [-t alpha] sprite.(xpm|spr|png) out.w3s\n");
+        return 1;
+    }
+
+    uint8_t *data = read_file(argv[arg], &size);
+    int ret = -1;
+    if (data && size >= 8 && memcmp(data, png_sig, 8) == 0) ret = load_png(data, size, threshold, &m);
+    else if (data && strstr((char *)data, "XPM")) ret = load_xpm((char *)data, &m);
+    else if (data) ret = load_spr(data, size, &m);
+    free(data);
+    if (ret != 0) {
+        fprintf(stderr, "%s: unsupported or unreadable sprite\n", argv[arg]);
+        return 1;
+    }
+
+    uint8_t *w3s = encode(&m, &outsize);
+    if (!w3s || !verify(&m, w3s, outsize)) {
+        fprintf(stderr, "%s: encoding failed\n", argv[arg]);
+        return 1;
+    }
+    FILE *fp = fopen(argv[arg + 1], "wb");
+    if (!fp || fwrite(w3s, 1, outsize, fp) != outsize || fclose(fp) != 0) {
+        fprintf(stderr, "%s: write error\n", argv[arg + 1]);
+        return 1;
+    }
+    printf("%s: %dx%d, %lu bytes\n", argv[arg + 1], m.width, m.height, (unsigned long)outsize);
+    free(w3s);
+    free(m.px);
+    return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ *      w3vconv - .w3v animation encoder for STVN Engine - Win32s Port
+ *      (c) 2026 Toyoyo
+ *
+ *      w3vconv [-d ms] out.w3v frame.png...
+ *
+ *      The PNG frames must all have the same size, no larger than the image
+ *      area (640x320 unless stvn.ini sets another screen size). Each one is
+ *      shown for 'ms' milliseconds (100 by default). Animations of 256
+ *      colors or less are palettized, frames are deflated when that saves
+ *      space. Alpha is ignored. See src/w3v.h for the layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <png.h>
+
+#include "../src/w3v.h"
+#include "../src/pal8.h"
+
+typedef struct {
+    int width, height;
+    uint32_t *pixels;           /* 0x00RRGGBB */
+} Image;
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len, cap;
+} Buffer;
+
+static void put16(uint8_t *p, int v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint8_t *grow(Buffer *b, uint32_t len) {
+    if (b->len + len > b->cap) {
+        uint32_t cap = b->cap ? b->cap : 65536;
+        while (cap < b->len + len) cap *= 2;
+        uint8_t *data = (uint8_t *)realloc(b->data, cap);
+        if (!data) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    b->len += len;
+    return b->data + b->len - len;
+}
+
+/* PNG to 0x00RRGGBB, alpha dropped */
+static int load_png(const char *path, Image *img) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    uint32_t *volatile pixels = NULL;
+    png_bytep *volatile rows = NULL;
+
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        fclose(fp);
+        return -1;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        free(rows);
+        free(pixels);
+        fclose(fp);
+        return -1;
+    }
+    png_init_io(png, fp);
+    png_read_info(png, info);
+
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    png_byte color_type = png_get_color_type(png, info);
+    png_byte bit_depth = png_get_bit_depth(png, info);
+    if (bit_depth == 16) png_set_strip_16(png);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png);
+    if (!(color_type & PNG_COLOR_MASK_ALPHA)) png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+    png_set_bgr(png);
+    png_read_update_info(png, info);
+
+    pixels = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    rows = (png_bytep *)malloc(sizeof(png_bytep) * height);
+    if (!pixels || !rows) png_error(png, "Out of memory");
+    for (png_uint_32 y = 0; y < height; y++) rows[y] = (png_bytep)(pixels + (size_t)y * width);
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    free(rows);
+    fclose(fp);
+
+    for (size_t i = 0; i < (size_t)width * height; i++) pixels[i] &= 0xffffff;
+    img->width = (int)width;
+    img->height = (int)height;
+    img->pixels = pixels;
+    return 0;
+}
+
+static void put_pixel(Buffer *out, uint32_t c, const Pal8 *pal) {
+    if (pal) {
+        *grow(out, 1) = (uint8_t)pal8_lookup((Pal8 *)pal, c);
+    } else {
+        uint8_t *p = grow(out, 3);
+        p[0] = (uint8_t)c;
+        p[1] = (uint8_t)(c >> 8);
+        p[2] = (uint8_t)(c >> 16);
+    }
+}
+
+/* Pixels x0 to x1 - 1 of a row as spans, runs long enough to pay for the
+ * span they need becoming fills. Returns the number of spans */
+static int put_spans(Buffer *out, const uint32_t *row, int x0, int x1, const Pal8 *pal) {
+    int bpp = pal ? 1 : 3, spans = 0, x = x0;
+    while (x < x1) {
+        int lit = x;
+        /* Literal pixels up to the next worthwhile run */
+        while (x < x1) {
+            int run = 1;
+            while (x + run < x1 && row[x + run] == row[x] && run < 0x7fff) run++;
+            if (run * bpp >= 8 + bpp) break;
+            x += run;
+        }
+        while (lit < x) {
+            int len = x - lit > 0x7fff ? 0x7fff : x - lit;
+            uint8_t *h = grow(out, 4);
+            put16(h, lit);
+            put16(h + 2, len);
+            for (int i = 0; i < len; i++) put_pixel(out, row[lit + i], pal);
+            lit += len;
+            spans++;
+        }
+        if (x < x1) {
+            int run = 1;
+            while (x + run < x1 && row[x + run] == row[x] && run < 0x7fff) run++;
+            uint8_t *h = grow(out, 4);
+            put16(h, x);
+            put16(h + 2, run | W3V_FILL);
+            put_pixel(out, row[x], pal);
+            x += run;
+            spans++;
+        }
+    }
+    return spans;
+}
+
+/* Frame 'cur' as changes from 'prev', or all of it when 'prev' is NULL.
+ * Changed pixels less than a span header apart are sent as one span */
+static void encode_frame(Buffer *out, const Image *cur, const Image *prev, const Pal8 *pal) {
+    int w = cur->width, h = cur->height, y0 = 0, y1 = h;
+    if (prev) {
+        while (y0 < h && memcmp(cur->pixels + (size_t)y0 * w, prev->pixels + (size_t)y0 * w, w * 4) == 0) y0++;
+        while (y1 > y0 && memcmp(cur->pixels + (size_t)(y1 - 1) * w, prev->pixels + (size_t)(y1 - 1) * w, w * 4) == 0) y1--;
+    }
+    uint8_t *head = grow(out, 4);
+    put16(head, y1 > y0 ? y0 : 0);
+    put16(head + 2, y1 - y0);
+
+    for (int y = y0; y < y1; y++) {
+        const uint32_t *row = cur->pixels + (size_t)y * w;
+        const uint32_t *old = prev ? prev->pixels + (size_t)y * w : NULL;
+        uint32_t count_at = out->len;
+        int spans = 0, x = 0;
+        grow(out, 2);
+        while (x < w) {
+            if (old && row[x] == old[x]) {
+                x++;
+                continue;
+            }
+            int end = x + 1, same = 0;
+            while (end < w && same < 4) {
+                if (old && row[end] == old[end]) same++;
+                else same = 0;
+                end++;
+            }
+            end -= same;
+            spans += put_spans(out, row, x, end, pal);
+            x = end;
+        }
+        put16(out->data + count_at, spans);
+    }
+}
+
+/* Raw deflate of 'len' bytes, NULL unless smaller */
+static uint8_t *deflate_frame(const uint8_t *data, uint32_t len, uint32_t *outlen) {
+    uLong cap = compressBound(len);
+    uint8_t *out = (uint8_t *)malloc(cap);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (!out || deflateInit2(&zs, 9, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(out);
+        return NULL;
+    }
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = len;
+    zs.next_out = out;
+    zs.avail_out = cap;
+    int ret = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END || zs.total_out >= len) {
+        free(out);
+        return NULL;
+    }
+    *outlen = zs.total_out;
+    return out;
+}
+
+static int convert(const char *outpath, char **files, int nframes, int delay) {
+    Image *frames = (Image *)calloc(nframes, sizeof(Image));
+    static Pal8 pal;
+    int palettized = 1;
+    if (!frames) return 1;
+    pal8_reset(&pal);
+    for (int i = 0; i < nframes; i++) {
+        if (load_png(files[i], &frames[i]) != 0) {
+            fprintf(stderr, "%s: not a PNG\n", files[i]);
+            return 1;
+        }
+        if (frames[i].width != frames[0].width || frames[i].height != frames[0].height) {
+            fprintf(stderr, "%s: not the size of %s\n", files[i], files[0]);
+            return 1;
+        }
+        for (size_t p = 0; palettized && p < (size_t)frames[i].width * frames[i].height; p++) {
+            if (pal8_lookup(&pal, frames[i].pixels[p]) < 0) palettized = 0;
+        }
+    }
+    if (frames[0].width > 2048 || frames[0].height > 1536 - 80) {
+        fprintf(stderr, "%s: %dx%d is larger than the image area\n", files[0], frames[0].width, frames[0].height);
+        return 1;
+    }
+
+    int colors = palettized ? pal.count : 0;
+    uint32_t index = W3V_HEADER_SIZE + colors * 4;
+    Buffer file = {0}, raw = {0};
+    uint8_t *head = grow(&file, index + nframes * W3V_ENTRY_SIZE);
+    memset(head, 0, index + nframes * W3V_ENTRY_SIZE);
+    memcpy(head, W3V_MAGIC, 4);
+    put16(head + 4, frames[0].width);
+    put16(head + 6, frames[0].height);
+    put16(head + 8, nframes);
+    put16(head + 10, colors);
+    for (int i = 0; i < colors; i++) put32(head + W3V_HEADER_SIZE + i * 4, pal.colors[i]);
+
+    uint32_t deflated = 0;
+    for (int i = 0; i < nframes; i++) {
+        uint32_t size, offset = file.len;
+        int flags = i == 0 ? W3V_KEY : 0;
+        raw.len = 0;
+        encode_frame(&raw, &frames[i], i ? &frames[i - 1] : NULL, palettized ? &pal : NULL);
+        uint8_t *packed = deflate_frame(raw.data, raw.len, &size);
+        if (packed) {
+            memcpy(grow(&file, size), packed, size);
+            flags |= W3V_DEFLATED;
+            deflated++;
+            free(packed);
+        } else {
+            size = raw.len;
+            memcpy(grow(&file, size), raw.data, size);
+        }
+        uint8_t *e = file.data + index + i * W3V_ENTRY_SIZE;
+        put32(e, offset);
+        put32(e + 4, size);
+        put32(e + 8, raw.len);
+        put16(e + 12, delay);
+        put16(e + 14, flags);
+    }
+
+    FILE *fp = fopen(outpath, "wb");
+    if (!fp || fwrite(file.data, 1, file.len, fp) != file.len) {
+        fprintf(stderr, "%s: cannot write\n", outpath);
+        if (fp) fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+    printf("%s: %dx%d, %d frames, %d colors, %lu deflated, %lu bytes\n", outpath,
+           frames[0].width, frames[0].height, nframes, colors, (unsigned long)deflated,
+           (unsigned long)file.len);
+
+    for (int i = 0; i < nframes; i++) free(frames[i].pixels);
+    free(frames);
+    free(file.data);
+    free(raw.data);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int delay = 100, first = 1;
+    if (argc >= 3 && strcmp(argv[1], "-d") == 0) {
+        delay = atoi(argv[2]);
+        first = 3;
+    }
+    if (argc >= first + 2 && argc - first - 1 <= 65535 && delay >= 1 && delay <= 65535) {
+        return convert(argv[first], argv + first + 1, argc - first - 1, delay);
+    }
+
+    fprintf(stderr, "usage: w3vconv [-d ms] out.w3v frame.png...\n");
+    return 1;
+}